@@ -31,7 +31,7 @@ Grabber::Grabber(QObject * parent,
 	fmt_info.fps_numerator = framerate;
 	fmt_info.fps_denominator = 1;
 
-	// if no fourcc passed in, take anything that will work
+	// if no fourcc passed in, take whichever is cheapest to deliver
 	if ( !fmt_info.fourcc )
 	{
 		const int fourccs[] =
@@ -39,24 +39,27 @@ Grabber::Grabber(QObject * parent,
 			VIDCAP_FOURCC_RGB32,
 			VIDCAP_FOURCC_I420,
 			VIDCAP_FOURCC_YUY2,
-			0
 		};
 
-		bool bound = false;
-		for ( int i = 0; fourccs[i]; i++ )
+		const int count = sizeof(fourccs) / sizeof(fourccs[0]);
+		struct vidcap_fmt_info preferences[count];
+		struct vidcap_fmt_choice chosen;
+
+		for ( int i = 0; i < count; i++ )
 		{
-			fmt_info.fourcc = fourccs[i];
-			if ( !vidcap_format_bind(src_, &fmt_info) )
-			{
-				bound = true;
-				break;
-			}
+			preferences[i] = fmt_info;
+			preferences[i].fourcc = fourccs[i];
 		}
 
-		if ( !bound )
-			throw std::runtime_error("failed this vidcap_format_bind()");
+		if ( vidcap_format_negotiate(src_, preferences, count, &chosen) )
+			throw std::runtime_error("failed vidcap_format_negotiate()");
+
+		qDebug() << " negotiated from"
+			<< vidcap_fourcc_string_get(chosen.native.fourcc)
+			<< "via" << (chosen.conversion ? chosen.conversion : "no conversion")
+			<< "at" << chosen.cost << "bytes per frame";
 
-		fourcc_ = fmt_info.fourcc;
+		fourcc_ = chosen.format.fourcc;
 	}
 	else if ( vidcap_format_bind(src_, &fmt_info) )
 		throw std::runtime_error("failed to bind");
@@ -38,6 +38,43 @@
 extern "C" {
 #endif
 
+/**
+ *  \brief Converts between frames with arbitrary plane layouts
+ *  
+ *  \param [in] width      Width of the frames
+ *  \param [in] height     Height of the frames
+ *  \param [in] src_fourcc Fourcc of the source frame
+ *  \param [in] src        First byte of each source plane
+ *  \param [in] src_stride Bytes between the rows of each source plane
+ *  \param [in] dst_fourcc Fourcc of the destination frame
+ *  \param [in] dst        First byte of each destination plane
+ *  \param [in] dst_stride Bytes between the rows of each destination
+ *                         plane
+ *  \return Returns 0 on success
+ *  
+ *  \details Planes come in memory order: y, u, v for i420; y, v, u
+ *           for yvu9; y then interleaved chroma for nv12 and p010; red,
+ *           green, blue for the float tensors; packed fourccs use only
+ *           the first entry. Strides may exceed the row size, for
+ *           padded surfaces or a sub-rectangle of a larger image, and
+ *           may be negative to flip the frame vertically. Any fourcc
+ *           pair converted by the library is supported, as is a copy
+ *           when both fourccs are the same. The conversion uses the
+ *           library's defaults: BT.601 limited range, bilinear
+ *           demosaicing and the bit shift of the source fourcc.
+ *  
+ *           Tightly packed frames are converted in one pass. Other
+ *           frames are converted in bands of rows through a small
+ *           internal buffer; conversions that need the whole frame,
+ *           such as demosaicing, go through a full frame buffer.
+ */
+int
+vidcap_convert_planes(int width, int height,
+		int src_fourcc, const char * const src[3],
+		const int src_stride[3],
+		int dst_fourcc, char * const dst[3],
+		const int dst_stride[3]);
+
 /**
  *  \brief Converts i420 to rgb32
  *  
@@ -122,6 +159,24 @@ vidcap_rgb32_to_i420(int width, int height, const char * src, char * dest);
 int
 vidcap_rgb32_to_yuy2(int width, int height, const char * src, char * dest);
 
+/**
+ *  \brief Converts 16-bit grey (y16, y10) to 8-bit grey
+ *  
+ *  \param [in] width     Width of the source image
+ *  \param [in] height    Height of the source image
+ *  \param [in] bit_shift Right shift applied to each sample, 0 to 15
+ *  \param [in] src       Source image, little-endian 16-bit samples
+ *  \param [in] dest      Destination image
+ *  \return Returns 0 on success
+ *  
+ *  \details Shifted samples above 255 saturate. Use a shift of 2 for
+ *           10-bit data, 8 for full 16-bit data, or less to stretch the
+ *           dark end of sensors with a narrow range.
+ */
+int
+vidcap_y16_to_grey(int width, int height, int bit_shift,
+		const char * src, char * dest);
+
 #ifdef __cplusplus
 }
 #endif
@@ -42,11 +42,67 @@ extern "C" {
 
 #define VIDCAP_NAME_LENGTH 256
 
-/** Fourcc values available from vidcap */
+/** Fourcc values available from vidcap
+ *
+ *  MJPG and H264 are compressed formats. They are only available when
+ *  the device produces them natively and are passed through as-is: no
+ *  destriding or conversion is performed and the capture callback
+ *  receives the compressed payload with its real per-frame size in
+ *  vidcap_capture_info::video_data_size.
+ *
+ *  GREY is 8-bit luminance only. It is available from i420, nv12, yvu9,
+ *  yuy2, 2vuy and rgb32 sources for consumers that need no colour; the
+ *  luma plane of planar sources is delivered in place without a copy.
+ *
+ *  Y10 and Y16 hold one little-endian 16-bit luminance sample per
+ *  pixel, Y10 in the low 10 bits. P010 is NV12 with little-endian
+ *  16-bit samples holding 10 bits in their high bits: a luma plane
+ *  followed by a plane of interleaved u and v. They are narrowed to 8
+ *  bits by a right shift, see vidcap_src_bit_shift_set().
+ *
+ *  BA81, GBRG, GRBG and RGGB are raw 8-bit Bayer mosaics named after
+ *  the colours of their top-left 2x2 cell read row by row (BA81 is
+ *  BGGR). They are demosaiced when a different format is bound, see
+ *  vidcap_src_demosaic_set().
+ *
+ *  RGB32 is a native-endian 32-bit word 0xFFRRGGBB per pixel. BGRA,
+ *  RGBA, ARGB and BGR24 are named after their byte order in memory
+ *  whatever the host's endianness; alpha is always 0xff. RGB565 is a
+ *  little-endian 16-bit word with red in the top 5 bits and blue in
+ *  the low 5 bits. These are output formats for sources delivering
+ *  i420, yuy2, nv12 or rgb32.
+ *
+ *  NV12 is a luma plane followed by a plane of interleaved u and v
+ *  samples, both 2x2 subsampled.
+ *
+ *  RGB_F32 and RGB_F16 are planar tensors for inference: a plane of
+ *  red, then green, then blue samples, each width * height native-endian
+ *  floats (IEEE single and half precision). Samples are scaled and
+ *  offset per channel, see vidcap_src_tensor_set(). They are output
+ *  formats for sources delivering i420, yuy2 or nv12.
+ */
 enum vidcap_fourccs {
 	VIDCAP_FOURCC_I420   = 100,
 	VIDCAP_FOURCC_YUY2   = 101,
 	VIDCAP_FOURCC_RGB32  = 102,
+	VIDCAP_FOURCC_MJPG   = 103,
+	VIDCAP_FOURCC_H264   = 104,
+	VIDCAP_FOURCC_GREY   = 105,
+	VIDCAP_FOURCC_Y10    = 106,
+	VIDCAP_FOURCC_Y16    = 107,
+	VIDCAP_FOURCC_P010   = 108,
+	VIDCAP_FOURCC_BA81   = 109,
+	VIDCAP_FOURCC_GBRG   = 110,
+	VIDCAP_FOURCC_GRBG   = 111,
+	VIDCAP_FOURCC_RGGB   = 112,
+	VIDCAP_FOURCC_BGRA   = 113,
+	VIDCAP_FOURCC_RGBA   = 114,
+	VIDCAP_FOURCC_ARGB   = 115,
+	VIDCAP_FOURCC_BGR24  = 116,
+	VIDCAP_FOURCC_RGB565 = 117,
+	VIDCAP_FOURCC_NV12   = 118,
+	VIDCAP_FOURCC_RGB_F32 = 119,
+	VIDCAP_FOURCC_RGB_F16 = 120,
 };
 
 /** The different log levels that vidcap supports */
@@ -58,6 +114,60 @@ enum vidcap_log_level {
 	VIDCAP_LOG_DEBUG = 40
 };
 
+/** How frames are resized when the nominal size differs from the
+ *  native size of the device
+ */
+enum vidcap_scale_mode {
+	VIDCAP_SCALE_BOX      = 0, /**< nearest source pixel */
+	VIDCAP_SCALE_BILINEAR = 1, /**< linear blend of the 2x2 nearest pixels */
+	VIDCAP_SCALE_AREA     = 2, /**< average of all covered source pixels */
+};
+
+/** How missing colours of Bayer sources are reconstructed */
+enum vidcap_demosaic {
+	VIDCAP_DEMOSAIC_BILINEAR   = 0, /**< average of the nearest samples */
+	VIDCAP_DEMOSAIC_EDGE_AWARE = 1, /**< interpolate along edges */
+};
+
+/** Treatment of frames identical to the frame before them */
+enum vidcap_duplicates {
+	VIDCAP_DUPLICATES_DELIVER = 0, /**< no detection */
+	VIDCAP_DUPLICATES_MARK    = 1, /**< deliver, setting vidcap_capture_info::duplicate */
+	VIDCAP_DUPLICATES_DROP    = 2, /**< do not deliver */
+};
+
+/** Pacing of delivered frames to the nominal frame rate */
+enum vidcap_rate_mode {
+	VIDCAP_RATE_DECIMATE = 0, /**< drop frames arriving faster than the nominal rate */
+	VIDCAP_RATE_CONSTANT = 1, /**< also repeat frames, delivering exactly the nominal rate */
+};
+
+/** Matrix relating yuv to rgb */
+enum vidcap_colorimetry {
+	VIDCAP_COLORIMETRY_BT601  = 0, /**< standard definition */
+	VIDCAP_COLORIMETRY_BT709  = 1, /**< high definition */
+	VIDCAP_COLORIMETRY_BT2020 = 2, /**< ultra high definition */
+};
+
+/** Span of 8-bit yuv samples */
+enum vidcap_range {
+	VIDCAP_RANGE_LIMITED = 0, /**< luma 16 to 235, chroma 16 to 240 */
+	VIDCAP_RANGE_FULL    = 1, /**< 0 to 255 */
+};
+
+/** Rotation and mirroring of delivered frames. One rotation can be
+ *  combined with either flip; flips are applied before the rotation.
+ */
+enum vidcap_transform {
+	VIDCAP_TRANSFORM_NONE        = 0,
+	VIDCAP_TRANSFORM_ROTATE_90   = 1, /**< clockwise */
+	VIDCAP_TRANSFORM_ROTATE_180  = 2,
+	VIDCAP_TRANSFORM_ROTATE_270  = 3,
+	VIDCAP_TRANSFORM_ROTATE_MASK = 3,
+	VIDCAP_TRANSFORM_FLIP_H      = 4, /**< mirror left to right */
+	VIDCAP_TRANSFORM_FLIP_V      = 8, /**< mirror top to bottom */
+};
+
 typedef void vidcap_state;
 typedef void vidcap_sapi;
 typedef void vidcap_src;
@@ -83,14 +193,83 @@ struct vidcap_fmt_info
 	int fps_denominator;
 };
 
-struct vidcap_capture_info
+/** A rectangular region of the frame, in pixels of the bound format */
+struct vidcap_roi
+{
+	int x;
+	int y;
+	int width;
+	int height;
+	int fourcc; /**< fourcc the region is delivered in */
+};
+
+/** One image delivered alongside a captured frame */
+struct vidcap_image
 {
 	const char * video_data;
 	int video_data_size;
+	int width;
+	int height;
+	int fourcc;
+};
+
+/** Luma statistics of a delivered frame */
+struct vidcap_frame_stats
+{
+	unsigned int histogram[256]; /**< pixels per luma value */
+	float mean; /**< mean luma, 0 to 255 */
+	float sharpness; /**< mean absolute luma difference between neighbouring pixels */
+};
+
+/** Blocks of a frame that changed since the last delivered one */
+struct vidcap_motion
+{
+	int block_width; /**< in native frame pixels */
+	int block_height;
+	int columns;
+	int rows;
+	const unsigned char * blocks; /**< columns * rows flags, 1 where changed, row by row */
+	int moving_blocks;
+};
+
+/** Outcome of vidcap_format_negotiate() */
+struct vidcap_fmt_choice
+{
+	int preference; /**< index of the preference the format came from */
+	struct vidcap_fmt_info format; /**< format bound, as delivered */
+	struct vidcap_fmt_info native; /**< format produced by the device */
+	const char * conversion; /**< name of the fourcc conversion, 0 when none */
+	int scale_fourcc; /**< fourcc in which frames are resized, 0 when they are not */
+	int cost; /**< estimated bytes read and written per frame */
+};
+
+/** Frame counts of a source since capture last started */
+struct vidcap_src_stats
+{
+	unsigned int captured; /**< frames received from the device */
+	unsigned int duplicates; /**< captured frames found identical to the one before */
+	unsigned int delivered; /**< frames passed to the capture callback */
+	unsigned int late; /**< frames reaching the jitter buffer after their release time */
+	unsigned int overflowed; /**< frames dropped from a full jitter buffer */
+	int buffered; /**< frames held in the jitter buffer */
+	long delay_usecs; /**< current delay of the jitter buffer */
+};
+
+struct vidcap_capture_info
+{
+	const char * video_data; /**< 0 when regions of interest are set */
+	int video_data_size; /**< payload size; varies per frame for compressed fourccs */
 	int error_status;
 	long capture_time_sec;
 	long capture_time_usec;
 	struct vidcap_fmt_info format;
+	int roi_count;
+	const struct vidcap_image * roi_images; /**< one per region, in the order they were set */
+	int pyramid_count;
+	const struct vidcap_image * pyramid; /**< 1/2, 1/4... size copies of video_data */
+	const struct vidcap_frame_stats * stats; /**< 0 unless enabled, see vidcap_src_frame_stats_set() */
+	const struct vidcap_motion * motion; /**< 0 unless enabled, see vidcap_src_motion_set() */
+	int duplicate; /**< 1 when identical to the frame before, see vidcap_src_duplicates_set() */
 };
 
 typedef int (*vidcap_src_capture_callback) (vidcap_src *,
@@ -273,6 +452,29 @@ int
 vidcap_format_bind(vidcap_src *,
 		const struct vidcap_fmt_info *);
 
+/**
+ *  \brief Bind the cheapest of several acceptable formats
+ *  
+ *  \param [in]  src         Source
+ *  \param [in]  preferences Acceptable formats, most wanted first
+ *  \param [in]  count       Number of preferences
+ *  \param [out] chosen      Format bound and how frames will reach
+ *                           it, may be 0
+ *  \return Returns 0 on success
+ *  
+ *  \details A zero fourcc, width, height or fps numerator in a
+ *           preference accepts the values of any format listed by
+ *           vidcap_format_enumerate(). Every acceptable format is
+ *           costed by the bytes that destriding, scaling and fourcc
+ *           conversion will read and write for each frame; enlarging
+ *           counts double. The cheapest format the source binds is
+ *           kept, the earlier preference winning a tie.
+ */
+int
+vidcap_format_negotiate(vidcap_src * src,
+		const struct vidcap_fmt_info * preferences, int count,
+		struct vidcap_fmt_choice * chosen);
+
 /**
  *  \brief vidcap_format_info_get
  *  
@@ -286,6 +488,342 @@ int
 vidcap_format_info_get(vidcap_src * src,
 		struct vidcap_fmt_info * fmt_info);
 
+/**
+ *  \brief Get the format the device produces for the bound format
+ *  
+ *  \param [in]  src         Source with a bound format
+ *  \param [out] fmt_info    Native format
+ *  \param [out] fps_granted Set to 1 if the device reported the frame
+ *                           rate it grants, 0 otherwise, may be 0
+ *  \return Returns 0 on success, -1 if no format is bound
+ *  
+ *  \details The native format differs from the bound one when frames
+ *           are scaled or converted. Where the device reports the rate
+ *           it grants, the native frame rate is that rate, which may be
+ *           below the bound one; frames are then decimated only from
+ *           the granted rate.
+ */
+int
+vidcap_format_native_get(vidcap_src * src,
+		struct vidcap_fmt_info * fmt_info, int * fps_granted);
+
+/**
+ *  \brief Select how frames are resized
+ *  
+ *  \param [in] src  Source
+ *  \param [in] mode One of enum vidcap_scale_mode
+ *  \return Returns 0 on success
+ *  
+ *  \details A nominal format whose size differs from what the device
+ *           offers is satisfied by resizing each frame. The default is
+ *           VIDCAP_SCALE_BILINEAR. The mode cannot be changed while
+ *           capturing.
+ */
+int
+vidcap_src_scale_mode_set(vidcap_src * src,
+		enum vidcap_scale_mode mode);
+
+/**
+ *  \brief Set how high bit depth samples are narrowed to 8 bits
+ *  
+ *  \param [in] src       Source
+ *  \param [in] bit_shift Right shift from 0 to 15, or -1 for the
+ *                        format's default
+ *  \return Returns 0 on success
+ *  
+ *  \details Applies when a Y10, Y16 or P010 source is converted to an
+ *           8-bit format. By default the most significant bits are kept
+ *           (a shift of 2 for Y10, 8 for Y16 and P010). A smaller shift
+ *           keeps lower bits and saturates samples that do not fit. It
+ *           cannot be changed while capturing.
+ */
+int
+vidcap_src_bit_shift_set(vidcap_src * src, int bit_shift);
+
+/**
+ *  \brief Set how chroma is subsampled vertically
+ *  
+ *  \param [in] src    Source
+ *  \param [in] enable 1 to average the chroma of row pairs, 0 to keep
+ *                     the chroma of the even rows
+ *  \return Returns 0 on success
+ *  
+ *  \details Applies when a yuy2 or 2vuy source is converted to i420.
+ *           Averaging costs little and avoids the aliasing of dropping
+ *           every other chroma row. It is off by default and cannot be
+ *           changed while capturing.
+ */
+int
+vidcap_src_chroma_average_set(vidcap_src * src, int enable);
+
+/**
+ *  \brief Set the normalization of float rgb outputs
+ *  
+ *  \param [in] src   Source
+ *  \param [in] scale Factor applied to red, green and blue samples
+ *  \param [in] bias  Offset added to red, green and blue afterwards
+ *  \return Returns 0 on success
+ *  
+ *  \details Applies to RGB_F32 and RGB_F16. Channel values range from 0
+ *           to 255 before scaling; the default scale of 1/255 and bias
+ *           of 0 give samples from 0 to 1. For a model normalized with
+ *           per channel mean m and standard deviation s (on the 0 to 1
+ *           scale), use scale 1 / (255 s) and bias -m / s. It cannot be
+ *           changed while capturing.
+ */
+int
+vidcap_src_tensor_set(vidcap_src * src, const float scale[3],
+		const float bias[3]);
+
+/**
+ *  \brief Set how Bayer sources are demosaiced
+ *  
+ *  \param [in] src     Source
+ *  \param [in] mode    One of enum vidcap_demosaic
+ *  \param [in] threads Number of threads sharing each frame, 1 to 16
+ *  \return Returns 0 on success
+ *  
+ *  \details Bilinear is the default and is cheap enough for full frame
+ *           rates. Edge-aware avoids the colour fringes bilinear leaves
+ *           along sharp edges at several times the cost. Large frames
+ *           can be split between threads; each thread takes a band of
+ *           rows. It cannot be changed while capturing.
+ */
+int
+vidcap_src_demosaic_set(vidcap_src * src, enum vidcap_demosaic mode,
+		int threads);
+
+/**
+ *  \brief Set how yuv samples relate to rgb colours
+ *  
+ *  \param [in] src    Source
+ *  \param [in] matrix One of enum vidcap_colorimetry
+ *  \param [in] range  One of enum vidcap_range
+ *  \return Returns 0 on success
+ *  
+ *  \details Applies to every conversion between yuv and rgb formats,
+ *           in either direction. The default is BT.601 limited range,
+ *           which most webcams use; HD cameras usually deliver BT.709.
+ *           The vidcap_*_to_* converter functions always use the
+ *           default. It cannot be changed while capturing.
+ */
+int
+vidcap_src_colorimetry_set(vidcap_src * src,
+		enum vidcap_colorimetry matrix, enum vidcap_range range);
+
+/**
+ *  \brief Rotate and/or mirror delivered frames
+ *  
+ *  \param [in] src       Source
+ *  \param [in] transform Bitwise or of enum vidcap_transform values
+ *  \return Returns 0 on success
+ *  
+ *  \details Suits cameras mounted sideways or upside down. The
+ *           transform is done in whichever of the native and bound
+ *           fourccs moves fewer bytes. With a quarter turn,
+ *           vidcap_capture_info::format has width and height exchanged
+ *           relative to the bound format. It persists across format
+ *           binds, cannot be changed while capturing and cannot be
+ *           combined with regions of interest.
+ */
+int
+vidcap_src_transform_set(vidcap_src * src, int transform);
+
+/**
+ *  \brief Deliver reduced copies of each frame
+ *  
+ *  \param [in] src    Source
+ *  \param [in] levels Number of half-size levels (up to 8), 0 for none
+ *  \return Returns 0 on success
+ *  
+ *  \details Alongside each delivered frame, vidcap_capture_info::pyramid
+ *           holds the frame at 1/2, 1/4... of its width and height, in
+ *           the same fourcc. Each pixel is the average of the 2x2 pixels
+ *           above it. All levels are built in one pass over the frame.
+ *           The frame size must halve exactly at every level, keeping
+ *           the alignment of its fourcc. The setting persists across
+ *           format binds, cannot be changed while capturing and cannot
+ *           be combined with regions of interest.
+ */
+int
+vidcap_src_pyramid_set(vidcap_src * src, int levels);
+
+/**
+ *  \brief Compute luma statistics of each frame
+ *  
+ *  \param [in] src    Source
+ *  \param [in] enable 1 to compute statistics, 0 to stop
+ *  \return Returns 0 on success
+ *  
+ *  \details Alongside each delivered frame, vidcap_capture_info::stats
+ *           holds the luma histogram, mean and sharpness of the frame.
+ *           They are gathered in one pass over the native frame before
+ *           conversion when its fourcc carries luma (i420, nv12, yvu9,
+ *           yuy2, 2vuy or grey), otherwise over the delivered frame
+ *           when that does. Otherwise vidcap_capture_info::stats is 0.
+ *           The setting persists across format binds and cannot be
+ *           changed while capturing.
+ */
+int
+vidcap_src_frame_stats_set(vidcap_src * src, int enable);
+
+/**
+ *  \brief Deliver only frames with motion
+ *  
+ *  \param [in] src           Source
+ *  \param [in] threshold     Mean luma difference over a block for it
+ *                            to count as changed, 0 to stop detecting
+ *  \param [in] min_blocks    Changed blocks needed for a frame to be
+ *                            delivered
+ *  \param [in] idle_interval Deliver every Nth frame without motion,
+ *                            0 to deliver none
+ *  \return Returns 0 on success
+ *  
+ *  \details Each native frame is reduced to 1/4 of its width and height
+ *           before any conversion and compared, block by block, with
+ *           the last frame delivered. Frames with too few changed
+ *           blocks are dropped before they are converted. The changed
+ *           blocks of each delivered frame are described by
+ *           vidcap_capture_info::motion. The native fourcc must carry
+ *           luma (i420, nv12, yvu9, yuy2, 2vuy or grey) or be top-down
+ *           rgb, whose green stands in for it. The setting persists
+ *           across format binds and cannot be changed while capturing.
+ */
+int
+vidcap_src_motion_set(vidcap_src * src, int threshold, int min_blocks,
+		int idle_interval);
+
+/**
+ *  \brief Detect frames repeated by the device
+ *  
+ *  \param [in] src  Source
+ *  \param [in] mode One of enum vidcap_duplicates
+ *  \return Returns 0 on success
+ *  
+ *  \details Some devices deliver the same buffer again when they
+ *           cannot keep up with their frame rate. Each buffer is
+ *           hashed as it arrives from the device, before destriding or
+ *           conversion, and compared with the hash of the buffer
+ *           before it. Repeated frames are then either marked in
+ *           vidcap_capture_info::duplicate or dropped before any work
+ *           is spent on them. Either way they are counted, see
+ *           vidcap_src_stats_get(). The setting cannot be changed while
+ *           capturing.
+ */
+int
+vidcap_src_duplicates_set(vidcap_src * src, int mode);
+
+/**
+ *  \brief Get the frame counts of a source
+ *  
+ *  \param [in]  src   Source
+ *  \param [out] stats Counts since capture last started
+ *  \return Returns 0 on success
+ *  
+ *  \details Duplicates are only counted while their detection is
+ *           enabled, see vidcap_src_duplicates_set(), and the jitter
+ *           buffer fields only while it is, see
+ *           vidcap_src_jitter_buffer_set(). The counts may be read
+ *           while capturing.
+ */
+int
+vidcap_src_stats_get(vidcap_src * src, struct vidcap_src_stats * stats);
+
+/**
+ *  \brief Choose how frames are paced to the nominal frame rate
+ *  
+ *  \param [in] src  Source
+ *  \param [in] mode One of enum vidcap_rate_mode
+ *  \return Returns 0 on success
+ *  
+ *  \details Output frames fall on ticks at exactly the nominal rate,
+ *           counted from the first frame on a monotonic clock, so the
+ *           delivered rate does not drift. Each captured frame fills
+ *           the ticks nearest to it. With VIDCAP_RATE_DECIMATE, the
+ *           default, frames filling no tick are dropped. With
+ *           VIDCAP_RATE_CONSTANT, frames filling several ticks are also
+ *           delivered once per tick, and every delivered frame carries
+ *           the time of its tick in vidcap_capture_info, as encoders
+ *           needing a constant frame rate expect. Ticks restart after
+ *           a stall of over two seconds. Backends that pace frames on
+ *           their own timer thread are not affected. The mode cannot
+ *           be changed while capturing.
+ */
+int
+vidcap_src_rate_mode_set(vidcap_src * src, enum vidcap_rate_mode mode);
+
+/**
+ *  \brief Smooth out uneven frame arrival
+ *  
+ *  \param [in] src      Source
+ *  \param [in] delay_ms Least time a frame is held, 0 to disable
+ *  \return Returns 0 on success
+ *  
+ *  \details Frames from the device are held in a small buffer and
+ *           handed to the capture callback from a thread of the
+ *           library, at the mean arrival interval on a monotonic
+ *           clock. The delay grows beyond the one asked for when
+ *           arrivals vary more, within what the buffer can hold.
+ *           Frames arriving after their release time are delivered at
+ *           once and counted as late. When the buffer is full the
+ *           oldest frame is dropped. Occupancy, delay and both counts
+ *           are reported by vidcap_src_stats_get(). The capture
+ *           callback must not stop capture while the buffer is used.
+ *           The delay cannot be changed while capturing.
+ */
+int
+vidcap_src_jitter_buffer_set(vidcap_src * src, int delay_ms);
+
+/**
+ *  \brief Deliver only regions of each frame
+ *  
+ *  \param [in] src   Source with a bound format
+ *  \param [in] count Number of regions, 0 to deliver full frames again
+ *  \param [in] rois  Regions to deliver
+ *  \return Returns 0 on success
+ *  
+ *  \details Each region is cropped from the native frame and converted
+ *           on its own to its fourcc, so the conversion cost follows
+ *           the area of the regions rather than that of the frame. The
+ *           regions arrive in vidcap_capture_info::roi_images and the
+ *           full frame is not delivered.
+ *  
+ *           Regions must lie within the bound format and be aligned to
+ *           the chroma subsampling of both the native and the region
+ *           fourcc (even offsets and sizes for I420, for instance).
+ *           They cannot be used while the source is scaling nor changed
+ *           while capturing, and binding a format clears them.
+ */
+int
+vidcap_src_roi_set(vidcap_src * src, int count,
+		const struct vidcap_roi * rois);
+
+/**
+ *  \brief Get the frame being delivered in another fourcc
+ *  
+ *  \param [in]  src    Source calling the capture callback
+ *  \param [in]  fourcc Fourcc wanted
+ *  \param [out] image  The converted frame
+ *  \return Returns 0 on success, -1 outside the capture callback, for
+ *          frames with an error status or if the native fourcc cannot
+ *          be converted to fourcc
+ *  
+ *  \details Only valid from within the capture callback. The frame is
+ *           converted from the native fourcc on the first request and
+ *           the result is reused by later requests for the same frame,
+ *           so one source can feed, say, an I420 encoder and an RGB32
+ *           preview. Asking for the delivered fourcc returns the
+ *           delivered frame. To convert only some frames, bind the
+ *           native format and call this when needed. The image is
+ *           scaled and transformed like the delivered frame, so it has
+ *           the same size and orientation. It remains valid until the
+ *           callback returns. Up to four fourccs are kept per source
+ *           until the next format bind.
+ */
+int
+vidcap_src_frame_convert(vidcap_src * src, int fourcc,
+		struct vidcap_image * image);
+
 /**
  *  \brief vidcap_src_capture_start
  *  
@@ -0,0 +1,152 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file colorimetry.c
+ *  \ingroup Core
+ *  \brief Conversion tables of the supported matrices and ranges,
+ *         generated by the preprocessor.
+ */
+
+#include "colorimetry.h"
+
+/* Repeat f(p, i) for 4, 16, 64 and 256 consecutive values of i */
+#define CT4(f, p, i)						\
+	f(p, (i)) f(p, (i) + 1) f(p, (i) + 2) f(p, (i) + 3)
+#define CT16(f, p, i)						\
+	CT4(f, p, i) CT4(f, p, (i) + 4)				\
+	CT4(f, p, (i) + 8) CT4(f, p, (i) + 12)
+#define CT64(f, p, i)						\
+	CT16(f, p, i) CT16(f, p, (i) + 16)			\
+	CT16(f, p, (i) + 32) CT16(f, p, (i) + 48)
+#define CT256(f, p, i)						\
+	CT64(f, p, i) CT64(f, p, (i) + 64)			\
+	CT64(f, p, (i) + 128) CT64(f, p, (i) + 192)
+
+#define CLIP_TERM(p, i)						\
+	(unsigned char)((i) < COLOR_CLIP_OFFSET ? 0 :		\
+		(i) > COLOR_CLIP_OFFSET + 255 ? 255 :		\
+		(i) - COLOR_CLIP_OFFSET),
+
+const unsigned char colorimetry_clip[COLOR_CLIP_SIZE] =
+{
+	CT256(CLIP_TERM, 0, 0)
+	CT256(CLIP_TERM, 0, 256)
+	CT256(CLIP_TERM, 0, 512)
+	CT64(CLIP_TERM, 0, 768)
+	CT64(CLIP_TERM, 0, 832)
+};
+
+/* Luma scaling is the same for every matrix of a range */
+#define LIMITED_Y_MUL    298
+#define LIMITED_Y_OFFSET 16
+#define FULL_Y_MUL       256
+#define FULL_Y_OFFSET    0
+
+#define LUMA_TERM(p, i)						\
+	(short)((p##_Y_MUL * ((i) - p##_Y_OFFSET) + 128) >> 8),
+
+#define CHROMA_TERM(mul, i)					\
+	(short)(((mul) * ((i) - 128)) >> 8),
+
+static const short luma_limited[256] = { CT256(LUMA_TERM, LIMITED, 0) };
+static const short luma_full[256] = { CT256(LUMA_TERM, FULL, 0) };
+
+/* Terms of red from v, green from u and v, and blue from u */
+#define CHROMA_TABLES(name, r_v, g_u, g_v, b_u)				\
+	static const short name##_r_v[256] = { CT256(CHROMA_TERM, r_v, 0) };	\
+	static const short name##_g_u[256] = { CT256(CHROMA_TERM, g_u, 0) };	\
+	static const short name##_g_v[256] = { CT256(CHROMA_TERM, g_v, 0) };	\
+	static const short name##_b_u[256] = { CT256(CHROMA_TERM, b_u, 0) };
+
+CHROMA_TABLES(bt601_limited, 409, -100, -208, 516)
+CHROMA_TABLES(bt601_full, 359, -88, -183, 454)
+CHROMA_TABLES(bt709_limited, 459, -55, -136, 541)
+CHROMA_TABLES(bt709_full, 403, -48, -120, 475)
+CHROMA_TABLES(bt2020_limited, 430, -48, -167, 548)
+CHROMA_TABLES(bt2020_full, 377, -42, -146, 482)
+
+#define INVERSE_TABLES(name, luma)					\
+	luma, name##_r_v, name##_g_u, name##_g_v, name##_b_u
+
+/* The forward weights of each row are rounded to sum to the luma
+ * scale or to zero so that greys map exactly.
+ */
+static const struct colorimetry colorimetries[3][2] =
+{
+	{
+		{
+			INVERSE_TABLES(bt601_limited, luma_limited),
+			{ 66, 129, 25 }, { -38, -74, 112 }, { 112, -94, -18 },
+			16,
+			1.164384f, 1.596027f, 0.391762f, 0.812968f, 2.017232f,
+		},
+		{
+			INVERSE_TABLES(bt601_full, luma_full),
+			{ 77, 150, 29 }, { -43, -85, 128 }, { 128, -107, -21 },
+			0,
+			1.0f, 1.402f, 0.344136f, 0.714136f, 1.772f,
+		},
+	},
+	{
+		{
+			INVERSE_TABLES(bt709_limited, luma_limited),
+			{ 47, 157, 16 }, { -26, -86, 112 }, { 112, -102, -10 },
+			16,
+			1.164384f, 1.792741f, 0.213249f, 0.532909f, 2.112402f,
+		},
+		{
+			INVERSE_TABLES(bt709_full, luma_full),
+			{ 54, 183, 19 }, { -29, -99, 128 }, { 128, -116, -12 },
+			0,
+			1.0f, 1.5748f, 0.187324f, 0.468124f, 1.8556f,
+		},
+	},
+	{
+		{
+			INVERSE_TABLES(bt2020_limited, luma_limited),
+			{ 58, 149, 13 }, { -31, -81, 112 }, { 112, -103, -9 },
+			16,
+			1.164384f, 1.678674f, 0.187326f, 0.650424f, 2.141772f,
+		},
+		{
+			INVERSE_TABLES(bt2020_full, luma_full),
+			{ 67, 174, 15 }, { -36, -92, 128 }, { 128, -118, -10 },
+			0,
+			1.0f, 1.4746f, 0.164553f, 0.571353f, 1.8814f,
+		},
+	},
+};
+
+const struct colorimetry *
+colorimetry_get(int matrix, int range)
+{
+	if ( matrix < VIDCAP_COLORIMETRY_BT601 ||
+			matrix > VIDCAP_COLORIMETRY_BT2020 ||
+			(range != VIDCAP_RANGE_LIMITED &&
+			 range != VIDCAP_RANGE_FULL) )
+		return 0;
+
+	return &colorimetries[matrix][range];
+}
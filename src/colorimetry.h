@@ -0,0 +1,113 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _COLORIMETRY_H
+#define _COLORIMETRY_H
+
+/** \file colorimetry.h
+ *  \ingroup Core
+ *  \brief Coefficients of the yuv and rgb conversions.
+ */
+
+#include <vidcap/vidcap.h>
+
+enum
+{
+	/* Index of zero in colorimetry_clip. The table covers the sums of
+	 * luma and chroma terms of every matrix and range.
+	 */
+	COLOR_CLIP_OFFSET = 320,
+	COLOR_CLIP_SIZE = 896,
+};
+
+/** Conversion terms of one matrix and range */
+struct colorimetry
+{
+	/* yuv to rgb: the contribution of each sample, indexed by sample
+	 * value, in 8-bit rgb units
+	 */
+	const short * y;
+	const short * r_v;
+	const short * g_u;
+	const short * g_v;
+	const short * b_u;
+
+	/* rgb to yuv: weights of r, g and b in 8.8 fixed point */
+	short to_y[3];
+	short to_u[3];
+	short to_v[3];
+	short y_offset; /* black level, 16 for limited range, 0 for full */
+
+	/* yuv to rgb in floating point, for float outputs */
+	float y_mul;
+	float r_v_mul;
+	float g_u_mul; /* both green terms are subtracted */
+	float g_v_mul;
+	float b_u_mul;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Saturates COLOR_CLIP_OFFSET + v to 0..255 */
+extern const unsigned char colorimetry_clip[COLOR_CLIP_SIZE];
+
+/**
+ *  \brief Get the conversion terms of a matrix and range
+ *  
+ *  \param [in] matrix One of enum vidcap_colorimetry
+ *  \param [in] range  One of enum vidcap_range
+ *  \return The terms, or 0 if either value is unknown
+ */
+const struct colorimetry *
+colorimetry_get(int matrix, int range);
+
+#ifdef __cplusplus
+}
+#endif
+
+static __inline unsigned char
+colorimetry_y(const struct colorimetry * c, int r, int g, int b)
+{
+	return colorimetry_clip[COLOR_CLIP_OFFSET + c->y_offset +
+		((c->to_y[0] * r + c->to_y[1] * g + c->to_y[2] * b + 128) >> 8)];
+}
+
+static __inline unsigned char
+colorimetry_u(const struct colorimetry * c, int r, int g, int b)
+{
+	return colorimetry_clip[COLOR_CLIP_OFFSET + 128 +
+		((c->to_u[0] * r + c->to_u[1] * g + c->to_u[2] * b + 128) >> 8)];
+}
+
+static __inline unsigned char
+colorimetry_v(const struct colorimetry * c, int r, int g, int b)
+{
+	return colorimetry_clip[COLOR_CLIP_OFFSET + 128 +
+		((c->to_v[0] * r + c->to_v[1] * g + c->to_v[2] * b + 128) >> 8)];
+}
+
+#endif
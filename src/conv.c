@@ -36,14 +36,95 @@
 #endif
 
 #include "string.h"
+#include "colorimetry.h"
 #include "conv.h"
+#include "conv_traits.h"
+#include "frame_copy.h"
 #include "logging.h"
 
-int conv_2vuy_to_i420(int w, int h, const char * s, char * d);
-int conv_2vuy_to_yuy2(int w, int h, const char * s, char * d);
-int conv_rgb24_to_rgb32(int w, int h, const char * s, char * d);
-int conv_yvu9_to_i420(int w, int h, const char * s, char * d);
-int conv_bottom_up_rgb24_to_rgb32(int w, int h, const char * s, char * d);
+#define CONV_DECLARE(name)					\
+	int conv_##name(const struct conv_params * p,		\
+			int w, int h, const char * s, char * d)
+
+CONV_DECLARE(i420_to_yuy2);
+CONV_DECLARE(rgb32_to_i420);
+CONV_DECLARE(rgb32_to_yuy2);
+CONV_DECLARE(yuy2_to_i420);
+CONV_DECLARE(2vuy_to_i420);
+CONV_DECLARE(2vuy_to_yuy2);
+CONV_DECLARE(rgb24_to_rgb32);
+CONV_DECLARE(yvu9_to_i420);
+CONV_DECLARE(bottom_up_rgb24_to_rgb32);
+CONV_DECLARE(rgb24_red_first_to_rgb32);
+CONV_DECLARE(bottom_up_rgb24_red_first_to_rgb32);
+CONV_DECLARE(grey_to_i420);
+CONV_DECLARE(grey_to_rgb32);
+CONV_DECLARE(y16_to_grey);
+CONV_DECLARE(i420_to_grey);
+CONV_DECLARE(yuy2_to_grey);
+CONV_DECLARE(2vuy_to_grey);
+CONV_DECLARE(rgb32_to_grey);
+CONV_DECLARE(y16_to_i420);
+CONV_DECLARE(y16_to_rgb32);
+CONV_DECLARE(p010_to_i420);
+CONV_DECLARE(p010_to_rgb32);
+CONV_DECLARE(nv12_to_i420);
+CONV_DECLARE(i420_to_rgb_f32);
+CONV_DECLARE(i420_to_rgb_f16);
+CONV_DECLARE(nv12_to_rgb_f32);
+CONV_DECLARE(nv12_to_rgb_f16);
+CONV_DECLARE(yuy2_to_rgb_f32);
+CONV_DECLARE(yuy2_to_rgb_f16);
+CONV_DECLARE(ba81_to_i420);
+CONV_DECLARE(ba81_to_rgb32);
+CONV_DECLARE(gbrg_to_i420);
+CONV_DECLARE(gbrg_to_rgb32);
+CONV_DECLARE(grbg_to_i420);
+CONV_DECLARE(grbg_to_rgb32);
+CONV_DECLARE(rggb_to_i420);
+CONV_DECLARE(rggb_to_rgb32);
+
+/* Converters generated in conv_to_rgb.c from the format traits */
+#define YUV420_TO_RGB_DECLARE(sname, SFOURCC, c_step,			\
+		dname, DFOURCC, bpp, STORE, ro, go, bo)			\
+	CONV_DECLARE(sname##_to_##dname);
+
+#define YUV422_TO_RGB_DECLARE(sname, SFOURCC, y0, uo, y1, vo,		\
+		dname, DFOURCC, bpp, STORE, ro, go, bo)			\
+	CONV_DECLARE(sname##_to_##dname);
+
+#define YUV_TO_RGB_DECLARE(dname, DFOURCC, bpp, STORE, ro, go, bo)	\
+	CONV_420_SOURCES(YUV420_TO_RGB_DECLARE,				\
+			dname, DFOURCC, bpp, STORE, ro, go, bo)		\
+	CONV_422_SOURCES(YUV422_TO_RGB_DECLARE,				\
+			dname, DFOURCC, bpp, STORE, ro, go, bo)
+
+#define RGB32_TO_RGB_DECLARE(dname, DFOURCC, bpp, STORE, ro, go, bo)	\
+	CONV_DECLARE(rgb32_to_##dname);
+
+CONV_RGB_OUTPUTS(YUV_TO_RGB_DECLARE)
+CONV_RGB_LAYOUTS(RGB32_TO_RGB_DECLARE)
+
+#define CONV_ENTRY(sname, SFOURCC, dname, DFOURCC)			\
+	{ VIDCAP_FOURCC_##SFOURCC, VIDCAP_FOURCC_##DFOURCC,		\
+		conv_##sname##_to_##dname, #sname "->" #dname },
+
+#define YUV420_TO_RGB_ENTRY(sname, SFOURCC, c_step,			\
+		dname, DFOURCC, bpp, STORE, ro, go, bo)			\
+	CONV_ENTRY(sname, SFOURCC, dname, DFOURCC)
+
+#define YUV422_TO_RGB_ENTRY(sname, SFOURCC, y0, uo, y1, vo,		\
+		dname, DFOURCC, bpp, STORE, ro, go, bo)			\
+	CONV_ENTRY(sname, SFOURCC, dname, DFOURCC)
+
+#define YUV_TO_RGB_ENTRIES(dname, DFOURCC, bpp, STORE, ro, go, bo)	\
+	CONV_420_SOURCES(YUV420_TO_RGB_ENTRY,				\
+			dname, DFOURCC, bpp, STORE, ro, go, bo)		\
+	CONV_422_SOURCES(YUV422_TO_RGB_ENTRY,				\
+			dname, DFOURCC, bpp, STORE, ro, go, bo)
+
+#define RGB32_TO_RGB_ENTRY(dname, DFOURCC, bpp, STORE, ro, go, bo)	\
+	CONV_ENTRY(rgb32, RGB32, dname, DFOURCC)
 
 struct conv_info
 {
@@ -55,19 +136,34 @@ struct conv_info
 
 static const struct conv_info conv_list[] =
 {
-	{ VIDCAP_FOURCC_I420,  VIDCAP_FOURCC_RGB32, vidcap_i420_to_rgb32,
-		"i420->rgb32" },
-	{ VIDCAP_FOURCC_YUY2,  VIDCAP_FOURCC_RGB32, vidcap_yuy2_to_rgb32,
-		"yuy2->rgb32" },
-	{ VIDCAP_FOURCC_RGB32, VIDCAP_FOURCC_I420,  vidcap_rgb32_to_i420,
+	CONV_RGB_OUTPUTS(YUV_TO_RGB_ENTRIES)
+	CONV_RGB_LAYOUTS(RGB32_TO_RGB_ENTRY)
+
+	{ VIDCAP_FOURCC_RGB32, VIDCAP_FOURCC_I420,  conv_rgb32_to_i420,
 		"rgb32->i420" },
-	{ VIDCAP_FOURCC_YUY2,  VIDCAP_FOURCC_I420,  vidcap_yuy2_to_i420,
+	{ VIDCAP_FOURCC_YUY2,  VIDCAP_FOURCC_I420,  conv_yuy2_to_i420,
 		"yuy2->i420" },
-	{ VIDCAP_FOURCC_I420,  VIDCAP_FOURCC_YUY2,  vidcap_i420_to_yuy2,
+	{ VIDCAP_FOURCC_I420,  VIDCAP_FOURCC_YUY2,  conv_i420_to_yuy2,
 		"i420->yuy2" },
-	{ VIDCAP_FOURCC_RGB32, VIDCAP_FOURCC_YUY2,  vidcap_rgb32_to_yuy2,
+	{ VIDCAP_FOURCC_RGB32, VIDCAP_FOURCC_YUY2,  conv_rgb32_to_yuy2,
 		"rgb32->yuy2" },
 
+	{ VIDCAP_FOURCC_NV12,  VIDCAP_FOURCC_I420,  conv_nv12_to_i420,
+		"nv12->i420" },
+
+	{ VIDCAP_FOURCC_I420,  VIDCAP_FOURCC_RGB_F32, conv_i420_to_rgb_f32,
+		"i420->rgb_f32" },
+	{ VIDCAP_FOURCC_I420,  VIDCAP_FOURCC_RGB_F16, conv_i420_to_rgb_f16,
+		"i420->rgb_f16" },
+	{ VIDCAP_FOURCC_NV12,  VIDCAP_FOURCC_RGB_F32, conv_nv12_to_rgb_f32,
+		"nv12->rgb_f32" },
+	{ VIDCAP_FOURCC_NV12,  VIDCAP_FOURCC_RGB_F16, conv_nv12_to_rgb_f16,
+		"nv12->rgb_f16" },
+	{ VIDCAP_FOURCC_YUY2,  VIDCAP_FOURCC_RGB_F32, conv_yuy2_to_rgb_f32,
+		"yuy2->rgb_f32" },
+	{ VIDCAP_FOURCC_YUY2,  VIDCAP_FOURCC_RGB_F16, conv_yuy2_to_rgb_f16,
+		"yuy2->rgb_f16" },
+
 	{ VIDCAP_FOURCC_2VUY,  VIDCAP_FOURCC_YUY2,  conv_2vuy_to_yuy2,
 		"2vuy->yuy2" },
 	{ VIDCAP_FOURCC_2VUY,  VIDCAP_FOURCC_I420,  conv_2vuy_to_i420,
@@ -76,9 +172,66 @@ static const struct conv_info conv_list[] =
 		"rgb24->rgb32" },
 	{ VIDCAP_FOURCC_BOTTOM_UP_RGB24, VIDCAP_FOURCC_RGB32,
 		conv_bottom_up_rgb24_to_rgb32, "bottom-up rgb24->rgb32" },
+	{ VIDCAP_FOURCC_RGB24_RED_FIRST, VIDCAP_FOURCC_RGB32,
+		conv_rgb24_red_first_to_rgb32, "red-first rgb24->rgb32" },
+	{ VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST, VIDCAP_FOURCC_RGB32,
+		conv_bottom_up_rgb24_red_first_to_rgb32,
+		"bottom-up red-first rgb24->rgb32" },
 
 	{ VIDCAP_FOURCC_YVU9,  VIDCAP_FOURCC_I420,  conv_yvu9_to_i420,
 		"yvu9->i420" },
+
+	{ VIDCAP_FOURCC_GREY,  VIDCAP_FOURCC_I420,  conv_grey_to_i420,
+		"grey->i420" },
+	{ VIDCAP_FOURCC_GREY,  VIDCAP_FOURCC_RGB32, conv_grey_to_rgb32,
+		"grey->rgb32" },
+	{ VIDCAP_FOURCC_I420,  VIDCAP_FOURCC_GREY,  conv_i420_to_grey,
+		"i420->grey" },
+	{ VIDCAP_FOURCC_NV12,  VIDCAP_FOURCC_GREY,  conv_i420_to_grey,
+		"nv12->grey" },
+	{ VIDCAP_FOURCC_YVU9,  VIDCAP_FOURCC_GREY,  conv_i420_to_grey,
+		"yvu9->grey" },
+	{ VIDCAP_FOURCC_YUY2,  VIDCAP_FOURCC_GREY,  conv_yuy2_to_grey,
+		"yuy2->grey" },
+	{ VIDCAP_FOURCC_2VUY,  VIDCAP_FOURCC_GREY,  conv_2vuy_to_grey,
+		"2vuy->grey" },
+	{ VIDCAP_FOURCC_RGB32, VIDCAP_FOURCC_GREY,  conv_rgb32_to_grey,
+		"rgb32->grey" },
+	{ VIDCAP_FOURCC_Y10,   VIDCAP_FOURCC_GREY,  conv_y16_to_grey,
+		"y10->grey" },
+	{ VIDCAP_FOURCC_Y10,   VIDCAP_FOURCC_I420,  conv_y16_to_i420,
+		"y10->i420" },
+	{ VIDCAP_FOURCC_Y10,   VIDCAP_FOURCC_RGB32, conv_y16_to_rgb32,
+		"y10->rgb32" },
+	{ VIDCAP_FOURCC_Y16,   VIDCAP_FOURCC_GREY,  conv_y16_to_grey,
+		"y16->grey" },
+	{ VIDCAP_FOURCC_Y16,   VIDCAP_FOURCC_I420,  conv_y16_to_i420,
+		"y16->i420" },
+	{ VIDCAP_FOURCC_Y16,   VIDCAP_FOURCC_RGB32, conv_y16_to_rgb32,
+		"y16->rgb32" },
+	{ VIDCAP_FOURCC_P010,  VIDCAP_FOURCC_GREY,  conv_y16_to_grey,
+		"p010->grey" },
+	{ VIDCAP_FOURCC_P010,  VIDCAP_FOURCC_I420,  conv_p010_to_i420,
+		"p010->i420" },
+	{ VIDCAP_FOURCC_P010,  VIDCAP_FOURCC_RGB32, conv_p010_to_rgb32,
+		"p010->rgb32" },
+
+	{ VIDCAP_FOURCC_BA81,  VIDCAP_FOURCC_I420,  conv_ba81_to_i420,
+		"ba81->i420" },
+	{ VIDCAP_FOURCC_BA81,  VIDCAP_FOURCC_RGB32, conv_ba81_to_rgb32,
+		"ba81->rgb32" },
+	{ VIDCAP_FOURCC_GBRG,  VIDCAP_FOURCC_I420,  conv_gbrg_to_i420,
+		"gbrg->i420" },
+	{ VIDCAP_FOURCC_GBRG,  VIDCAP_FOURCC_RGB32, conv_gbrg_to_rgb32,
+		"gbrg->rgb32" },
+	{ VIDCAP_FOURCC_GRBG,  VIDCAP_FOURCC_I420,  conv_grbg_to_i420,
+		"grbg->i420" },
+	{ VIDCAP_FOURCC_GRBG,  VIDCAP_FOURCC_RGB32, conv_grbg_to_rgb32,
+		"grbg->rgb32" },
+	{ VIDCAP_FOURCC_RGGB,  VIDCAP_FOURCC_I420,  conv_rggb_to_i420,
+		"rggb->i420" },
+	{ VIDCAP_FOURCC_RGGB,  VIDCAP_FOURCC_RGB32, conv_rggb_to_rgb32,
+		"rggb->rgb32" },
 };
 
 static const int conv_list_len = sizeof(conv_list) / sizeof(struct conv_info);
@@ -87,23 +240,8 @@ static int
 destride_packed(int image_byte_width, int height, int stride,
 		const char * src, char * dst)
 {
-	/* destride a packed structure */
-	char * dst_even = dst;
-	char * dst_odd = dst + image_byte_width;
-	const char * src_even = src;
-	const char * src_odd = src + stride;
-
-	int i;
-	for ( i = 0; i < height / 2; ++i )
-	{
-		memcpy(dst_even, src_even, image_byte_width);
-		memcpy(dst_odd, src_odd, image_byte_width);
-		
-		dst_even += 2 * image_byte_width;
-		dst_odd += 2 * image_byte_width;
-		src_even += 2 * stride;
-		src_odd += 2 * stride;
-	}
+	frame_copy_rows(dst, image_byte_width, src, stride,
+			image_byte_width, height);
 
 	return 0;
 }
@@ -116,53 +254,12 @@ destride_planar(int width, int height,
 		const char * src_y, const char * src_u, const char * src_v,
 		char * dst)
 {
-	char * dst_y_even = dst;
-	char * dst_y_odd = dst + width;
-	char * dst_u_even = dst + width * height;
-	char * dst_u_odd = dst_u_even + u_width;
-	char * dst_v_even = dst_u_even + u_width * u_height;
-	char * dst_v_odd = dst_v_even + v_width;
-	const char * src_y_even = src_y;
-	const char * src_y_odd = src_y + y_stride;
-	const char * src_u_even = src_u;
-	const char * src_u_odd = src_u + u_stride;
-	const char * src_v_even = src_v;
-	const char * src_v_odd = src_v + v_stride;
-
-	int i;
-
-	for ( i = 0; i < height / 2; ++i )
-	{
-		memcpy(dst_y_even, src_y_even, width);
-		memcpy(dst_y_odd, src_y_odd, width);
-
-		dst_y_even += 2 * width;
-		dst_y_odd += 2 * width;
-		src_y_even += 2 * y_stride;
-		src_y_odd += 2 * y_stride;
-	}
-
-	for ( i = 0; i < u_height / 2; ++i )
-	{
-		memcpy(dst_u_even, src_u_even, u_width);
-		memcpy(dst_u_odd, src_u_odd, u_width);
-
-		dst_u_even += 2 * u_width;
-		dst_u_odd += 2 * u_width;
-		src_u_even += 2 * u_stride;
-		src_u_odd += 2 * u_stride;
-	}
-
-	for ( i = 0; i < v_height / 2; ++i )
-	{
-		memcpy(dst_v_even, src_v_even, v_width);
-		memcpy(dst_v_odd, src_v_odd, v_width);
+	char * dst_u = dst + width * height;
+	char * dst_v = dst_u + u_width * u_height;
 
-		dst_v_even += 2 * v_width;
-		dst_v_odd += 2 * v_width;
-		src_v_even += 2 * v_stride;
-		src_v_odd += 2 * v_stride;
-	}
+	frame_copy_rows(dst, width, src_y, y_stride, width, height);
+	frame_copy_rows(dst_u, u_width, src_u, u_stride, u_width, u_height);
+	frame_copy_rows(dst_v, v_width, src_v, v_stride, v_width, v_height);
 
 	return 0;
 }
@@ -226,10 +323,49 @@ destridify(int width, int height, int fourcc, int stride,
 		return destride_packed(3 * width, height, stride, src, dst);
 		break;
 	case VIDCAP_FOURCC_BOTTOM_UP_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST:
 		if ( stride == 3 * width )
 			return -1;
 		return destride_packed(3 * width, height, stride, src, dst);
 		break;
+	case VIDCAP_FOURCC_GREY:
+	case VIDCAP_FOURCC_BA81:
+	case VIDCAP_FOURCC_GBRG:
+	case VIDCAP_FOURCC_GRBG:
+	case VIDCAP_FOURCC_RGGB:
+		if ( stride == width )
+			return -1;
+		return destride_packed(width, height, stride, src, dst);
+		break;
+	case VIDCAP_FOURCC_Y10:
+	case VIDCAP_FOURCC_Y16:
+		if ( stride == 2 * width )
+			return -1;
+		return destride_packed(2 * width, height, stride, src, dst);
+		break;
+	case VIDCAP_FOURCC_P010:
+		/* the interleaved chroma plane shares the luma stride */
+		if ( stride == 2 * width )
+			return -1;
+		destride_packed(2 * width, height, stride, src, dst);
+		return destride_packed(2 * width, height / 2, stride,
+				src + height * stride,
+				dst + 2 * width * height);
+		break;
+	case VIDCAP_FOURCC_NV12:
+		/* the interleaved chroma plane shares the luma stride */
+		if ( stride == width )
+			return -1;
+		destride_packed(width, height, stride, src, dst);
+		return destride_packed(width, height / 2, stride,
+				src + height * stride, dst + width * height);
+		break;
+	case VIDCAP_FOURCC_MJPG:
+	case VIDCAP_FOURCC_H264:
+		/* compressed payloads have no stride to remove */
+		return -1;
+		break;
 	case VIDCAP_FOURCC_YVU9: {
 		/** \bug only destride if necessary */
 		const char * src_y = src;
@@ -276,24 +412,316 @@ conv_fmt_size_get(int width, int height, int fourcc)
 	switch ( fourcc )
 	{
 	case VIDCAP_FOURCC_I420:
+	case VIDCAP_FOURCC_NV12:
 		return pixels * 3 / 2;
 
 	case VIDCAP_FOURCC_RGB24:
 	case VIDCAP_FOURCC_BOTTOM_UP_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BGR24:
 		return pixels * 3;
 
 	case VIDCAP_FOURCC_RGB32:
+	case VIDCAP_FOURCC_BGRA:
+	case VIDCAP_FOURCC_RGBA:
+	case VIDCAP_FOURCC_ARGB:
 		return pixels * 4;
 
+	case VIDCAP_FOURCC_GREY:
+	case VIDCAP_FOURCC_BA81:
+	case VIDCAP_FOURCC_GBRG:
+	case VIDCAP_FOURCC_GRBG:
+	case VIDCAP_FOURCC_RGGB:
+		return pixels;
+
+	case VIDCAP_FOURCC_P010:
+		return pixels * 3;
+
+	case VIDCAP_FOURCC_RGB_F32:
+		return pixels * 12;
+
+	case VIDCAP_FOURCC_RGB_F16:
+		return pixels * 6;
+
+	case VIDCAP_FOURCC_Y10:
+	case VIDCAP_FOURCC_Y16:
+	case VIDCAP_FOURCC_RGB565:
 	case VIDCAP_FOURCC_RGB555:
 	case VIDCAP_FOURCC_YUY2:
 	case VIDCAP_FOURCC_2VUY:
 		return pixels * 2;
+
+	case VIDCAP_FOURCC_MJPG:
+	case VIDCAP_FOURCC_H264:
+		/* Upper bound only (this is what UVC devices advertise as
+		 * their maximum frame size). The real size comes with
+		 * each frame.
+		 */
+		return pixels * 2;
+	default:
+		return 0;
+	}
+}
+
+int
+conv_fmt_planes_get(int fourcc, int width, int height,
+		int row_bytes[3], int rows[3])
+{
+	int bytes_per_pixel;
+
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_I420:
+		row_bytes[0] = width;
+		row_bytes[1] = row_bytes[2] = width / 2;
+		rows[0] = height;
+		rows[1] = rows[2] = height / 2;
+		return 3;
+
+	case VIDCAP_FOURCC_YVU9:
+		row_bytes[0] = width;
+		row_bytes[1] = row_bytes[2] = width / 4;
+		rows[0] = height;
+		rows[1] = rows[2] = height / 4;
+		return 3;
+
+	case VIDCAP_FOURCC_NV12:
+	case VIDCAP_FOURCC_P010:
+		/* chroma pairs span as many bytes as a luma row */
+		row_bytes[0] = row_bytes[1] =
+			fourcc == VIDCAP_FOURCC_P010 ? 2 * width : width;
+		rows[0] = height;
+		rows[1] = height / 2;
+		return 2;
+
+	case VIDCAP_FOURCC_RGB_F32:
+	case VIDCAP_FOURCC_RGB_F16:
+		row_bytes[0] = row_bytes[1] = row_bytes[2] =
+			fourcc == VIDCAP_FOURCC_RGB_F32 ? 4 * width : 2 * width;
+		rows[0] = rows[1] = rows[2] = height;
+		return 3;
+
+	default:
+		break;
+	}
+
+	if ( conv_fmt_is_compressed(fourcc) ||
+			!(bytes_per_pixel = conv_fmt_size_get(1, 1, fourcc)) )
+		return 0;
+
+	row_bytes[0] = bytes_per_pixel * width;
+	rows[0] = height;
+	return 1;
+}
+
+void
+conv_params_init(struct conv_params * params)
+{
+	memset(params, 0, sizeof(*params));
+
+	params->demosaic = VIDCAP_DEMOSAIC_BILINEAR;
+	params->threads = 1;
+	params->color = colorimetry_get(VIDCAP_COLORIMETRY_BT601,
+			VIDCAP_RANGE_LIMITED);
+	params->tensor_scale[0] = 1.0f / 255.0f;
+	params->tensor_scale[1] = 1.0f / 255.0f;
+	params->tensor_scale[2] = 1.0f / 255.0f;
+}
+
+int
+conv_fmt_is_compressed(int fourcc)
+{
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_MJPG:
+	case VIDCAP_FOURCC_H264:
+		return 1;
 	default:
 		return 0;
 	}
 }
 
+int
+conv_fmt_bit_shift_get(int fourcc)
+{
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_Y10:
+		return 2;
+	case VIDCAP_FOURCC_Y16:
+	case VIDCAP_FOURCC_P010:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+int
+conv_fmt_luma_layout_get(int fourcc, int * step, int * offset)
+{
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_I420:
+	case VIDCAP_FOURCC_NV12:
+	case VIDCAP_FOURCC_YVU9:
+	case VIDCAP_FOURCC_GREY:
+		*step = 1;
+		*offset = 0;
+		return 0;
+	case VIDCAP_FOURCC_YUY2:
+		*step = 2;
+		*offset = 0;
+		return 0;
+	case VIDCAP_FOURCC_2VUY:
+		*step = 2;
+		*offset = 1;
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+int
+conv_fmt_align_get(int fourcc, int * x_align, int * y_align)
+{
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_I420:
+	case VIDCAP_FOURCC_NV12:
+	case VIDCAP_FOURCC_P010:
+	/* whole cells keep the mosaic's phase */
+	case VIDCAP_FOURCC_BA81:
+	case VIDCAP_FOURCC_GBRG:
+	case VIDCAP_FOURCC_GRBG:
+	case VIDCAP_FOURCC_RGGB:
+		*x_align = 2;
+		*y_align = 2;
+		return 0;
+
+	case VIDCAP_FOURCC_YUY2:
+	case VIDCAP_FOURCC_2VUY:
+		*x_align = 2;
+		*y_align = 1;
+		return 0;
+
+	case VIDCAP_FOURCC_RGB24:
+	case VIDCAP_FOURCC_BOTTOM_UP_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_RGB32:
+	case VIDCAP_FOURCC_BGRA:
+	case VIDCAP_FOURCC_RGBA:
+	case VIDCAP_FOURCC_ARGB:
+	case VIDCAP_FOURCC_BGR24:
+	case VIDCAP_FOURCC_RGB565:
+	case VIDCAP_FOURCC_RGB_F32:
+	case VIDCAP_FOURCC_RGB_F16:
+	case VIDCAP_FOURCC_GREY:
+	case VIDCAP_FOURCC_Y10:
+	case VIDCAP_FOURCC_Y16:
+		*x_align = 1;
+		*y_align = 1;
+		return 0;
+
+	default:
+		return -1;
+	}
+}
+
+static void
+crop_plane(int row_bytes, int rows, int src_stride,
+		const char * src, char * dst)
+{
+	frame_copy_rows(dst, row_bytes, src, src_stride, row_bytes, rows);
+}
+
+int
+conv_crop(int width, int height, int fourcc,
+		int x, int y, int crop_width, int crop_height,
+		const char * src, char * dst)
+{
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_I420: {
+		const char * src_u = src + width * height;
+		const char * src_v = src_u + width * height / 4;
+		char * dst_u = dst + crop_width * crop_height;
+		char * dst_v = dst_u + crop_width * crop_height / 4;
+		const int c_offset = (y / 2) * (width / 2) + x / 2;
+
+		crop_plane(crop_width, crop_height, width,
+				src + y * width + x, dst);
+		crop_plane(crop_width / 2, crop_height / 2, width / 2,
+				src_u + c_offset, dst_u);
+		crop_plane(crop_width / 2, crop_height / 2, width / 2,
+				src_v + c_offset, dst_v);
+		return 0;
+		}
+	case VIDCAP_FOURCC_YUY2:
+	case VIDCAP_FOURCC_2VUY:
+		crop_plane(2 * crop_width, crop_height, 2 * width,
+				src + 2 * (y * width + x), dst);
+		return 0;
+	case VIDCAP_FOURCC_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BGR24:
+		crop_plane(3 * crop_width, crop_height, 3 * width,
+				src + 3 * (y * width + x), dst);
+		return 0;
+	case VIDCAP_FOURCC_BOTTOM_UP_RGB24:
+	case VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST:
+		/* The crop stays bottom-up: its first row in memory is
+		 * the bottom row of the region.
+		 */
+		crop_plane(3 * crop_width, crop_height, 3 * width,
+				src + 3 * ((height - y - crop_height) * width + x),
+				dst);
+		return 0;
+	case VIDCAP_FOURCC_RGB32:
+	case VIDCAP_FOURCC_BGRA:
+	case VIDCAP_FOURCC_RGBA:
+	case VIDCAP_FOURCC_ARGB:
+		crop_plane(4 * crop_width, crop_height, 4 * width,
+				src + 4 * (y * width + x), dst);
+		return 0;
+	case VIDCAP_FOURCC_GREY:
+	case VIDCAP_FOURCC_BA81:
+	case VIDCAP_FOURCC_GBRG:
+	case VIDCAP_FOURCC_GRBG:
+	case VIDCAP_FOURCC_RGGB:
+		crop_plane(crop_width, crop_height, width,
+				src + y * width + x, dst);
+		return 0;
+	case VIDCAP_FOURCC_Y10:
+	case VIDCAP_FOURCC_Y16:
+	case VIDCAP_FOURCC_RGB565:
+		crop_plane(2 * crop_width, crop_height, 2 * width,
+				src + 2 * (y * width + x), dst);
+		return 0;
+	case VIDCAP_FOURCC_P010:
+		crop_plane(2 * crop_width, crop_height, 2 * width,
+				src + 2 * (y * width + x), dst);
+		/* one u,v pair of 16-bit samples per two pixels */
+		crop_plane(2 * crop_width, crop_height / 2, 2 * width,
+				src + 2 * width * height + (y / 2) * 2 * width +
+				2 * x,
+				dst + 2 * crop_width * crop_height);
+		return 0;
+	case VIDCAP_FOURCC_NV12:
+		crop_plane(crop_width, crop_height, width,
+				src + y * width + x, dst);
+		crop_plane(crop_width, crop_height / 2, width,
+				src + width * height + (y / 2) * width + x,
+				dst + crop_width * crop_height);
+		return 0;
+	default:
+		log_error("cannot crop fourcc [%s]\n",
+				vidcap_fourcc_string_get(fourcc));
+		return -1;
+	}
+}
+
 const char *
 conv_conversion_name_get(conv_func function)
 {
@@ -39,6 +39,8 @@
 #include <vidcap/vidcap.h>
 #include <vidcap/converters.h>
 
+struct colorimetry;
+
 enum vidcap_fourccs_extra
 {
 	VIDCAP_FOURCC_RGB555 = 200,
@@ -46,9 +48,25 @@ enum vidcap_fourccs_extra
 	VIDCAP_FOURCC_2VUY   = 202,
 	VIDCAP_FOURCC_RGB24  = 203,
 	VIDCAP_FOURCC_BOTTOM_UP_RGB24  = 204,
+	/* rgb24 with red first in memory */
+	VIDCAP_FOURCC_RGB24_RED_FIRST  = 205,
+	VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST  = 206,
+};
+
+/** Per-source settings of a conversion */
+struct conv_params
+{
+	int bit_shift; /**< right shift taking high bit depth samples to 8 bits */
+	int demosaic;  /**< enum vidcap_demosaic used for Bayer sources */
+	int threads;   /**< threads a conversion may split across */
+	int chroma_average; /**< average chroma rows going from 4:2:2 to 4:2:0 */
+	float tensor_scale[3]; /**< per channel scale of float rgb outputs */
+	float tensor_bias[3];  /**< per channel bias of float rgb outputs */
+	const struct colorimetry * color; /**< matrix and range of yuv */
 };
 
-typedef int (*conv_func)(int width, int height, const char * src, char * dst);
+typedef int (*conv_func)(const struct conv_params * params,
+		int width, int height, const char * src, char * dst);
 
 #ifdef __cplusplus
 extern "C" {
@@ -79,6 +97,132 @@ conv_conversion_func_get(int src_fourcc, int dst_fourcc);
 int
 conv_fmt_size_get(int width, int height, int fourcc);
 
+/**
+ *  \brief Get the plane layout of a fourcc
+ *  
+ *  \param [in]  width     Width of the frame
+ *  \param [in]  height    Height of the frame
+ *  \param [in]  fourcc    Fourcc of the frame
+ *  \param [out] row_bytes Bytes in one row of each plane
+ *  \param [out] rows      Rows of each plane
+ *  \return The number of planes, 0 for unknown and compressed fourccs
+ *  
+ *  \details Tightly packed frames hold the planes one after the other
+ *           in this order.
+ */
+int
+conv_fmt_planes_get(int fourcc, int width, int height,
+		int row_bytes[3], int rows[3]);
+
+/**
+ *  \brief Set conversion parameters to their defaults
+ *  
+ *  \param [out] params Parameters to initialize
+ *  
+ *  \details The defaults are those of a newly acquired source, except
+ *           for bit_shift which depends on the source fourcc.
+ */
+void
+conv_params_init(struct conv_params * params);
+
+/**
+ *  \brief Convert between tightly packed frames with default parameters
+ *  
+ *  \param [in] src_fourcc Fourcc of the source frame
+ *  \param [in] dst_fourcc Fourcc of the destination frame
+ *  \param [in] width      Width of the frames
+ *  \param [in] height     Height of the frames
+ *  \param [in] src        Source frame
+ *  \param [in] dst        Destination frame
+ *  \return Returns 0 on success
+ *  
+ *  \details Backs the vidcap_*_to_* converters. See
+ *           vidcap_convert_planes().
+ */
+int
+conv_packed(int src_fourcc, int dst_fourcc, int width, int height,
+		const char * src, char * dst);
+
+/**
+ *  \brief Tells whether a fourcc is a compressed (passthrough-only) format
+ *  
+ *  \param [in] fourcc Fourcc to check
+ *  \return 1 if compressed, 0 otherwise
+ *  
+ *  \details Compressed frames are never destrided nor converted. Their
+ *           size is only known per frame.
+ */
+int
+conv_fmt_is_compressed(int fourcc);
+
+/**
+ *  \brief Get the shift bringing the samples of a fourcc to 8 bits
+ *  
+ *  \param [in] fourcc Fourcc of the frame
+ *  \return The right shift, 0 for 8-bit formats
+ */
+int
+conv_fmt_bit_shift_get(int fourcc);
+
+/**
+ *  \brief Get where the 8-bit luma samples of a fourcc lie in a row
+ *  
+ *  \param [in]  fourcc Fourcc of the frame
+ *  \param [out] step   Bytes between the luma samples of a row
+ *  \param [out] offset Bytes before the first luma sample of a row
+ *  \return Returns 0 on success, -1 if the fourcc has no 8-bit luma
+ *  
+ *  \details Luma rows are step * width bytes apart from the start of
+ *           the frame.
+ */
+int
+conv_fmt_luma_layout_get(int fourcc, int * step, int * offset);
+
+/**
+ *  \brief Narrow little-endian 16-bit samples to 8 bits
+ *  
+ *  \param [in] src   Source samples
+ *  \param [in] dst   Destination samples
+ *  \param [in] n     Number of samples
+ *  \param [in] shift Right shift applied before saturating to 255
+ */
+void
+conv_u16_to_u8(const char * src, char * dst, int n, int shift);
+
+/**
+ *  \brief Get the pixel alignment a fourcc imposes on regions
+ *  
+ *  \param [in]  fourcc  Fourcc of the frame
+ *  \param [out] x_align Required multiple for x offsets and widths
+ *  \param [out] y_align Required multiple for y offsets and heights
+ *  \return Returns 0 on success, -1 if the fourcc cannot be cropped
+ */
+int
+conv_fmt_align_get(int fourcc, int * x_align, int * y_align);
+
+/**
+ *  \brief Copy a rectangular region out of a tightly packed frame
+ *  
+ *  \param [in] width       Width of the source frame
+ *  \param [in] height      Height of the source frame
+ *  \param [in] fourcc      Fourcc of both source and destination
+ *  \param [in] x           Left edge of the region
+ *  \param [in] y           Top edge of the region
+ *  \param [in] crop_width  Width of the region
+ *  \param [in] crop_height Height of the region
+ *  \param [in] src         Source frame
+ *  \param [in] dst         Destination, a tightly packed frame of the
+ *                          region's size
+ *  \return Returns 0 on success
+ *  
+ *  \details The region must lie within the frame and respect
+ *           conv_fmt_align_get().
+ */
+int
+conv_crop(int width, int height, int fourcc,
+		int x, int y, int crop_width, int crop_height,
+		const char * src, char * dst);
+
 /**
  *  \brief conv_conversion_name_get
  *  
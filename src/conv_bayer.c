@@ -0,0 +1,555 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file conv_bayer.c
+ *  \ingroup Core
+ *  \brief Demosaicing of raw Bayer frames to rgb32 and i420.
+ */
+
+#include <stdlib.h>
+
+#include "colorimetry.h"
+#include "conv.h"
+#include "cpu.h"
+#include "logging.h"
+#include "os_funcs.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+enum
+{
+	bayer_to_rgb32,
+	bayer_to_i420,
+
+	/* Slices smaller than this are not worth a thread */
+	bayer_min_slice_rows = 32,
+	bayer_max_threads = 16,
+};
+
+/* Where red sits in each 2x2 cell. Blue is diagonal from it and both
+ * other sites are green.
+ */
+struct bayer_pattern
+{
+	int red_x;
+	int red_y;
+};
+
+struct bayer_slice
+{
+	const struct conv_params * params;
+	struct bayer_pattern pattern;
+	int out_fourcc;
+	int width;
+	int height;
+	int y0;
+	int y1;
+	const unsigned char * src;
+	unsigned char * dst;
+	int ret;
+
+	int threaded;
+	vc_thread thread;
+	unsigned int thread_id;
+};
+
+/* Mirror coordinates about the frame edges. An even distance keeps the
+ * Bayer phase of the mirrored site.
+ */
+static __inline int
+reflect(int i, int n)
+{
+	if ( i < 0 )
+		return -i;
+	if ( i >= n )
+		return 2 * n - 2 - i;
+	return i;
+}
+
+static __inline int
+clamp255(int v)
+{
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+static __inline unsigned int
+compose_rgb32(int r, int g, int b)
+{
+	return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+/* Bilinear interpolation of one site from the rows above (a), at (c)
+ * and below (b) it.
+ */
+static __inline unsigned int
+bilinear_site(const unsigned char * a, const unsigned char * c,
+		const unsigned char * b, int xl, int x, int xr,
+		int red_row, int primary)
+{
+	const int cross = (a[x] + b[x] + c[xl] + c[xr] + 2) >> 2;
+	const int diag = (a[xl] + a[xr] + b[xl] + b[xr] + 2) >> 2;
+	const int h = (c[xl] + c[xr] + 1) >> 1;
+	const int v = (a[x] + b[x] + 1) >> 1;
+
+	if ( primary )
+		return red_row ? compose_rgb32(c[x], cross, diag) :
+			compose_rgb32(diag, cross, c[x]);
+
+	return red_row ? compose_rgb32(h, c[x], v) :
+		compose_rgb32(v, c[x], h);
+}
+
+static void
+bilinear_row_c(const unsigned char * a, const unsigned char * c,
+		const unsigned char * b, unsigned int * dst,
+		int x0, int x1, int width, int red_row, int primary_x)
+{
+	int x;
+
+	for ( x = x0; x < x1; ++x )
+		dst[x] = bilinear_site(a, c, b,
+				reflect(x - 1, width), x, reflect(x + 1, width),
+				red_row, (x & 1) == primary_x);
+}
+
+#ifdef CPU_X86
+static __inline __m128i
+select_epi8(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+CPU_TARGET("sse2") static __m128i
+avg4_epu8(__m128i p, __m128i q, __m128i r, __m128i s)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	__m128i lo, hi;
+
+	lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(p, zero),
+				_mm_unpacklo_epi8(q, zero)),
+			_mm_add_epi16(_mm_unpacklo_epi8(r, zero),
+				_mm_unpacklo_epi8(s, zero)));
+	hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(p, zero),
+				_mm_unpackhi_epi8(q, zero)),
+			_mm_add_epi16(_mm_unpackhi_epi8(r, zero),
+				_mm_unpackhi_epi8(s, zero)));
+
+	return _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(lo, two), 2),
+			_mm_srli_epi16(_mm_add_epi16(hi, two), 2));
+}
+
+/* All four interpolations are computed for 16 sites, then each site
+ * picks the ones its phase needs.
+ */
+CPU_TARGET("sse2") static void
+bilinear_row_sse2(const unsigned char * a, const unsigned char * c,
+		const unsigned char * b, unsigned int * dst,
+		int width, int red_row, int primary_x)
+{
+	const __m128i primary = primary_x ? _mm_set1_epi16((short)0xff00) :
+		_mm_set1_epi16(0x00ff);
+	const __m128i alpha = _mm_set1_epi8((char)0xff);
+	int x;
+
+	/* Columns 0 and 1 and the tail need mirroring */
+	bilinear_row_c(a, c, b, dst, 0, 2, width, red_row, primary_x);
+
+	for ( x = 2; x + 17 <= width; x += 16 )
+	{
+		const __m128i va = _mm_loadu_si128((const __m128i *)(a + x));
+		const __m128i vb = _mm_loadu_si128((const __m128i *)(b + x));
+		const __m128i vc = _mm_loadu_si128((const __m128i *)(c + x));
+		const __m128i al = _mm_loadu_si128((const __m128i *)(a + x - 1));
+		const __m128i ar = _mm_loadu_si128((const __m128i *)(a + x + 1));
+		const __m128i bl = _mm_loadu_si128((const __m128i *)(b + x - 1));
+		const __m128i br = _mm_loadu_si128((const __m128i *)(b + x + 1));
+		const __m128i cl = _mm_loadu_si128((const __m128i *)(c + x - 1));
+		const __m128i cr = _mm_loadu_si128((const __m128i *)(c + x + 1));
+
+		const __m128i cross = avg4_epu8(va, vb, cl, cr);
+		const __m128i diag = avg4_epu8(al, ar, bl, br);
+		const __m128i h = _mm_avg_epu8(cl, cr);
+		const __m128i v = _mm_avg_epu8(va, vb);
+
+		/* The primary site holds red on red rows, blue otherwise */
+		const __m128i own = select_epi8(primary, vc, h);
+		const __m128i other = select_epi8(primary, diag, v);
+		const __m128i g = select_epi8(primary, cross, vc);
+		const __m128i r = red_row ? own : other;
+		const __m128i bl_ = red_row ? other : own;
+
+		const __m128i bg_lo = _mm_unpacklo_epi8(bl_, g);
+		const __m128i bg_hi = _mm_unpackhi_epi8(bl_, g);
+		const __m128i ra_lo = _mm_unpacklo_epi8(r, alpha);
+		const __m128i ra_hi = _mm_unpackhi_epi8(r, alpha);
+		__m128i * d = (__m128i *)(dst + x);
+
+		_mm_storeu_si128(d, _mm_unpacklo_epi16(bg_lo, ra_lo));
+		_mm_storeu_si128(d + 1, _mm_unpackhi_epi16(bg_lo, ra_lo));
+		_mm_storeu_si128(d + 2, _mm_unpacklo_epi16(bg_hi, ra_hi));
+		_mm_storeu_si128(d + 3, _mm_unpackhi_epi16(bg_hi, ra_hi));
+	}
+
+	bilinear_row_c(a, c, b, dst, x, width, width, red_row, primary_x);
+}
+#endif
+
+/* Green at a red or blue site, interpolated along the direction with
+ * the smaller gradient and corrected by the local curvature of the
+ * site's own colour (Hamilton-Adams).
+ */
+static int
+edge_green(const unsigned char * const rows[5], int x, int width)
+{
+	const unsigned char * c = rows[2];
+	const int xl = reflect(x - 1, width);
+	const int xr = reflect(x + 1, width);
+	const int xl2 = reflect(x - 2, width);
+	const int xr2 = reflect(x + 2, width);
+	const int curve_h = 2 * c[x] - c[xl2] - c[xr2];
+	const int curve_v = 2 * c[x] - rows[0][x] - rows[4][x];
+	const int grad_h = abs(c[xl] - c[xr]) + abs(curve_h);
+	const int grad_v = abs(rows[1][x] - rows[3][x]) + abs(curve_v);
+	const int est_h = 2 * (c[xl] + c[xr]) + curve_h;
+	const int est_v = 2 * (rows[1][x] + rows[3][x]) + curve_v;
+
+	if ( grad_h < grad_v )
+		return clamp255((est_h + 2) >> 2);
+	if ( grad_v < grad_h )
+		return clamp255((est_v + 2) >> 2);
+	return clamp255((est_h + est_v + 4) >> 3);
+}
+
+static void
+edge_green_row(const struct bayer_slice * sl, int y, unsigned char * green)
+{
+	const int red_row = (y & 1) == sl->pattern.red_y;
+	const int primary_x = red_row ? sl->pattern.red_x :
+		!sl->pattern.red_x;
+	const unsigned char * rows[5];
+	int i, x;
+
+	for ( i = 0; i < 5; ++i )
+		rows[i] = sl->src + reflect(y + i - 2, sl->height) * sl->width;
+
+	for ( x = 0; x < sl->width; ++x )
+		green[x] = (unsigned char)((x & 1) == primary_x ?
+				edge_green(rows, x, sl->width) : rows[2][x]);
+}
+
+/* Red and blue are interpolated as differences to green, which varies
+ * far less across edges than the colours themselves.
+ */
+static void
+edge_row(const struct bayer_slice * sl, int y,
+		unsigned char * const green[3], unsigned int * dst)
+{
+	const int width = sl->width;
+	const int red_row = (y & 1) == sl->pattern.red_y;
+	const int primary_x = red_row ? sl->pattern.red_x :
+		!sl->pattern.red_x;
+	const unsigned char * a =
+		sl->src + reflect(y - 1, sl->height) * width;
+	const unsigned char * c = sl->src + y * width;
+	const unsigned char * b =
+		sl->src + reflect(y + 1, sl->height) * width;
+	const unsigned char * ga = green[0];
+	const unsigned char * gc = green[1];
+	const unsigned char * gb = green[2];
+	int x;
+
+	for ( x = 0; x < width; ++x )
+	{
+		const int xl = reflect(x - 1, width);
+		const int xr = reflect(x + 1, width);
+		const int g = gc[x];
+		int own, other_h, other_v;
+
+		if ( (x & 1) == primary_x )
+		{
+			const int diag = g + ((a[xl] - ga[xl]) + (a[xr] - ga[xr]) +
+					(b[xl] - gb[xl]) + (b[xr] - gb[xr])) / 4;
+
+			own = c[x];
+			other_h = other_v = clamp255(diag);
+		}
+		else
+		{
+			other_h = clamp255(g + ((c[xl] - gc[xl]) +
+						(c[xr] - gc[xr])) / 2);
+			other_v = clamp255(g + ((a[x] - ga[x]) +
+						(b[x] - gb[x])) / 2);
+			own = -1;
+		}
+
+		if ( own >= 0 )
+			dst[x] = red_row ? compose_rgb32(own, g, other_h) :
+				compose_rgb32(other_h, g, own);
+		else
+			dst[x] = red_row ? compose_rgb32(other_h, g, other_v) :
+				compose_rgb32(other_v, g, other_h);
+	}
+}
+
+/* Same arithmetic as conv_rgb32_to_i420(): chroma comes from the top
+ * left pixel of each 2x2 block.
+ */
+static void
+rgb32_rows_to_i420(const struct colorimetry * c, const unsigned int * even,
+		const unsigned int * odd, int width, unsigned char * y_even,
+		unsigned char * y_odd, unsigned char * u, unsigned char * v)
+{
+	int x;
+
+	for ( x = 0; x < width; ++x )
+	{
+		const int r0 = (even[x] >> 16) & 0xff;
+		const int g0 = (even[x] >> 8) & 0xff;
+		const int b0 = even[x] & 0xff;
+		const int r1 = (odd[x] >> 16) & 0xff;
+		const int g1 = (odd[x] >> 8) & 0xff;
+		const int b1 = odd[x] & 0xff;
+
+		y_even[x] = colorimetry_y(c, r0, g0, b0);
+		y_odd[x] = colorimetry_y(c, r1, g1, b1);
+
+		if ( !(x & 1) )
+		{
+			u[x / 2] = colorimetry_u(c, r0, g0, b0);
+			v[x / 2] = colorimetry_v(c, r0, g0, b0);
+		}
+	}
+}
+
+static void
+demosaic_row(const struct bayer_slice * sl, int y,
+		unsigned char * const green[3], unsigned int * dst)
+{
+	const int width = sl->width;
+	const int red_row = (y & 1) == sl->pattern.red_y;
+	const int primary_x = red_row ? sl->pattern.red_x :
+		!sl->pattern.red_x;
+	const unsigned char * a =
+		sl->src + reflect(y - 1, sl->height) * width;
+	const unsigned char * c = sl->src + y * width;
+	const unsigned char * b =
+		sl->src + reflect(y + 1, sl->height) * width;
+
+	if ( sl->params->demosaic == VIDCAP_DEMOSAIC_EDGE_AWARE )
+	{
+		edge_row(sl, y, green, dst);
+		return;
+	}
+
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+	{
+		bilinear_row_sse2(a, c, b, dst, width, red_row, primary_x);
+		return;
+	}
+#endif
+
+	bilinear_row_c(a, c, b, dst, 0, width, width, red_row, primary_x);
+}
+
+static int
+bayer_slice_run(struct bayer_slice * sl)
+{
+	const int width = sl->width;
+	const int edge = sl->params->demosaic == VIDCAP_DEMOSAIC_EDGE_AWARE;
+	unsigned char * green_buf = 0;
+	unsigned char * green[3] = { 0, 0, 0 };
+	unsigned int * rgb_buf = 0;
+	int y;
+
+	/* Rolling window of interpolated green rows y - 1, y and y + 1 */
+	if ( edge && !(green_buf = malloc(3 * width)) )
+		goto bail_oom;
+
+	if ( sl->out_fourcc == bayer_to_i420 &&
+			!(rgb_buf = malloc(2 * width * sizeof(unsigned int))) )
+		goto bail_oom;
+
+	if ( edge )
+	{
+		green[0] = green_buf;
+		green[1] = green_buf + width;
+		green[2] = green_buf + 2 * width;
+		edge_green_row(sl, reflect(sl->y0 - 1, sl->height), green[0]);
+		edge_green_row(sl, sl->y0, green[1]);
+		edge_green_row(sl, sl->y0 + 1, green[2]);
+	}
+
+	for ( y = sl->y0; y < sl->y1; ++y )
+	{
+		unsigned int * out;
+
+		if ( edge && y > sl->y0 )
+		{
+			unsigned char * oldest = green[0];
+
+			green[0] = green[1];
+			green[1] = green[2];
+			green[2] = oldest;
+			edge_green_row(sl, reflect(y + 1, sl->height), green[2]);
+		}
+
+		if ( sl->out_fourcc == bayer_to_rgb32 )
+			out = (unsigned int *)sl->dst + y * width;
+		else
+			out = rgb_buf + (y & 1) * width;
+
+		demosaic_row(sl, y, green, out);
+
+		if ( sl->out_fourcc == bayer_to_i420 && (y & 1) )
+		{
+			unsigned char * dst_y = sl->dst + (y - 1) * width;
+			unsigned char * dst_u = sl->dst + width * sl->height +
+				(y / 2) * (width / 2);
+			unsigned char * dst_v = dst_u +
+				width * sl->height / 4;
+
+			rgb32_rows_to_i420(sl->params->color, rgb_buf,
+					rgb_buf + width, width, dst_y,
+					dst_y + width, dst_u, dst_v);
+		}
+	}
+
+	free(green_buf);
+	free(rgb_buf);
+	return 0;
+
+bail_oom:
+	log_oom(__FILE__, __LINE__);
+	free(green_buf);
+	free(rgb_buf);
+	return -1;
+}
+
+static unsigned int
+STDCALL bayer_slice_thread(void * arg)
+{
+	struct bayer_slice * sl = (struct bayer_slice *)arg;
+
+	sl->ret = bayer_slice_run(sl);
+
+	return 0;
+}
+
+/* Frames are cut into horizontal slices of whole 2x2 cells. Each slice
+ * only reads the source, so slices can run on separate threads.
+ */
+static int
+bayer_convert(const struct conv_params * params,
+		int red_x, int red_y, int out_fourcc,
+		int width, int height, const char * src, char * dst)
+{
+	struct bayer_slice slices[bayer_max_threads];
+	int num_slices = params->threads > 1 ? params->threads : 1;
+	int rows_per_slice;
+	int ret = 0;
+	int i;
+
+	if ( width < 4 || height < 4 || (width & 1) || (height & 1) )
+	{
+		log_error("invalid bayer frame size %dx%d\n", width, height);
+		return -1;
+	}
+
+	if ( num_slices > bayer_max_threads )
+		num_slices = bayer_max_threads;
+
+	if ( num_slices > height / bayer_min_slice_rows )
+		num_slices = height / bayer_min_slice_rows;
+
+	if ( num_slices < 1 )
+		num_slices = 1;
+
+	rows_per_slice = (height / num_slices + 1) & ~1;
+
+	for ( i = 0; i < num_slices; ++i )
+	{
+		struct bayer_slice * sl = &slices[i];
+
+		sl->params = params;
+		sl->pattern.red_x = red_x;
+		sl->pattern.red_y = red_y;
+		sl->out_fourcc = out_fourcc;
+		sl->width = width;
+		sl->height = height;
+		sl->y0 = i * rows_per_slice;
+		sl->y1 = i == num_slices - 1 ? height :
+			(i + 1) * rows_per_slice;
+		sl->src = (const unsigned char *)src;
+		sl->dst = (unsigned char *)dst;
+		sl->ret = 0;
+		sl->threaded = 0;
+	}
+
+	/* Run the first slice on the calling thread. A slice whose thread
+	 * cannot be started also runs here.
+	 */
+	for ( i = 1; i < num_slices; ++i )
+		slices[i].threaded = !vc_create_thread(&slices[i].thread,
+				bayer_slice_thread, &slices[i],
+				&slices[i].thread_id);
+
+	ret = bayer_slice_run(&slices[0]);
+
+	for ( i = 1; i < num_slices; ++i )
+	{
+		if ( slices[i].threaded )
+			vc_thread_join(&slices[i].thread);
+		else
+			slices[i].ret = bayer_slice_run(&slices[i]);
+
+		if ( slices[i].ret )
+			ret = -1;
+	}
+
+	return ret;
+}
+
+#define BAYER_CONV(name, red_x, red_y)					\
+	int conv_##name##_to_rgb32(const struct conv_params * p,	\
+			int w, int h, const char * s, char * d)		\
+	{								\
+		return bayer_convert(p, red_x, red_y, bayer_to_rgb32,	\
+				w, h, s, d);				\
+	}								\
+	int conv_##name##_to_i420(const struct conv_params * p,	\
+			int w, int h, const char * s, char * d)		\
+	{								\
+		return bayer_convert(p, red_x, red_y, bayer_to_i420,	\
+				w, h, s, d);				\
+	}
+
+BAYER_CONV(ba81, 1, 1)
+BAYER_CONV(gbrg, 0, 1)
+BAYER_CONV(grbg, 1, 0)
+BAYER_CONV(rggb, 0, 0)
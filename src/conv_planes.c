@@ -0,0 +1,331 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file conv_planes.c
+ *  \ingroup Core
+ *  \brief Conversions between frames with arbitrary plane layouts.
+ */
+
+#include <stdlib.h>
+
+#include "conv.h"
+#include "frame_copy.h"
+#include "logging.h"
+
+enum
+{
+	/* Rows converted per pass through the band buffers. A multiple
+	 * of the vertical chroma period of every fourcc.
+	 */
+	conv_band_rows = 16,
+};
+
+struct frame_layout
+{
+	int planes;
+	int row_bytes[3];
+	int rows[3];
+	int period[3]; /* frame rows per plane row */
+};
+
+static int
+frame_layout_get(int fourcc, int width, int height,
+		struct frame_layout * layout)
+{
+	int rows[3];
+	int p;
+
+	layout->planes = conv_fmt_planes_get(fourcc, width, height,
+			layout->row_bytes, layout->rows);
+
+	if ( !layout->planes )
+		return -1;
+
+	conv_fmt_planes_get(fourcc, width, conv_band_rows,
+			layout->row_bytes, rows);
+
+	for ( p = 0; p < layout->planes; ++p )
+		layout->period[p] = conv_band_rows / rows[p];
+
+	return 0;
+}
+
+/* Demosaicing reads neighbouring rows and bottom-up frames reverse
+ * the row order, so neither can be split into bands.
+ */
+static int
+needs_whole_frame(int src_fourcc, int dst_fourcc)
+{
+	switch ( src_fourcc )
+	{
+	case VIDCAP_FOURCC_BA81:
+	case VIDCAP_FOURCC_GBRG:
+	case VIDCAP_FOURCC_GRBG:
+	case VIDCAP_FOURCC_RGGB:
+	case VIDCAP_FOURCC_BOTTOM_UP_RGB24:
+	case VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST:
+		return 1;
+	default:
+		break;
+	}
+
+	return dst_fourcc == VIDCAP_FOURCC_BOTTOM_UP_RGB24 ||
+		dst_fourcc == VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST;
+}
+
+static int
+is_tightly_packed(const struct frame_layout * layout,
+		const char * const planes[3], const int stride[3])
+{
+	int p;
+
+	for ( p = 0; p < layout->planes; ++p )
+	{
+		if ( stride[p] != layout->row_bytes[p] )
+			return 0;
+
+		if ( p && planes[p] != planes[p - 1] +
+				layout->row_bytes[p - 1] * layout->rows[p - 1] )
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Copy frame rows [row, row + n) of every plane between a strided frame
+ * and a tightly packed band of n rows.
+ */
+static void
+band_gather(const struct frame_layout * layout, int row, int n,
+		const char * const planes[3], const int stride[3], char * band)
+{
+	int p;
+
+	for ( p = 0; p < layout->planes; ++p )
+	{
+		const int rows = n / layout->period[p];
+
+		frame_copy_rows(band, layout->row_bytes[p],
+				planes[p] + row / layout->period[p] * stride[p],
+				stride[p], layout->row_bytes[p], rows);
+		band += rows * layout->row_bytes[p];
+	}
+}
+
+static void
+band_scatter(const struct frame_layout * layout, int row, int n,
+		const char * band, char * const planes[3], const int stride[3])
+{
+	int p;
+
+	for ( p = 0; p < layout->planes; ++p )
+	{
+		const int rows = n / layout->period[p];
+
+		frame_copy_rows(planes[p] + row / layout->period[p] * stride[p],
+				stride[p], band, layout->row_bytes[p],
+				layout->row_bytes[p], rows);
+		band += rows * layout->row_bytes[p];
+	}
+}
+
+static void
+frame_copy(const struct frame_layout * layout,
+		const char * const src[3], const int src_stride[3],
+		char * const dst[3], const int dst_stride[3])
+{
+	int p;
+
+	for ( p = 0; p < layout->planes; ++p )
+		frame_copy_rows(dst[p], dst_stride[p], src[p], src_stride[p],
+				layout->row_bytes[p], layout->rows[p]);
+}
+
+static int
+frame_align_check(int width, int height, int fourcc)
+{
+	int x_align, y_align;
+
+	/* Fourccs that cannot be cropped have no alignment to check */
+	if ( conv_fmt_align_get(fourcc, &x_align, &y_align) )
+		return 0;
+
+	return width % x_align || height % y_align ? -1 : 0;
+}
+
+/* Bytes in a tightly packed band of the given rows */
+static int
+band_size(const struct frame_layout * layout, int rows)
+{
+	int size = 0;
+	int p;
+
+	for ( p = 0; p < layout->planes; ++p )
+		size += layout->row_bytes[p] * (rows / layout->period[p]);
+
+	return size;
+}
+
+int
+vidcap_convert_planes(int width, int height,
+		int src_fourcc, const char * const src[3],
+		const int src_stride[3],
+		int dst_fourcc, char * const dst[3],
+		const int dst_stride[3])
+{
+	struct conv_params params;
+	struct frame_layout src_layout;
+	struct frame_layout dst_layout;
+	conv_func func = 0;
+	char * src_band = 0;
+	char * dst_band = 0;
+	int src_direct, dst_direct;
+	int band_rows, row, n;
+	int ret = 0;
+
+	if ( src_fourcc != dst_fourcc &&
+			!(func = conv_conversion_func_get(src_fourcc,
+					dst_fourcc)) )
+	{
+		log_error("cannot convert %s to %s\n",
+				vidcap_fourcc_string_get(src_fourcc),
+				vidcap_fourcc_string_get(dst_fourcc));
+		return -1;
+	}
+
+	if ( width < 1 || height < 1 ||
+			frame_layout_get(src_fourcc, width, height,
+				&src_layout) ||
+			frame_layout_get(dst_fourcc, width, height,
+				&dst_layout) ||
+			frame_align_check(width, height, src_fourcc) ||
+			frame_align_check(width, height, dst_fourcc) )
+	{
+		log_error("invalid %dx%d frame for converting %s to %s\n",
+				width, height,
+				vidcap_fourcc_string_get(src_fourcc),
+				vidcap_fourcc_string_get(dst_fourcc));
+		return -1;
+	}
+
+	if ( !func )
+	{
+		frame_copy(&src_layout, src, src_stride, dst, dst_stride);
+		return 0;
+	}
+
+	conv_params_init(&params);
+	params.bit_shift = conv_fmt_bit_shift_get(src_fourcc);
+
+	if ( is_tightly_packed(&src_layout, src, src_stride) &&
+			is_tightly_packed(&dst_layout,
+				(const char * const *)dst, dst_stride) )
+		return func(&params, width, height, src[0], dst[0]);
+
+	band_rows = needs_whole_frame(src_fourcc, dst_fourcc) ?
+		height : conv_band_rows;
+
+	/* A band of a single plane frame without padding is already a
+	 * tightly packed frame of its own
+	 */
+	src_direct = src_layout.planes == 1 &&
+		src_stride[0] == src_layout.row_bytes[0];
+	dst_direct = dst_layout.planes == 1 &&
+		dst_stride[0] == dst_layout.row_bytes[0];
+
+	if ( (!src_direct && !(src_band = malloc(band_size(&src_layout,
+						band_rows)))) ||
+			(!dst_direct && !(dst_band = malloc(band_size(
+						&dst_layout, band_rows)))) )
+	{
+		log_oom(__FILE__, __LINE__);
+		ret = -1;
+		goto bail;
+	}
+
+	for ( row = 0; row < height; row += n )
+	{
+		const char * s = src_band;
+		char * d = dst_band;
+
+		n = height - row < band_rows ? height - row : band_rows;
+
+		if ( src_direct )
+			s = src[0] + row * src_stride[0];
+		else
+			band_gather(&src_layout, row, n, src, src_stride,
+					src_band);
+
+		if ( dst_direct )
+			d = dst[0] + row * dst_stride[0];
+
+		if ( func(&params, width, n, s, d) )
+		{
+			ret = -1;
+			goto bail;
+		}
+
+		if ( !dst_direct )
+			band_scatter(&dst_layout, row, n, dst_band, dst,
+					dst_stride);
+	}
+
+bail:
+	free(src_band);
+	free(dst_band);
+	return ret;
+}
+
+int
+conv_packed(int src_fourcc, int dst_fourcc, int width, int height,
+		const char * src, char * dst)
+{
+	struct frame_layout src_layout;
+	struct frame_layout dst_layout;
+	const char * src_planes[3];
+	char * dst_planes[3];
+	int p;
+
+	if ( frame_layout_get(src_fourcc, width, height, &src_layout) ||
+			frame_layout_get(dst_fourcc, width, height,
+				&dst_layout) )
+		return -1;
+
+	for ( p = 0; p < src_layout.planes; ++p )
+	{
+		src_planes[p] = src;
+		src += src_layout.row_bytes[p] * src_layout.rows[p];
+	}
+
+	for ( p = 0; p < dst_layout.planes; ++p )
+	{
+		dst_planes[p] = dst;
+		dst += dst_layout.row_bytes[p] * dst_layout.rows[p];
+	}
+
+	return vidcap_convert_planes(width, height,
+			src_fourcc, src_planes, src_layout.row_bytes,
+			dst_fourcc, dst_planes, dst_layout.row_bytes);
+}
@@ -0,0 +1,290 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file conv_to_grey.c
+ *  \ingroup Core
+ *  \brief Conversions to 8-bit luminance, including from 16-bit samples.
+ */
+
+#include "colorimetry.h"
+#include "conv.h"
+#include "cpu.h"
+#include "frame_copy.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+static void
+u16_row_to_u8_c(const unsigned char * src, unsigned char * dst,
+		int n, int shift)
+{
+	int i;
+
+	for ( i = 0; i < n; ++i, src += 2 )
+	{
+		const int v = (src[0] | (src[1] << 8)) >> shift;
+
+		dst[i] = (unsigned char)(v > 255 ? 255 : v);
+	}
+}
+
+#ifdef CPU_X86
+CPU_TARGET("sse2") static void
+u16_row_to_u8_sse2(const unsigned char * src, unsigned char * dst,
+		int n, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	const __m128i max = _mm_set1_epi16(255);
+	int i;
+
+	for ( i = 0; i + 16 <= n; i += 16 )
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+
+		a = _mm_srl_epi16(a, count);
+		b = _mm_srl_epi16(b, count);
+
+		/* min(x, 255) for unsigned lanes; packus alone would treat
+		 * values of 32768 and up as negative.
+		 */
+		a = _mm_sub_epi16(a, _mm_subs_epu16(a, max));
+		b = _mm_sub_epi16(b, _mm_subs_epu16(b, max));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+	}
+
+	u16_row_to_u8_c(src + 2 * i, dst + i, n - i, shift);
+}
+#endif
+
+void
+conv_u16_to_u8(const char * src, char * dst, int n, int shift)
+{
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+	{
+		u16_row_to_u8_sse2((const unsigned char *)src,
+				(unsigned char *)dst, n, shift);
+		return;
+	}
+#endif
+
+	u16_row_to_u8_c((const unsigned char *)src, (unsigned char *)dst,
+			n, shift);
+}
+
+int
+vidcap_y16_to_grey(int width, int height, int bit_shift,
+		const char * src, char * dest)
+{
+	if ( bit_shift < 0 || bit_shift > 15 )
+		return -1;
+
+	conv_u16_to_u8(src, dest, width * height, bit_shift);
+
+	return 0;
+}
+
+/* Also takes the luma plane of p010 */
+int
+conv_y16_to_grey(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	return vidcap_y16_to_grey(width, height, params->bit_shift,
+			src, dest);
+}
+
+/* i420, nv12 and yvu9 all start with their luma plane */
+int
+conv_i420_to_grey(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	frame_copy_rows(dest, width, src, width, width, height);
+
+	return 0;
+}
+
+static void
+packed422_row_to_grey_c(const unsigned char * src, unsigned char * dst,
+		int n, int luma_offset)
+{
+	int i;
+
+	for ( i = 0; i < n; ++i )
+		dst[i] = src[2 * i + luma_offset];
+}
+
+#ifdef CPU_X86
+CPU_TARGET("sse2") static void
+packed422_row_to_grey_sse2(const unsigned char * src, unsigned char * dst,
+		int n, int luma_offset)
+{
+	const __m128i low_bytes = _mm_set1_epi16(0xff);
+	int i;
+
+	for ( i = 0; i + 16 <= n; i += 16 )
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+		__m128i b = _mm_loadu_si128(
+				(const __m128i *)(src + 2 * i + 16));
+
+		if ( luma_offset )
+		{
+			a = _mm_srli_epi16(a, 8);
+			b = _mm_srli_epi16(b, 8);
+		}
+		else
+		{
+			a = _mm_and_si128(a, low_bytes);
+			b = _mm_and_si128(b, low_bytes);
+		}
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+	}
+
+	packed422_row_to_grey_c(src + 2 * i, dst + i, n - i, luma_offset);
+}
+#endif
+
+static void
+packed422_to_grey(int n, int luma_offset, const char * src, char * dst)
+{
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+	{
+		packed422_row_to_grey_sse2((const unsigned char *)src,
+				(unsigned char *)dst, n, luma_offset);
+		return;
+	}
+#endif
+
+	packed422_row_to_grey_c((const unsigned char *)src,
+			(unsigned char *)dst, n, luma_offset);
+}
+
+int
+conv_yuy2_to_grey(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	packed422_to_grey(width * height, 0, src, dest);
+
+	return 0;
+}
+
+int
+conv_2vuy_to_grey(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	packed422_to_grey(width * height, 1, src, dest);
+
+	return 0;
+}
+
+static void
+rgb32_row_to_grey_c(const struct colorimetry * c, const unsigned int * src,
+		unsigned char * dst, int n)
+{
+	int i;
+
+	for ( i = 0; i < n; ++i )
+		dst[i] = colorimetry_y(c, (src[i] >> 16) & 0xff,
+				(src[i] >> 8) & 0xff, src[i] & 0xff);
+}
+
+#ifdef CPU_X86
+/* Luma of four pixels per multiply-add: each pixel's blue and green,
+ * then red and alpha, are summed in 32-bit lanes and the two halves of
+ * every pixel are then added together.
+ */
+CPU_TARGET("sse2") static __m128i
+rgb32_luma_sse2(__m128i pixels, __m128i weights, __m128i round)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+	__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+
+	lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+	hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+
+	lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+	hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+
+	return _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi64(lo, hi),
+				round), 8);
+}
+
+CPU_TARGET("sse2") static void
+rgb32_row_to_grey_sse2(const struct colorimetry * c,
+		const unsigned int * src, unsigned char * dst, int n)
+{
+	const __m128i weights = _mm_setr_epi16(c->to_y[2], c->to_y[1],
+			c->to_y[0], 0, c->to_y[2], c->to_y[1], c->to_y[0], 0);
+	const __m128i round = _mm_set1_epi32(128);
+	const __m128i offset = _mm_set1_epi16(c->y_offset);
+	int i;
+
+	for ( i = 0; i + 16 <= n; i += 16 )
+	{
+		const __m128i * s = (const __m128i *)(src + i);
+		__m128i a = _mm_packs_epi32(
+				rgb32_luma_sse2(_mm_loadu_si128(s), weights, round),
+				rgb32_luma_sse2(_mm_loadu_si128(s + 1), weights,
+					round));
+		__m128i b = _mm_packs_epi32(
+				rgb32_luma_sse2(_mm_loadu_si128(s + 2), weights,
+					round),
+				rgb32_luma_sse2(_mm_loadu_si128(s + 3), weights,
+					round));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(
+					_mm_add_epi16(a, offset),
+					_mm_add_epi16(b, offset)));
+	}
+
+	rgb32_row_to_grey_c(c, src + i, dst + i, n - i);
+}
+#endif
+
+int
+conv_rgb32_to_grey(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+	{
+		rgb32_row_to_grey_sse2(params->color,
+				(const unsigned int *)src,
+				(unsigned char *)dest, width * height);
+		return 0;
+	}
+#endif
+
+	rgb32_row_to_grey_c(params->color, (const unsigned int *)src,
+			(unsigned char *)dest, width * height);
+
+	return 0;
+}
@@ -32,16 +32,32 @@
  */
  
 #include <string.h>
-#include <vidcap/converters.h>
+#include "colorimetry.h"
+#include "conv.h"
+#include "cpu.h"
+#include "frame_copy.h"
 #include "logging.h"
 
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
 /** \note size of dest must be >= width * height * 3 / 2
  */
 
-/* Based on formulas found at http://en.wikipedia.org/wiki/YUV */
 int
 vidcap_rgb32_to_i420(int width, int height, const char * src, char * dst)
 {
+	return conv_packed(VIDCAP_FOURCC_RGB32, VIDCAP_FOURCC_I420,
+			width, height, src, dst);
+}
+
+/* Based on formulas found at http://en.wikipedia.org/wiki/YUV */
+int
+conv_rgb32_to_i420(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	const struct colorimetry * c = params->color;
 	unsigned char * dst_y_even;
 	unsigned char * dst_y_odd;
 	unsigned char * dst_u;
@@ -67,28 +83,28 @@ vidcap_rgb32_to_i420(int width, int height, const char * src, char * dst)
 			g = *src_even++;
 			r = *src_even++;
 			++src_even;
-			*dst_y_even++ = (( r * 66 + g * 129 + b * 25 + 128 ) >> 8 ) + 16;
+			*dst_y_even++ = colorimetry_y(c, r, g, b);
 
-			*dst_u++ = (( r * -38 - g * 74 + b * 112 + 128 ) >> 8 ) + 128;
-			*dst_v++ = (( r * 112 - g * 94 - b * 18 + 128 ) >> 8 ) + 128;
+			*dst_u++ = colorimetry_u(c, r, g, b);
+			*dst_v++ = colorimetry_v(c, r, g, b);
 
 			b = *src_even++;
 			g = *src_even++;
 			r = *src_even++;
 			++src_even;
-			*dst_y_even++ = (( r * 66 + g * 129 + b * 25 + 128 ) >> 8 ) + 16;
+			*dst_y_even++ = colorimetry_y(c, r, g, b);
 
 			b = *src_odd++;
 			g = *src_odd++;
 			r = *src_odd++;
 			++src_odd;
-			*dst_y_odd++ = (( r * 66 + g * 129 + b * 25 + 128 ) >> 8 ) + 16;
+			*dst_y_odd++ = colorimetry_y(c, r, g, b);
 
 			b = *src_odd++;
 			g = *src_odd++;
 			r = *src_odd++;
 			++src_odd;
-			*dst_y_odd++ = (( r * 66 + g * 129 + b * 25 + 128 ) >> 8 ) + 16;
+			*dst_y_odd++ = colorimetry_y(c, r, g, b);
 		}
 
 		dst_y_even += width;
@@ -100,44 +116,162 @@ vidcap_rgb32_to_i420(int width, int height, const char * src, char * dst)
 	return 0;
 }
 
-int
-vidcap_yuy2_to_i420(int width, int height, const char * src, char * dst)
+/* yuy2 and 2vuy are both packed 4:2:2 and differ only in whether luma
+ * or chroma comes first in each byte pair. Going to 4:2:0 either keeps
+ * the chroma of the even row or averages the two rows' chroma.
+ */
+static void
+packed422_rows_to_i420_c(const unsigned char * src_even,
+		const unsigned char * src_odd, int width, int luma_first,
+		int average, unsigned char * dst_y_even,
+		unsigned char * dst_y_odd, unsigned char * dst_u,
+		unsigned char * dst_v)
 {
-	/* convert from a packed structure to a planar structure */
-	char * dst_y_even = dst;
-	char * dst_y_odd = dst + width;
-	char * dst_u = dst + width * height;
-	char * dst_v = dst_u + width * height / 4;
-	const char * src_even = src;
-	const char * src_odd = src + width * 2;
+	const int y_off = luma_first ? 0 : 1;
+	const int c_off = luma_first ? 1 : 0;
+	int j;
 
-	int i, j;
+	for ( j = 0; j < width / 2; ++j )
+	{
+		*dst_y_even++ = src_even[y_off];
+		*dst_y_even++ = src_even[y_off + 2];
+		*dst_y_odd++  = src_odd[y_off];
+		*dst_y_odd++  = src_odd[y_off + 2];
 
-	/* yuy2 has a vertical sampling period (for u and v)
-	 * half that for i420. Will toss half of the
-	 * U and V data during repackaging.
-	 */
-	for ( i = 0; i < height / 2; ++i )
+		if ( average )
+		{
+			*dst_u++ = (src_even[c_off] + src_odd[c_off] + 1) >> 1;
+			*dst_v++ = (src_even[c_off + 2] +
+					src_odd[c_off + 2] + 1) >> 1;
+		}
+		else
+		{
+			*dst_u++ = src_even[c_off];
+			*dst_v++ = src_even[c_off + 2];
+		}
+
+		src_even += 4;
+		src_odd += 4;
+	}
+}
+
+#ifdef CPU_X86
+/* 16 pixels per step: luma and chroma bytes are split by masking and
+ * shifting 16-bit lanes, then chroma is split again into u and v.
+ */
+CPU_TARGET("sse2") static void
+packed422_rows_to_i420_sse2(const unsigned char * src_even,
+		const unsigned char * src_odd, int width, int luma_first,
+		int average, unsigned char * dst_y_even,
+		unsigned char * dst_y_odd, unsigned char * dst_u,
+		unsigned char * dst_v)
+{
+	const __m128i low = _mm_set1_epi16(0x00ff);
+	const __m128i zero = _mm_setzero_si128();
+	int x;
+
+	for ( x = 0; x + 16 <= width; x += 16 )
 	{
-		for ( j = 0; j < width / 2; ++j )
+		const __m128i e0 = _mm_loadu_si128(
+				(const __m128i *)(src_even + 2 * x));
+		const __m128i e1 = _mm_loadu_si128(
+				(const __m128i *)(src_even + 2 * x + 16));
+		const __m128i o0 = _mm_loadu_si128(
+				(const __m128i *)(src_odd + 2 * x));
+		const __m128i o1 = _mm_loadu_si128(
+				(const __m128i *)(src_odd + 2 * x + 16));
+		__m128i ye, yo, ce, co, c;
+
+		if ( luma_first )
 		{
-			*dst_y_even++ = *src_even++;
-			*dst_u++      = *src_even++;
-			*dst_y_even++ = *src_even++;
-			*dst_v++      = *src_even++;
-
-			*dst_y_odd++  = *src_odd++;
-			src_odd++;
-			*dst_y_odd++  = *src_odd++;
-			src_odd++;
+			ye = _mm_packus_epi16(_mm_and_si128(e0, low),
+					_mm_and_si128(e1, low));
+			yo = _mm_packus_epi16(_mm_and_si128(o0, low),
+					_mm_and_si128(o1, low));
+			ce = _mm_packus_epi16(_mm_srli_epi16(e0, 8),
+					_mm_srli_epi16(e1, 8));
+			co = _mm_packus_epi16(_mm_srli_epi16(o0, 8),
+					_mm_srli_epi16(o1, 8));
+		}
+		else
+		{
+			ye = _mm_packus_epi16(_mm_srli_epi16(e0, 8),
+					_mm_srli_epi16(e1, 8));
+			yo = _mm_packus_epi16(_mm_srli_epi16(o0, 8),
+					_mm_srli_epi16(o1, 8));
+			ce = _mm_packus_epi16(_mm_and_si128(e0, low),
+					_mm_and_si128(e1, low));
+			co = _mm_packus_epi16(_mm_and_si128(o0, low),
+					_mm_and_si128(o1, low));
 		}
 
-		dst_y_even += width;
-		dst_y_odd += width;
-		src_even += width * 2;
-		src_odd += width * 2;
+		c = average ? _mm_avg_epu8(ce, co) : ce;
+
+		_mm_storeu_si128((__m128i *)(dst_y_even + x), ye);
+		_mm_storeu_si128((__m128i *)(dst_y_odd + x), yo);
+		_mm_storel_epi64((__m128i *)(dst_u + x / 2),
+				_mm_packus_epi16(_mm_and_si128(c, low), zero));
+		_mm_storel_epi64((__m128i *)(dst_v + x / 2),
+				_mm_packus_epi16(_mm_srli_epi16(c, 8), zero));
 	}
 
+	packed422_rows_to_i420_c(src_even + 2 * x, src_odd + 2 * x,
+			width - x, luma_first, average,
+			dst_y_even + x, dst_y_odd + x,
+			dst_u + x / 2, dst_v + x / 2);
+}
+#endif
+
+static void
+packed422_to_i420(int width, int height, int luma_first, int average,
+		const char * src, char * dst)
+{
+	const unsigned char * src_even = (const unsigned char *)src;
+	unsigned char * dst_y = (unsigned char *)dst;
+	unsigned char * dst_u = dst_y + width * height;
+	unsigned char * dst_v = dst_u + width * height / 4;
+	int i;
+
+	for ( i = 0; i < height / 2; ++i )
+	{
+		const unsigned char * src_odd = src_even + width * 2;
+
+#ifdef CPU_X86
+		if ( cpu_flags_get() & cpu_flag_sse2 )
+			packed422_rows_to_i420_sse2(src_even, src_odd, width,
+					luma_first, average, dst_y, dst_y + width,
+					dst_u, dst_v);
+		else
+#endif
+			packed422_rows_to_i420_c(src_even, src_odd, width,
+					luma_first, average, dst_y, dst_y + width,
+					dst_u, dst_v);
+
+		src_even += width * 4;
+		dst_y += width * 2;
+		dst_u += width / 2;
+		dst_v += width / 2;
+	}
+}
+
+/* yuy2 has a vertical sampling period (for u and v) half that for
+ * i420. Unless averaging, half of the U and V data is tossed during
+ * repackaging.
+ */
+int
+vidcap_yuy2_to_i420(int width, int height, const char * src, char * dst)
+{
+	return conv_packed(VIDCAP_FOURCC_YUY2, VIDCAP_FOURCC_I420,
+			width, height, src, dst);
+}
+
+int
+conv_yuy2_to_i420(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	packed422_to_i420(width, height, 1, params->chroma_average,
+			src, dst);
+
 	return 0;
 }
 
@@ -145,79 +279,167 @@ vidcap_yuy2_to_i420(int width, int height, const char * src, char * dst)
  * same except where we find the yuv components.
  */
 int
-conv_2vuy_to_i420(int width, int height, const char * src, char * dst)
+conv_2vuy_to_i420(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
 {
-	char * dst_y_even = dst;
-	char * dst_y_odd = dst + width;
-	char * dst_u = dst + width * height;
-	char * dst_v = dst_u + width * height / 4;
-	const char * src_even = src;
-	const char * src_odd = src + width * 2;
+	packed422_to_i420(width, height, 0, params->chroma_average,
+			src, dst);
 
-	int i, j;
+	return 0;
+}
 
-	for ( i = 0; i < height / 2; ++i )
+/* Each yvu9 chroma sample covers a 4x4 block, that is 2x2 i420 chroma
+ * samples: it is doubled along the row and the row is written twice.
+ */
+static void
+yvu9_row_to_i420_c(const unsigned char * src, int n,
+		unsigned char * dst_even, unsigned char * dst_odd)
+{
+	int j;
+
+	for ( j = 0; j < n; ++j )
 	{
-		for ( j = 0; j < width / 2; ++j )
-		{
-			*dst_u++      = *src_even++;
-			*dst_y_even++ = *src_even++;
-			*dst_v++      = *src_even++;
-			*dst_y_even++ = *src_even++;
-
-			src_odd++;
-			*dst_y_odd++  = *src_odd++;
-			src_odd++;
-			*dst_y_odd++  = *src_odd++;
-		}
+		dst_even[2 * j] = dst_even[2 * j + 1] = src[j];
+		dst_odd[2 * j] = dst_odd[2 * j + 1] = src[j];
+	}
+}
 
-		dst_y_even += width;
-		dst_y_odd += width;
-		src_even += width * 2;
-		src_odd += width * 2;
+#ifdef CPU_X86
+CPU_TARGET("sse2") static void
+yvu9_row_to_i420_sse2(const unsigned char * src, int n,
+		unsigned char * dst_even, unsigned char * dst_odd)
+{
+	int j;
+
+	for ( j = 0; j + 16 <= n; j += 16 )
+	{
+		const __m128i s = _mm_loadu_si128((const __m128i *)(src + j));
+		const __m128i lo = _mm_unpacklo_epi8(s, s);
+		const __m128i hi = _mm_unpackhi_epi8(s, s);
+
+		_mm_storeu_si128((__m128i *)(dst_even + 2 * j), lo);
+		_mm_storeu_si128((__m128i *)(dst_even + 2 * j + 16), hi);
+		_mm_storeu_si128((__m128i *)(dst_odd + 2 * j), lo);
+		_mm_storeu_si128((__m128i *)(dst_odd + 2 * j + 16), hi);
 	}
 
-	return 0;
+	yvu9_row_to_i420_c(src + j, n - j, dst_even + 2 * j, dst_odd + 2 * j);
+}
+#endif
+
+static void
+yvu9_plane_to_i420(int width, int height, const unsigned char * src,
+		unsigned char * dst)
+{
+	int i;
+
+	for ( i = 0; i < height / 4; ++i )
+	{
+#ifdef CPU_X86
+		if ( cpu_flags_get() & cpu_flag_sse2 )
+			yvu9_row_to_i420_sse2(src, width / 4,
+					dst, dst + width / 2);
+		else
+#endif
+			yvu9_row_to_i420_c(src, width / 4,
+					dst, dst + width / 2);
+
+		src += width / 4;
+		dst += width;
+	}
 }
 
 /* yvu9 is like i420, but the u and v planes
  * are reversed and 4x4 subsampled, instead of 2x2
  */
 int
-conv_yvu9_to_i420(int width, int height, const char * src, char * dst)
+conv_yvu9_to_i420(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
 {
-	char * dst_y = dst;
-	char * dst_u_even = dst + width * height;
-	char * dst_u_odd = dst_u_even + width / 2;
-	char * dst_v_even = dst_u_even + width * height / 4;
-	char * dst_v_odd = dst_v_even + width / 2;
-	const char * src_y = src;
-	const char * src_v = src_y + width * height;
-	const char * src_u = src_v + width * height / 16;
+	const unsigned char * src_v =
+		(const unsigned char *)src + width * height;
+	const unsigned char * src_u = src_v + width * height / 16;
+	unsigned char * dst_u = (unsigned char *)dst + width * height;
+	unsigned char * dst_v = dst_u + width * height / 4;
 
-	int i, j;
+	frame_copy_rows(dst, width, src, width, width, height);
 
-	memcpy(dst_y, src_y, height * width);
+	yvu9_plane_to_i420(width, height, src_u, dst_u);
+	yvu9_plane_to_i420(width, height, src_v, dst_v);
 
-	for ( i = 0; i < height / 4; ++i )
+	return 0;
+}
+
+/* nv12 has the same planes as i420 with u and v interleaved */
+int
+conv_nv12_to_i420(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	const char * src_uv = src + width * height;
+	char * dst_u = dst + width * height;
+	char * dst_v = dst_u + width * height / 4;
+	int i;
+
+	frame_copy_rows(dst, width, src, width, width, height);
+
+	for ( i = 0; i < width * height / 4; ++i )
+	{
+		*dst_u++ = *src_uv++;
+		*dst_v++ = *src_uv++;
+	}
+
+	return 0;
+}
+
+/* Luminance only sources get neutral chroma */
+int
+conv_grey_to_i420(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	frame_copy_rows(dst, width, src, width, width, height);
+	memset(dst + width * height, 128, width * height / 2);
+
+	return 0;
+}
+
+int
+conv_y16_to_i420(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	conv_u16_to_u8(src, dst, width * height, params->bit_shift);
+	memset(dst + width * height, 128, width * height / 2);
+
+	return 0;
+}
+
+/* p010 is nv12 with 16-bit samples: a luma plane followed by a plane of
+ * interleaved u and v samples, both 2x2 subsampled.
+ */
+int
+conv_p010_to_i420(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	enum { chunk = 256 };
+	char uv[2 * chunk];
+	char * dst_u = dst + width * height;
+	char * dst_v = dst_u + width * height / 4;
+	const char * src_uv = src + 2 * width * height;
+	const int uv_pairs = width * height / 4;
+	int i, j, n;
+
+	conv_u16_to_u8(src, dst, width * height, params->bit_shift);
+
+	for ( i = 0; i < uv_pairs; i += chunk )
 	{
-		for ( j = 0; j < width / 4; ++j )
+		n = uv_pairs - i < chunk ? uv_pairs - i : chunk;
+
+		conv_u16_to_u8(src_uv + 4 * i, uv, 2 * n, params->bit_shift);
+
+		for ( j = 0; j < n; ++j )
 		{
-			*dst_u_even++ = *src_u;
-			*dst_u_even++ = *src_u;
-			*dst_u_odd++ = *src_u;
-			*dst_u_odd++ = *src_u++;
-
-			*dst_v_even++ = *src_v;
-			*dst_v_even++ = *src_v;
-			*dst_v_odd++ = *src_v;
-			*dst_v_odd++ = *src_v++;
+			*dst_u++ = uv[2 * j];
+			*dst_v++ = uv[2 * j + 1];
 		}
-
-		dst_u_even += width / 2;
-		dst_u_odd += width / 2;
-		dst_v_even += width / 2;
-		dst_v_odd += width / 2;
 	}
 
 	return 0;
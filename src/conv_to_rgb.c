@@ -31,75 +31,241 @@
  *  \since 2007
  */
 
-#include <vidcap/converters.h>
-
-enum {
-	CLIP_SIZE = 811,
-	CLIP_OFFSET = 277,
-	YMUL = 298,
-	RMUL = 409,
-	BMUL = 516,
-	G1MUL = -100,
-	G2MUL = -208,
-};
+#include <stdlib.h>
+
+#include "colorimetry.h"
+#include "conv.h"
+#include "conv_traits.h"
+#include "cpu.h"
+#include "logging.h"
 
-static int tables_initialized = 0;
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
 
-static int yuv2rgb_y[256];
-static int yuv2rgb_r[256];
-static int yuv2rgb_b[256];
-static int yuv2rgb_g1[256];
-static int yuv2rgb_g2[256];
+#ifdef CPU_SSSE3
+#include <tmmintrin.h>
+#endif
 
-static unsigned long yuv2rgb_clip[CLIP_SIZE];
-static unsigned long yuv2rgb_clip8[CLIP_SIZE];
-static unsigned long yuv2rgb_clip16[CLIP_SIZE];
+#define CLIP(v) (colorimetry_clip[v])
 
 #define COMPOSE_RGB(yc, rc, gc, bc)		\
 	( 0xff000000 |				\
-	  yuv2rgb_clip16[(yc) + (rc)] |		\
-	  yuv2rgb_clip8[(yc) + (gc)] |		\
-	  yuv2rgb_clip[(yc) + (bc)] )
+	  (CLIP((yc) + (rc)) << 16) |		\
+	  (CLIP((yc) + (gc)) << 8) |		\
+	  CLIP((yc) + (bc)) )
+
+/* Store stages. Each writes one pixel of a layout from conv_traits.h
+ * given the clip table index of luma plus the chroma term of each
+ * colour.
+ */
+#define STORE_RGB32(d, bpp, ro, go, bo, yc, rc, gc, bc)		\
+	( *(unsigned int *)(d) = COMPOSE_RGB(yc, rc, gc, bc) )
 
-static void init_yuv2rgb_tables(void)
+#define STORE_BYTES(d, bpp, ro, go, bo, yc, rc, gc, bc)		\
+	store_bytes(d, bpp, ro, go, bo, CLIP((yc) + (rc)),		\
+			CLIP((yc) + (gc)), CLIP((yc) + (bc)))
+
+#define STORE_RGB565(d, bpp, ro, go, bo, yc, rc, gc, bc)		\
+	store_rgb565(d, CLIP((yc) + (rc)), CLIP((yc) + (gc)),	\
+			CLIP((yc) + (bc)))
+
+/* The offsets of a four byte layout sum to six, so alpha is the one
+ * byte left over.
+ */
+static __inline void
+store_bytes(unsigned char * d, int bpp, int ro, int go, int bo,
+		int r, int g, int b)
 {
-	int i;
+	d[ro] = (unsigned char)r;
+	d[go] = (unsigned char)g;
+	d[bo] = (unsigned char)b;
 
-	for ( i = 0; i < 256; ++i )
-	{
-		yuv2rgb_y[i] = (YMUL * (i - 16) + 128) >> 8;
-		yuv2rgb_r[i] = (RMUL * (i - 128)) >> 8;
-		yuv2rgb_b[i] = (BMUL * (i - 128)) >> 8;
-		yuv2rgb_g1[i] = (G1MUL * (i - 128)) >> 8;
-		yuv2rgb_g2[i] = (G2MUL * (i - 128)) >> 8;
-	}
-	for ( i = 0 ; i < CLIP_OFFSET ; ++i )
-	{
-		yuv2rgb_clip[i] = 0;
-		yuv2rgb_clip8[i] = 0;
-		yuv2rgb_clip16[i] = 0;
-	}
-	for ( ; i < CLIP_OFFSET + 256 ; ++i )
-	{
-		yuv2rgb_clip[i] = i - CLIP_OFFSET;
-		yuv2rgb_clip8[i] = (i - CLIP_OFFSET) << 8;
-		yuv2rgb_clip16[i] = (i - CLIP_OFFSET) << 16;
-	}
-	for ( ; i < CLIP_SIZE ; ++i )
-	{
-		yuv2rgb_clip[i] = 255;
-		yuv2rgb_clip8[i] = 255 << 8;
-		yuv2rgb_clip16[i] = 255 << 16;
-	}
+	if ( bpp == 4 )
+		d[6 - ro - go - bo] = 0xff;
+}
+
+static __inline void
+store_rgb565(unsigned char * d, int r, int g, int b)
+{
+	const int v = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
 
-	tables_initialized = 1;
+	d[0] = (unsigned char)v;
+	d[1] = (unsigned char)(v >> 8);
 }
 
+struct yuv_frame
+{
+	const struct colorimetry * c;
+	int height;
+	const unsigned char * y;	/* or packed 4:2:2 samples */
+	const unsigned char * u;
+	const unsigned char * v;
+	unsigned char * dst;
+};
+
+/* Converter from a 4:2:0 source to an rgb layout, generated from the
+ * traits of both. Chroma samples are c_step bytes apart.
+ */
+#define YUV420_TO_RGB(sname, SFOURCC, c_step,				\
+		dname, DFOURCC, bpp, STORE, ro, go, bo)			\
+static __inline void							\
+kernel_##sname##_to_##dname(const struct yuv_frame * f,		\
+		const int width)					\
+{									\
+	const struct colorimetry * c = f->c;				\
+	const unsigned char * y_even = f->y;				\
+	const unsigned char * y_odd = y_even + width;			\
+	const unsigned char * u = f->u;					\
+	const unsigned char * v = f->v;					\
+	unsigned char * dst_even = f->dst;				\
+	unsigned char * dst_odd = dst_even + width * (bpp);		\
+	int i, j;							\
+									\
+	for ( i = 0; i < f->height / 2; ++i )				\
+	{								\
+		for ( j = 0; j < width / 2; ++j )			\
+		{							\
+			const int rc = c->r_v[*v];			\
+			const int gc = c->g_u[*u] + c->g_v[*v];		\
+			const int bc = c->b_u[*u];			\
+			const int yc0_even =				\
+				COLOR_CLIP_OFFSET + c->y[y_even[0]];	\
+			const int yc1_even =				\
+				COLOR_CLIP_OFFSET + c->y[y_even[1]];	\
+			const int yc0_odd =				\
+				COLOR_CLIP_OFFSET + c->y[y_odd[0]];	\
+			const int yc1_odd =				\
+				COLOR_CLIP_OFFSET + c->y[y_odd[1]];	\
+									\
+			STORE(dst_even, bpp, ro, go, bo,		\
+					yc0_even, rc, gc, bc);		\
+			STORE(dst_even + (bpp), bpp, ro, go, bo,	\
+					yc1_even, rc, gc, bc);		\
+			STORE(dst_odd, bpp, ro, go, bo,			\
+					yc0_odd, rc, gc, bc);		\
+			STORE(dst_odd + (bpp), bpp, ro, go, bo,		\
+					yc1_odd, rc, gc, bc);		\
+									\
+			y_even += 2;					\
+			y_odd += 2;					\
+			dst_even += 2 * (bpp);				\
+			dst_odd += 2 * (bpp);				\
+			u += (c_step);					\
+			v += (c_step);					\
+		}							\
+									\
+		y_even += width;					\
+		y_odd += width;						\
+		dst_even += width * (bpp);				\
+		dst_odd += width * (bpp);				\
+	}								\
+}									\
+									\
+int conv_##sname##_to_##dname(const struct conv_params * params,	\
+		int width, int height, const char * src, char * dest)	\
+{									\
+	struct yuv_frame f;						\
+									\
+	f.c = params->color;						\
+	f.height = height;						\
+	f.y = (const unsigned char *)src;				\
+	f.u = f.y + width * height;					\
+	f.v = (c_step) == 1 ? f.u + width * height / 4 : f.u + 1;	\
+	f.dst = (unsigned char *)dest;					\
+									\
+	kernel_##sname##_to_##dname(&f, width);				\
+	return 0;							\
+}
+
+/* Converter from a packed 4:2:2 source to an rgb layout. y0, uo, y1
+ * and vo are the byte offsets of the samples within a macropixel.
+ */
+#define YUV422_TO_RGB(sname, SFOURCC, y0, uo, y1, vo,			\
+		dname, DFOURCC, bpp, STORE, ro, go, bo)			\
+static __inline void							\
+kernel_##sname##_to_##dname(const struct yuv_frame * f,		\
+		const int width)					\
+{									\
+	const struct colorimetry * c = f->c;				\
+	const unsigned char * s = f->y;					\
+	unsigned char * dst = f->dst;					\
+	int i, j;							\
+									\
+	for ( i = 0; i < f->height; ++i )				\
+	{								\
+		for ( j = 0; j < width / 2; ++j )			\
+		{							\
+			const int rc = c->r_v[s[vo]];			\
+			const int gc = c->g_u[s[uo]] + c->g_v[s[vo]];	\
+			const int bc = c->b_u[s[uo]];			\
+			const int yc0 = COLOR_CLIP_OFFSET + c->y[s[y0]];	\
+			const int yc1 = COLOR_CLIP_OFFSET + c->y[s[y1]];	\
+									\
+			STORE(dst, bpp, ro, go, bo, yc0, rc, gc, bc);	\
+			STORE(dst + (bpp), bpp, ro, go, bo,		\
+					yc1, rc, gc, bc);		\
+									\
+			s += 4;						\
+			dst += 2 * (bpp);				\
+		}							\
+	}								\
+}									\
+									\
+int conv_##sname##_to_##dname(const struct conv_params * params,	\
+		int width, int height, const char * src, char * dest)	\
+{									\
+	struct yuv_frame f;						\
+									\
+	f.c = params->color;						\
+	f.height = height;						\
+	f.y = (const unsigned char *)src;				\
+	f.u = f.v = 0;							\
+	f.dst = (unsigned char *)dest;					\
+									\
+	kernel_##sname##_to_##dname(&f, width);				\
+	return 0;							\
+}
+
+/* The clip table is the identity past COLOR_CLIP_OFFSET, so rgb32
+ * colours go through the same store stages with no chroma term.
+ */
+#define RGB32_TO_RGB(dname, DFOURCC, bpp, STORE, ro, go, bo)		\
+int conv_rgb32_to_##dname(const struct conv_params * params,		\
+		int width, int height, const char * src, char * dest)	\
+{									\
+	const unsigned int * s = (const unsigned int *)src;		\
+	unsigned char * dst = (unsigned char *)dest;			\
+	int i;								\
+									\
+	for ( i = 0; i < width * height; ++i )				\
+	{								\
+		const unsigned int p = s[i];				\
+									\
+		STORE(dst, bpp, ro, go, bo, COLOR_CLIP_OFFSET,		\
+				(p >> 16) & 0xff, (p >> 8) & 0xff,	\
+				p & 0xff);				\
+		dst += (bpp);						\
+	}								\
+									\
+	return 0;							\
+}
+
+#define YUV_TO_RGB(dname, DFOURCC, bpp, STORE, ro, go, bo)		\
+	CONV_420_SOURCES(YUV420_TO_RGB,					\
+			dname, DFOURCC, bpp, STORE, ro, go, bo)		\
+	CONV_422_SOURCES(YUV422_TO_RGB,					\
+			dname, DFOURCC, bpp, STORE, ro, go, bo)
+
+CONV_RGB_OUTPUTS(YUV_TO_RGB)
+CONV_RGB_LAYOUTS(RGB32_TO_RGB)
+
 /** \brief Function to convert i420 images to rgb32
  *
  *  rgb32: 0xFFRRGGBB
- *  This function uses precalculated tables that are initialized
- *  on the first run.
+ *  This function uses tables of BT.601 limited range terms
+ *  generated at compile time. See vidcap_convert_planes() for
+ *  padded buffers.
  *
  *  Dest should be width * height * 4 bytes in size.
  *
@@ -111,53 +277,8 @@ static void init_yuv2rgb_tables(void)
 int
 vidcap_i420_to_rgb32(int width, int height, const char * src, char * dest)
 {
-	const unsigned char * y_even;
-	const unsigned char * y_odd;
-	const unsigned char * u;
-	const unsigned char * v;
-	unsigned int *dst_even;
-	unsigned int *dst_odd;
-	int i, j;
-
-	if ( !tables_initialized )
-		init_yuv2rgb_tables();
-
-	dst_even = (unsigned int *)dest;
-	dst_odd = dst_even + width;
-
-	y_even = (const unsigned char *)src;
-	y_odd = y_even + width;
-	u = y_even + width * height;
-	v = u + ((width * height) >> 2);
-
-	for ( i = 0; i < height / 2; ++i )
-	{
-		for ( j = 0; j < width / 2; ++j )
-		{
-			const int rc = yuv2rgb_r[*v];
-			const int gc = yuv2rgb_g1[*v] + yuv2rgb_g2[*u];
-			const int bc = yuv2rgb_b[*u];
-			const int yc0_even = CLIP_OFFSET + yuv2rgb_y[*y_even++];
-			const int yc1_even = CLIP_OFFSET + yuv2rgb_y[*y_even++];
-			const int yc0_odd = CLIP_OFFSET + yuv2rgb_y[*y_odd++];
-			const int yc1_odd = CLIP_OFFSET + yuv2rgb_y[*y_odd++];
-
-			*dst_even++ = COMPOSE_RGB(yc0_even, rc, gc, bc);
-			*dst_even++ = COMPOSE_RGB(yc1_even, rc, gc, bc);
-			*dst_odd++ = COMPOSE_RGB(yc0_odd, rc, gc, bc);
-			*dst_odd++ = COMPOSE_RGB(yc1_odd, rc, gc, bc);
-			
-			++u;
-			++v;
-		}
-
-		y_even += width;
-		y_odd += width;
-		dst_even += width;
-		dst_odd += width;
-	}
-
-	return 0;
+	return conv_packed(VIDCAP_FOURCC_I420, VIDCAP_FOURCC_RGB32,
+			width, height, src, dest);
 }
 
 /** \brief Convert YUV2 to RGB32
@@ -168,71 +289,241 @@ vidcap_i420_to_rgb32(int width, int height, const char * src, char * dest)
  */
 int vidcap_yuy2_to_rgb32(int width, int height, const char * src, char * dest)
 {
+	return conv_packed(VIDCAP_FOURCC_YUY2, VIDCAP_FOURCC_RGB32,
+			width, height, src, dest);
+}
+
+/* rgb24 holds blue, green, red in memory like rgb32 without alpha;
+ * the red first variants swap red and blue.
+ */
+static void
+rgb24_row_to_rgb32_c(const unsigned char * s, unsigned int * d, int n,
+		int red_first)
+{
+	const int r = red_first ? 0 : 2;
+	const int b = red_first ? 2 : 0;
+	int i;
+
+	for ( i = 0; i < n; ++i, s += 3 )
+		d[i] = 0xff000000 | (s[r] << 16) | (s[1] << 8) | s[b];
+}
+
+#ifdef CPU_SSSE3
+/* 16 pixels per step: 48 source bytes are loaded as three vectors and
+ * each group of four pixels is brought to the front of a vector with
+ * a byte shift before pshufb spreads it over 16 bytes.
+ */
+CPU_TARGET("ssse3") static void
+rgb24_row_to_rgb32_ssse3(const unsigned char * s, unsigned int * d, int n,
+		int red_first)
+{
+	const __m128i expand = red_first ?
+		_mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1,
+				8, 7, 6, -1, 11, 10, 9, -1) :
+		_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+				6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	int i;
+
+	for ( i = 0; i + 16 <= n; i += 16, s += 48 )
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i *)s);
+		const __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+		const __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+		__m128i * out = (__m128i *)(d + i);
+
+		_mm_storeu_si128(out, _mm_or_si128(alpha,
+					_mm_shuffle_epi8(a, expand)));
+		_mm_storeu_si128(out + 1, _mm_or_si128(alpha,
+					_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12),
+						expand)));
+		_mm_storeu_si128(out + 2, _mm_or_si128(alpha,
+					_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8),
+						expand)));
+		_mm_storeu_si128(out + 3, _mm_or_si128(alpha,
+					_mm_shuffle_epi8(_mm_srli_si128(c, 4),
+						expand)));
+	}
+
+	rgb24_row_to_rgb32_c(s, d + i, n - i, red_first);
+}
+#endif
+
+static void
+rgb24_to_rgb32(int width, int height, int bottom_up, int red_first,
+		const char * src, char * dest)
+{
+	const unsigned char * s = (const unsigned char *)src;
 	unsigned int * d = (unsigned int *)dest;
-	int i, j;
+	int row_step = width * 3;
+	int rows = 1;
+	int n = width * height;
+	int i;
 
-	if ( !tables_initialized )
-		init_yuv2rgb_tables();
+	/* Top-down frames are one long row */
+	if ( bottom_up )
+	{
+		s += width * (height - 1) * 3;
+		row_step = -row_step;
+		rows = height;
+		n = width;
+	}
 
-	for ( i = 0; i < height; ++i )
+	for ( i = 0; i < rows; ++i )
 	{
-		for ( j = 0; j < width / 2; ++j )
-		{
-			const unsigned char y0 = *src++;
-			const unsigned char u  = *src++;
-			const unsigned char y1 = *src++;
-			const unsigned char v  = *src++;
-			const int rc = yuv2rgb_r[v];
-			const int gc = yuv2rgb_g1[v] + yuv2rgb_g2[u];
-			const int bc = yuv2rgb_b[u];
-			const int yc0 = CLIP_OFFSET + yuv2rgb_y[y0];
-			const int yc1 = CLIP_OFFSET + yuv2rgb_y[y1];
-
-			*d++ = COMPOSE_RGB(yc0, rc, gc, bc);
-			*d++ = COMPOSE_RGB(yc1, rc, gc, bc);
-		}
+#ifdef CPU_SSSE3
+		if ( cpu_flags_get() & cpu_flag_ssse3 )
+			rgb24_row_to_rgb32_ssse3(s, d, n, red_first);
+		else
+#endif
+			rgb24_row_to_rgb32_c(s, d, n, red_first);
+
+		s += row_step;
+		d += n;
 	}
+}
+
+int conv_rgb24_to_rgb32(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	rgb24_to_rgb32(width, height, 0, 0, src, dest);
+
+	return 0;
+}
+
+int conv_bottom_up_rgb24_to_rgb32(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	rgb24_to_rgb32(width, height, 1, 0, src, dest);
+
+	return 0;
+}
+
+int conv_rgb24_red_first_to_rgb32(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	rgb24_to_rgb32(width, height, 0, 1, src, dest);
 
 	return 0;
 }
 
-int conv_rgb24_to_rgb32(int width, int height, const char * src, char * dest)
+int conv_bottom_up_rgb24_red_first_to_rgb32(
+		const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	rgb24_to_rgb32(width, height, 1, 1, src, dest);
+
+	return 0;
+}
+
+static void
+grey_row_to_rgb32_c(const unsigned char * src, unsigned int * dst, int n)
 {
 	int i;
-	unsigned int * d = (unsigned int *)dest;
-	const unsigned char * s = (const unsigned char *)src;
 
-	for ( i = 0; i < width * height; ++i )
+	for ( i = 0; i < n; ++i )
+		dst[i] = 0xff000000 | (src[i] << 16) | (src[i] << 8) | src[i];
+}
+
+#ifdef CPU_X86
+CPU_TARGET("sse2") static void
+grey_row_to_rgb32_sse2(const unsigned char * src, unsigned int * dst, int n)
+{
+	const __m128i alpha = _mm_set1_epi8((char)0xff);
+	int i;
+
+	for ( i = 0; i + 16 <= n; i += 16 )
 	{
-		*d = 0xff000000;
-		*d |= *s++;           /* blue */
-		*d |= (*s++) << 8;    /* green */
-		*d++ |= (*s++) << 16; /* red */
+		const __m128i g = _mm_loadu_si128((const __m128i *)(src + i));
+		const __m128i gg_lo = _mm_unpacklo_epi8(g, g);
+		const __m128i gg_hi = _mm_unpackhi_epi8(g, g);
+		const __m128i ga_lo = _mm_unpacklo_epi8(g, alpha);
+		const __m128i ga_hi = _mm_unpackhi_epi8(g, alpha);
+		__m128i * d = (__m128i *)(dst + i);
+
+		_mm_storeu_si128(d, _mm_unpacklo_epi16(gg_lo, ga_lo));
+		_mm_storeu_si128(d + 1, _mm_unpackhi_epi16(gg_lo, ga_lo));
+		_mm_storeu_si128(d + 2, _mm_unpacklo_epi16(gg_hi, ga_hi));
+		_mm_storeu_si128(d + 3, _mm_unpackhi_epi16(gg_hi, ga_hi));
 	}
 
+	grey_row_to_rgb32_c(src + i, dst + i, n - i);
+}
+#endif
+
+static void
+grey_row_to_rgb32(const unsigned char * src, unsigned int * dst, int n)
+{
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+	{
+		grey_row_to_rgb32_sse2(src, dst, n);
+		return;
+	}
+#endif
+
+	grey_row_to_rgb32_c(src, dst, n);
+}
+
+/* Grey levels are taken as full range and copied to r, g and b */
+int conv_grey_to_rgb32(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	grey_row_to_rgb32((const unsigned char *)src, (unsigned int *)dest,
+			width * height);
+
 	return 0;
 }
 
-int conv_bottom_up_rgb24_to_rgb32(int width, int height,
-		const char * src, char * dest)
+int conv_y16_to_rgb32(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
 {
-	int i, j;
+	enum { chunk = 256 };
+	unsigned char grey[chunk];
 	unsigned int * d = (unsigned int *)dest;
-	const unsigned char * src_bot = (const unsigned char *)src +
-		width * (height - 1) * 3;
+	const int pixels = width * height;
+	int i, n;
 
-	for ( i = 0; i < height; ++i )
+	for ( i = 0; i < pixels; i += chunk )
 	{
-		for ( j = 0; j < width; ++j )
-		{
-			*d = 0xff000000;
-			*d |= (*src_bot++) << 0;     /* red */
-			*d |= (*src_bot++) << 8;     /* green */
-			*d++ |= (*src_bot++) << 16;  /* blue */
-		}
-
-		src_bot -= width * 6;
+		n = pixels - i < chunk ? pixels - i : chunk;
+
+		conv_u16_to_u8(src + 2 * i, (char *)grey, n, params->bit_shift);
+		grey_row_to_rgb32(grey, d + i, n);
+	}
+
+	return 0;
+}
+
+/* P010 is narrowed to a band of nv12 rows at a time, then run through
+ * the nv12 kernel, so that there is one copy of the color math
+ */
+int conv_p010_to_rgb32(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	enum { band_rows = 16 };
+	const char * src_uv = src + 2 * width * height;
+	char * band;
+	int row, n;
+
+	if ( !(band = malloc(width * band_rows * 3 / 2)) )
+	{
+		log_oom(__FILE__, __LINE__);
+		return -1;
+	}
+
+	for ( row = 0; row < height; row += n )
+	{
+		n = height - row < band_rows ? height - row : band_rows;
+
+		conv_u16_to_u8(src + 2 * width * row, band, width * n,
+				params->bit_shift);
+		conv_u16_to_u8(src_uv + width * row, band + width * n,
+				width * n / 2, params->bit_shift);
+		conv_nv12_to_rgb32(params, width, n, band,
+				dest + 4 * width * row);
 	}
 
+	free(band);
 	return 0;
 }
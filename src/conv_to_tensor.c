@@ -0,0 +1,436 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file conv_to_tensor.c
+ *  \ingroup Core
+ *  \brief Conversions to planar floating point rgb for inference.
+ */
+
+#include <string.h>
+
+#include "colorimetry.h"
+#include "conv.h"
+#include "cpu.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+#ifdef CPU_F16C
+#include <immintrin.h>
+#endif
+
+enum
+{
+	/* Pixels converted per step; intermediates stay in L1 */
+	tensor_chunk = 256,
+};
+
+struct tensor_dst
+{
+	const struct conv_params * params;
+	int half;
+	char * planes[3];
+};
+
+static __inline float
+clamp_sample(float v)
+{
+	return v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v;
+}
+
+static void
+yuv_to_tensor_c(const unsigned char * y, const unsigned char * u,
+		const unsigned char * v, int n, const struct conv_params * p,
+		float * r_out, float * g_out, float * b_out)
+{
+	const struct colorimetry * c = p->color;
+	const float y_offset = (float)c->y_offset;
+	int i;
+
+	for ( i = 0; i < n; ++i )
+	{
+		const float yv = c->y_mul * ((float)y[i] - y_offset);
+		const float uc = (float)u[i / 2] - 128.0f;
+		const float vc = (float)v[i / 2] - 128.0f;
+		const float r = clamp_sample(yv + c->r_v_mul * vc);
+		const float g = clamp_sample(yv - c->g_u_mul * uc -
+				c->g_v_mul * vc);
+		const float b = clamp_sample(yv + c->b_u_mul * uc);
+
+		r_out[i] = r * p->tensor_scale[0] + p->tensor_bias[0];
+		g_out[i] = g * p->tensor_scale[1] + p->tensor_bias[1];
+		b_out[i] = b * p->tensor_scale[2] + p->tensor_bias[2];
+	}
+}
+
+#ifdef CPU_X86
+CPU_TARGET("sse2") static __m128
+bytes_to_ps(__m128i bytes)
+{
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(
+				_mm_unpacklo_epi8(bytes, _mm_setzero_si128()),
+				_mm_setzero_si128()));
+}
+
+CPU_TARGET("sse2") static void
+yuv4_to_tensor_sse2(__m128 yf, __m128 uc, __m128 vc,
+		const struct conv_params * p, float * r_out, float * g_out,
+		float * b_out)
+{
+	const struct colorimetry * c = p->color;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 max = _mm_set1_ps(255.0f);
+	const __m128 yv = _mm_mul_ps(_mm_set1_ps(c->y_mul),
+			_mm_sub_ps(yf, _mm_set1_ps((float)c->y_offset)));
+	__m128 r, g, b;
+
+	r = _mm_add_ps(yv, _mm_mul_ps(_mm_set1_ps(c->r_v_mul), vc));
+	g = _mm_sub_ps(_mm_sub_ps(yv,
+				_mm_mul_ps(_mm_set1_ps(c->g_u_mul), uc)),
+			_mm_mul_ps(_mm_set1_ps(c->g_v_mul), vc));
+	b = _mm_add_ps(yv, _mm_mul_ps(_mm_set1_ps(c->b_u_mul), uc));
+
+	r = _mm_min_ps(_mm_max_ps(r, zero), max);
+	g = _mm_min_ps(_mm_max_ps(g, zero), max);
+	b = _mm_min_ps(_mm_max_ps(b, zero), max);
+
+	_mm_storeu_ps(r_out, _mm_add_ps(_mm_mul_ps(r,
+					_mm_set1_ps(p->tensor_scale[0])),
+				_mm_set1_ps(p->tensor_bias[0])));
+	_mm_storeu_ps(g_out, _mm_add_ps(_mm_mul_ps(g,
+					_mm_set1_ps(p->tensor_scale[1])),
+				_mm_set1_ps(p->tensor_bias[1])));
+	_mm_storeu_ps(b_out, _mm_add_ps(_mm_mul_ps(b,
+					_mm_set1_ps(p->tensor_scale[2])),
+				_mm_set1_ps(p->tensor_bias[2])));
+}
+
+/* Eight pixels per step: eight luma and four of each chroma sample,
+ * widened to floats, with each chroma sample used for two pixels.
+ */
+CPU_TARGET("sse2") static void
+yuv_to_tensor_sse2(const unsigned char * y, const unsigned char * u,
+		const unsigned char * v, int n, const struct conv_params * p,
+		float * r_out, float * g_out, float * b_out)
+{
+	const __m128 bias = _mm_set1_ps(128.0f);
+	int i;
+
+	for ( i = 0; i + 8 <= n; i += 8 )
+	{
+		int y4[2], u4, v4;
+		__m128 uf, vf;
+
+		memcpy(y4, y + i, 8);
+		memcpy(&u4, u + i / 2, 4);
+		memcpy(&v4, v + i / 2, 4);
+
+		uf = _mm_sub_ps(bytes_to_ps(_mm_cvtsi32_si128(u4)), bias);
+		vf = _mm_sub_ps(bytes_to_ps(_mm_cvtsi32_si128(v4)), bias);
+
+		yuv4_to_tensor_sse2(bytes_to_ps(_mm_cvtsi32_si128(y4[0])),
+				_mm_unpacklo_ps(uf, uf), _mm_unpacklo_ps(vf, vf),
+				p, r_out + i, g_out + i, b_out + i);
+		yuv4_to_tensor_sse2(bytes_to_ps(_mm_cvtsi32_si128(y4[1])),
+				_mm_unpackhi_ps(uf, uf), _mm_unpackhi_ps(vf, vf),
+				p, r_out + i + 4, g_out + i + 4, b_out + i + 4);
+	}
+
+	yuv_to_tensor_c(y + i, u + i / 2, v + i / 2, n - i, p,
+			r_out + i, g_out + i, b_out + i);
+}
+#endif
+
+/* IEEE 754 binary16 with round to nearest even */
+static unsigned short
+float_to_half(float f)
+{
+	unsigned int x;
+	unsigned int sign, mant, half, rem;
+	int exp;
+
+	memcpy(&x, &f, sizeof(x));
+
+	sign = (x >> 16) & 0x8000;
+	exp = (int)((x >> 23) & 0xff) - 127 + 15;
+	mant = x & 0x7fffff;
+
+	if ( ((x >> 23) & 0xff) == 0xff )
+		return (unsigned short)(sign | 0x7c00 | (mant ? 0x200 : 0));
+
+	if ( exp >= 31 )
+		return (unsigned short)(sign | 0x7c00);
+
+	if ( exp <= 0 )
+	{
+		const int shift = 14 - exp;
+
+		if ( shift > 24 )
+			return (unsigned short)sign;
+
+		mant |= 0x800000;
+		half = mant >> shift;
+		rem = mant & ((1u << shift) - 1);
+
+		if ( rem > (1u << (shift - 1)) ||
+				(rem == (1u << (shift - 1)) && (half & 1)) )
+			++half;
+
+		return (unsigned short)(sign | half);
+	}
+
+	/* A carry out of the mantissa correctly bumps the exponent */
+	half = ((unsigned int)exp << 10) | (mant >> 13);
+	rem = mant & 0x1fff;
+
+	if ( rem > 0x1000 || (rem == 0x1000 && (half & 1)) )
+		++half;
+
+	return (unsigned short)(sign | half);
+}
+
+static void
+floats_to_half_c(const float * src, unsigned short * dst, int n)
+{
+	int i;
+
+	for ( i = 0; i < n; ++i )
+		dst[i] = float_to_half(src[i]);
+}
+
+#ifdef CPU_F16C
+CPU_TARGET("f16c") static void
+floats_to_half_f16c(const float * src, unsigned short * dst, int n)
+{
+	int i;
+
+	for ( i = 0; i + 4 <= n; i += 4 )
+		_mm_storel_epi64((__m128i *)(dst + i),
+				_mm_cvtps_ph(_mm_loadu_ps(src + i), 0));
+
+	floats_to_half_c(src + i, dst + i, n - i);
+}
+#endif
+
+static void
+floats_to_half(const float * src, unsigned short * dst, int n)
+{
+#ifdef CPU_F16C
+	if ( cpu_flags_get() & cpu_flag_f16c )
+	{
+		floats_to_half_f16c(src, dst, n);
+		return;
+	}
+#endif
+
+	floats_to_half_c(src, dst, n);
+}
+
+/* Convert n pixels (n even) starting at pixel offset of the output.
+ * Float planes are written in place; half planes go through a chunk
+ * of floats first.
+ */
+static void
+yuv_chunk_to_tensor(const unsigned char * y, const unsigned char * u,
+		const unsigned char * v, int n, const struct tensor_dst * dst,
+		int offset)
+{
+	float tmp[3][tensor_chunk];
+	float * out[3];
+	int c;
+
+	for ( c = 0; c < 3; ++c )
+		out[c] = dst->half ? tmp[c] :
+			(float *)dst->planes[c] + offset;
+
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+		yuv_to_tensor_sse2(y, u, v, n, dst->params,
+				out[0], out[1], out[2]);
+	else
+#endif
+		yuv_to_tensor_c(y, u, v, n, dst->params,
+				out[0], out[1], out[2]);
+
+	if ( dst->half )
+		for ( c = 0; c < 3; ++c )
+			floats_to_half(tmp[c],
+					(unsigned short *)dst->planes[c] + offset,
+					n);
+}
+
+static void
+tensor_dst_init(struct tensor_dst * dst, const struct conv_params * params,
+		int half, int width, int height, char * dest)
+{
+	const int plane_size = width * height * (half ? 2 : 4);
+
+	dst->params = params;
+	dst->half = half;
+	dst->planes[0] = dest;
+	dst->planes[1] = dest + plane_size;
+	dst->planes[2] = dest + 2 * plane_size;
+}
+
+static void
+i420_to_tensor(const struct conv_params * params, int half,
+		int width, int height, const char * src, char * dest)
+{
+	const unsigned char * src_y = (const unsigned char *)src;
+	const unsigned char * src_u = src_y + width * height;
+	const unsigned char * src_v = src_u + width * height / 4;
+	struct tensor_dst dst;
+	int row, x, n;
+
+	tensor_dst_init(&dst, params, half, width, height, dest);
+
+	for ( row = 0; row < height; ++row )
+	{
+		const unsigned char * y = src_y + row * width;
+		const unsigned char * u = src_u + (row / 2) * (width / 2);
+		const unsigned char * v = src_v + (row / 2) * (width / 2);
+
+		for ( x = 0; x < width; x += n )
+		{
+			n = width - x < tensor_chunk ? width - x : tensor_chunk;
+			yuv_chunk_to_tensor(y + x, u + x / 2, v + x / 2, n,
+					&dst, row * width + x);
+		}
+	}
+}
+
+static void
+nv12_to_tensor(const struct conv_params * params, int half,
+		int width, int height, const char * src, char * dest)
+{
+	const unsigned char * src_y = (const unsigned char *)src;
+	const unsigned char * src_uv = src_y + width * height;
+	unsigned char u[tensor_chunk / 2];
+	unsigned char v[tensor_chunk / 2];
+	struct tensor_dst dst;
+	int row, x, n, i;
+
+	tensor_dst_init(&dst, params, half, width, height, dest);
+
+	for ( row = 0; row < height; ++row )
+	{
+		const unsigned char * y = src_y + row * width;
+		const unsigned char * uv = src_uv + (row / 2) * width;
+
+		for ( x = 0; x < width; x += n )
+		{
+			n = width - x < tensor_chunk ? width - x : tensor_chunk;
+
+			for ( i = 0; i < n / 2; ++i )
+			{
+				u[i] = uv[x + 2 * i];
+				v[i] = uv[x + 2 * i + 1];
+			}
+
+			yuv_chunk_to_tensor(y + x, u, v, n, &dst,
+					row * width + x);
+		}
+	}
+}
+
+static void
+yuy2_to_tensor(const struct conv_params * params, int half,
+		int width, int height, const char * src, char * dest)
+{
+	const unsigned char * s = (const unsigned char *)src;
+	unsigned char y[tensor_chunk];
+	unsigned char u[tensor_chunk / 2];
+	unsigned char v[tensor_chunk / 2];
+	struct tensor_dst dst;
+	const int pixels = width * height;
+	int x, n, i;
+
+	tensor_dst_init(&dst, params, half, width, height, dest);
+
+	/* Packed rows carry their own chroma, so the frame is one row */
+	for ( x = 0; x < pixels; x += n )
+	{
+		n = pixels - x < tensor_chunk ? pixels - x : tensor_chunk;
+
+		for ( i = 0; i < n / 2; ++i, s += 4 )
+		{
+			y[2 * i] = s[0];
+			u[i] = s[1];
+			y[2 * i + 1] = s[2];
+			v[i] = s[3];
+		}
+
+		yuv_chunk_to_tensor(y, u, v, n, &dst, x);
+	}
+}
+
+int
+conv_i420_to_rgb_f32(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	i420_to_tensor(params, 0, width, height, src, dst);
+	return 0;
+}
+
+int
+conv_i420_to_rgb_f16(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	i420_to_tensor(params, 1, width, height, src, dst);
+	return 0;
+}
+
+int
+conv_nv12_to_rgb_f32(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	nv12_to_tensor(params, 0, width, height, src, dst);
+	return 0;
+}
+
+int
+conv_nv12_to_rgb_f16(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	nv12_to_tensor(params, 1, width, height, src, dst);
+	return 0;
+}
+
+int
+conv_yuy2_to_rgb_f32(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	yuy2_to_tensor(params, 0, width, height, src, dst);
+	return 0;
+}
+
+int
+conv_yuy2_to_rgb_f16(const struct conv_params * params,
+		int width, int height, const char * src, char * dst)
+{
+	yuy2_to_tensor(params, 1, width, height, src, dst);
+	return 0;
+}
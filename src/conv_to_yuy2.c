@@ -31,14 +31,29 @@
  *  \since 2007
  */
  
-#include <vidcap/converters.h>
+#include "colorimetry.h"
+#include "conv.h"
+#include "cpu.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
 
 /** \note size of dest buffer must be >= width * height * 2 */
 
-/* Based on formulas found at http://en.wikipedia.org/wiki/YUV */
 int
 vidcap_rgb32_to_yuy2(int width, int height, const char * src, char * dest)
 {
+	return conv_packed(VIDCAP_FOURCC_RGB32, VIDCAP_FOURCC_YUY2,
+			width, height, src, dest);
+}
+
+/* Based on formulas found at http://en.wikipedia.org/wiki/YUV */
+int
+conv_rgb32_to_yuy2(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	const struct colorimetry * c = params->color;
 	const unsigned char * src_even = (const unsigned char *)src;
 	const unsigned char * src_odd = src_even + width * 4;
 	unsigned char * dst_even = (unsigned char *)dest;
@@ -57,29 +72,29 @@ vidcap_rgb32_to_yuy2(int width, int height, const char * src, char * dest)
 			g = *src_even++;
 			r = *src_even++;
 			++src_even;
-			*dst_even++ = (( r * 66 + g * 129 + b * 25 + 128 ) >> 8 ) + 16;
-			*dst_even++ = (( r * -38 - g * 74 + b * 112 + 128 ) >> 8 ) + 128;
+			*dst_even++ = colorimetry_y(c, r, g, b);
+			*dst_even++ = colorimetry_u(c, r, g, b);
 
 			b = *src_even++;
 			g = *src_even++;
 			r = *src_even++;
 			++src_even;
-			*dst_even++ = (( r * 66 + g * 129 + b * 25 + 128 ) >> 8 ) + 16;
-			*dst_even++ = (( r * 112 - g * 94 - b * 18 + 128 ) >> 8 ) + 128;
+			*dst_even++ = colorimetry_y(c, r, g, b);
+			*dst_even++ = colorimetry_v(c, r, g, b);
 
 			b = *src_odd++;
 			g = *src_odd++;
 			r = *src_odd++;
 			++src_odd;
-			*dst_odd++ = (( r * 66 + g * 129 + b * 25 + 128 ) >> 8 ) + 16;
-			*dst_odd++ = (( r * -38 - g * 74 + b * 112 + 128 ) >> 8 ) + 128;
+			*dst_odd++ = colorimetry_y(c, r, g, b);
+			*dst_odd++ = colorimetry_u(c, r, g, b);
 
 			b = *src_odd++;
 			g = *src_odd++;
 			r = *src_odd++;
 			++src_odd;
-			*dst_odd++ = (( r * 66 + g * 129 + b * 25 + 128 ) >> 8 ) + 16;
-			*dst_odd++ = (( r * 112 - g * 94 - b * 18 + 128 ) >> 8 ) + 128;
+			*dst_odd++ = colorimetry_y(c, r, g, b);
+			*dst_odd++ = colorimetry_v(c, r, g, b);
 		}
 
 		dst_even += width * 2;
@@ -91,18 +106,83 @@ vidcap_rgb32_to_yuy2(int width, int height, const char * src, char * dest)
 	return 0;
 }
 
+static void
+i420_rows_to_yuy2_c(const unsigned char * src_y_even,
+		const unsigned char * src_y_odd, const unsigned char * src_u,
+		const unsigned char * src_v, int width,
+		unsigned char * dst_even, unsigned char * dst_odd)
+{
+	int j;
+
+	for ( j = 0; j < width / 2; ++j )
+	{
+		*dst_even++ = *src_y_even++;
+		*dst_odd++  = *src_y_odd++;
+
+		*dst_even++ = *src_u;
+		*dst_odd++  = *src_u++;
+
+		*dst_even++ = *src_y_even++;
+		*dst_odd++  = *src_y_odd++;
+
+		*dst_even++ = *src_v;
+		*dst_odd++  = *src_v++;
+	}
+}
+
+#ifdef CPU_X86
+CPU_TARGET("sse2") static void
+i420_rows_to_yuy2_sse2(const unsigned char * src_y_even,
+		const unsigned char * src_y_odd, const unsigned char * src_u,
+		const unsigned char * src_v, int width,
+		unsigned char * dst_even, unsigned char * dst_odd)
+{
+	int x;
+
+	for ( x = 0; x + 16 <= width; x += 16 )
+	{
+		const __m128i u = _mm_loadl_epi64(
+				(const __m128i *)(src_u + x / 2));
+		const __m128i v = _mm_loadl_epi64(
+				(const __m128i *)(src_v + x / 2));
+		const __m128i uv = _mm_unpacklo_epi8(u, v);
+		const __m128i ye = _mm_loadu_si128(
+				(const __m128i *)(src_y_even + x));
+		const __m128i yo = _mm_loadu_si128(
+				(const __m128i *)(src_y_odd + x));
+		__m128i * d_even = (__m128i *)(dst_even + 2 * x);
+		__m128i * d_odd = (__m128i *)(dst_odd + 2 * x);
+
+		_mm_storeu_si128(d_even, _mm_unpacklo_epi8(ye, uv));
+		_mm_storeu_si128(d_even + 1, _mm_unpackhi_epi8(ye, uv));
+		_mm_storeu_si128(d_odd, _mm_unpacklo_epi8(yo, uv));
+		_mm_storeu_si128(d_odd + 1, _mm_unpackhi_epi8(yo, uv));
+	}
+
+	i420_rows_to_yuy2_c(src_y_even + x, src_y_odd + x,
+			src_u + x / 2, src_v + x / 2, width - x,
+			dst_even + 2 * x, dst_odd + 2 * x);
+}
+#endif
+
 int
 vidcap_i420_to_yuy2(int width, int height, const char * src, char * dest)
+{
+	return conv_packed(VIDCAP_FOURCC_I420, VIDCAP_FOURCC_YUY2,
+			width, height, src, dest);
+}
+
+int
+conv_i420_to_yuy2(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
 {
 	/* convert from a planar structure to a packed structure */
-	const char * src_y_even = src;
-	const char * src_y_odd = src + width;
-	const char * src_u = src + width * height;
-	const char * src_v = src_u + width * height / 4;
-	char * dst_even = dest;
-	char * dst_odd = dest + width * 2;
+	const unsigned char * src_y = (const unsigned char *)src;
+	const unsigned char * src_u = src_y + width * height;
+	const unsigned char * src_v = src_u + width * height / 4;
+	unsigned char * dst = (unsigned char *)dest;
 
-	int i, j;
+	int i;
 
 	/* i420 has a vertical sampling period (for u and v)
 	 * double that for yuy2. Will re-use
@@ -110,38 +190,32 @@ vidcap_i420_to_yuy2(int width, int height, const char * src, char * dest)
 	 */
 	for ( i = 0; i < height / 2; ++i )
 	{
-		for ( j = 0; j < width / 2; ++j )
-		{
-			*dst_even++ = *src_y_even++;
-			*dst_odd++  = *src_y_odd++;
-
-			*dst_even++ = *src_u;
-			*dst_odd++  = *src_u++;
-
-			*dst_even++ = *src_y_even++;
-			*dst_odd++  = *src_y_odd++;
-
-			*dst_even++ = *src_v;
-			*dst_odd++  = *src_v++;
-		}
+#ifdef CPU_X86
+		if ( cpu_flags_get() & cpu_flag_sse2 )
+			i420_rows_to_yuy2_sse2(src_y, src_y + width,
+					src_u, src_v, width,
+					dst, dst + width * 2);
+		else
+#endif
+			i420_rows_to_yuy2_c(src_y, src_y + width,
+					src_u, src_v, width,
+					dst, dst + width * 2);
 
-		src_y_even += width;
-		src_y_odd += width;
-		dst_even += width * 2;
-		dst_odd += width * 2;
+		src_y += width * 2;
+		src_u += width / 2;
+		src_v += width / 2;
+		dst += width * 4;
 	}
 
 	return 0;
 }
 
-int
-conv_2vuy_to_yuy2(int width, int height, const char * src, char * dest)
+static void
+swap_bytes_16_c(const unsigned int * s, unsigned int * d, int n)
 {
 	int i;
-	unsigned int * d = (unsigned int *)dest;
-	const unsigned int * s = (const unsigned int *)src;
 
-	for ( i = 0; i < width * height / 2; ++i )
+	for ( i = 0; i < n; ++i )
 	{
 		*d++ = ((*s & 0xff000000) >> 8) |
 			((*s & 0x00ff0000) << 8) |
@@ -149,6 +223,43 @@ conv_2vuy_to_yuy2(int width, int height, const char * src, char * dest)
 			((*s & 0x000000ff) << 8);
 		++s;
 	}
+}
+
+#ifdef CPU_X86
+CPU_TARGET("sse2") static void
+swap_bytes_16_sse2(const unsigned int * s, unsigned int * d, int n)
+{
+	int i;
+
+	for ( i = 0; i + 4 <= n; i += 4 )
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+
+		_mm_storeu_si128((__m128i *)(d + i),
+				_mm_or_si128(_mm_slli_epi16(v, 8),
+					_mm_srli_epi16(v, 8)));
+	}
+
+	swap_bytes_16_c(s + i, d + i, n - i);
+}
+#endif
+
+int
+conv_2vuy_to_yuy2(const struct conv_params * params,
+		int width, int height, const char * src, char * dest)
+{
+	const unsigned int * s = (const unsigned int *)src;
+	unsigned int * d = (unsigned int *)dest;
+
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+	{
+		swap_bytes_16_sse2(s, d, width * height / 2);
+		return 0;
+	}
+#endif
+
+	swap_bytes_16_c(s, d, width * height / 2);
 
 	return 0;
 }
@@ -0,0 +1,77 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _CONV_TRAITS_H
+#define _CONV_TRAITS_H
+
+/** \file conv_traits.h
+ *  \ingroup Core
+ *  \brief Pixel format traits that the generated converters are built from.
+ *
+ *  Each list applies a macro to every format it holds. The kernels in
+ *  conv_to_rgb.c and the entries of the conversion list in conv.c are
+ *  both expanded from these lists, so a layout added here gains every
+ *  conversion its traits allow.
+ *
+ *  Only conversions to rgb layouts are generated. The i420, yuy2, grey,
+ *  tensor and Bayer converters each have a loop of their own shape and
+ *  stay written out in their own files.
+ */
+
+/* Packed rgb layouts: name, fourcc suffix, bytes per pixel, store stage
+ * and the byte offsets of red, green and blue. Four byte layouts set
+ * the remaining byte as opaque alpha. rgb32 is a native endian word and
+ * rgb565 a little endian word, so their store stages ignore the offsets.
+ */
+#define CONV_RGB_LAYOUTS(X)					\
+	X(bgra,   BGRA,   4, STORE_BYTES,  2, 1, 0)		\
+	X(rgba,   RGBA,   4, STORE_BYTES,  0, 1, 2)		\
+	X(argb,   ARGB,   4, STORE_BYTES,  1, 2, 3)		\
+	X(bgr24,  BGR24,  3, STORE_BYTES,  2, 1, 0)		\
+	X(rgb565, RGB565, 2, STORE_RGB565, 0, 0, 0)
+
+#define CONV_RGB_OUTPUTS(X)					\
+	X(rgb32,  RGB32,  4, STORE_RGB32,  0, 0, 0)		\
+	CONV_RGB_LAYOUTS(X)
+
+/* 4:2:0 sources: name, fourcc suffix and the distance between chroma
+ * samples. A step of one is planar u then v; a step of two is
+ * interleaved u and v.
+ *
+ * The source lists pass one rgb output through to the applied macro
+ * so that nesting them in an output list covers every pair.
+ */
+#define CONV_420_SOURCES(X, name, FOURCC, bpp, STORE, r, g, b)		\
+	X(i420, I420, 1, name, FOURCC, bpp, STORE, r, g, b)		\
+	X(nv12, NV12, 2, name, FOURCC, bpp, STORE, r, g, b)
+
+/* Packed 4:2:2 sources: name, fourcc suffix and the byte offsets of the
+ * first luma, u, second luma and v within a macropixel.
+ */
+#define CONV_422_SOURCES(X, name, FOURCC, bpp, STORE, r, g, b)		\
+	X(yuy2, YUY2, 0, 1, 2, 3, name, FOURCC, bpp, STORE, r, g, b)	\
+	X(2vuy, 2VUY, 1, 0, 3, 2, name, FOURCC, bpp, STORE, r, g, b)
+
+#endif
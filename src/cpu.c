@@ -0,0 +1,194 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file cpu.c
+ *  \ingroup Core
+ *  \brief Runtime detection of cpu features used to select kernels.
+ */
+
+#include "cpu.h"
+
+#if defined(CPU_X86) && defined(__GNUC__)
+#include <cpuid.h>
+#elif defined(CPU_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* Probing is idempotent, so racing first callers are harmless */
+static int cpu_flags = -1;
+static int cpu_cache_size = -1;
+
+/* Assumed when the cpu does not describe its caches */
+static const int cpu_cache_size_default = 4 * 1024 * 1024;
+
+#ifdef CPU_X86
+static void
+cpuid(unsigned int leaf, unsigned int regs[4])
+{
+#if defined(__GNUC__)
+	if ( !__get_cpuid(leaf, &regs[0], &regs[1], &regs[2], &regs[3]) )
+		regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#elif defined(_MSC_VER)
+	__cpuid((int *)regs, leaf);
+#else
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+/* Leaves with subleaves. Unsupported leaves read as zero. */
+static void
+cpuid_count(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+{
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+
+#if defined(__GNUC__)
+	if ( leaf <= __get_cpuid_max(leaf & 0x80000000, 0) )
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2],
+				regs[3]);
+#elif defined(_MSC_VER) && _MSC_VER >= 1500
+	{
+		int max_regs[4];
+
+		__cpuid(max_regs, leaf & 0x80000000);
+
+		if ( leaf <= (unsigned int)max_regs[0] )
+			__cpuidex((int *)regs, leaf, subleaf);
+	}
+#endif
+}
+
+/* Whether the OS saves the ymm state, which VEX encoded instructions
+ * such as those of F16C require.
+ */
+static int
+os_saves_ymm(const unsigned int regs[4])
+{
+	unsigned int xcr0 = 0;
+
+	if ( !(regs[2] & (1 << 27)) )
+		return 0;
+
+#if defined(__GNUC__)
+	{
+		unsigned int edx;
+		__asm__ volatile ( "xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0) );
+	}
+#elif defined(_MSC_VER) && _MSC_VER >= 1600
+	xcr0 = (unsigned int)_xgetbv(0);
+#endif
+
+	return (xcr0 & 6) == 6;
+}
+#endif
+
+static int
+cpu_flags_probe(void)
+{
+	int flags = 0;
+
+#ifdef CPU_X86
+	unsigned int regs[4];
+
+	cpuid(1, regs);
+
+	if ( regs[3] & (1 << 26) )
+		flags |= cpu_flag_sse2;
+
+	if ( regs[2] & (1 << 9) )
+		flags |= cpu_flag_ssse3;
+
+	if ( (regs[2] & (1 << 29)) && os_saves_ymm(regs) )
+		flags |= cpu_flag_f16c;
+#endif
+
+	return flags;
+}
+
+int
+cpu_flags_get(void)
+{
+	if ( cpu_flags < 0 )
+		cpu_flags = cpu_flags_probe();
+
+	return cpu_flags;
+}
+
+/* The largest data or unified cache. Intel describes each cache in leaf
+ * 4; AMD gives the L2 and L3 sizes in leaf 0x80000006.
+ */
+static int
+cpu_cache_size_probe(void)
+{
+	int size = 0;
+
+#ifdef CPU_X86
+	unsigned int regs[4];
+	unsigned int i;
+
+	for ( i = 0; i < 16; ++i )
+	{
+		unsigned int type;
+		int ways, partitions, line, sets;
+
+		cpuid_count(4, i, regs);
+
+		/* Type zero ends the list; type two is an instruction cache */
+		if ( !(type = regs[0] & 0x1f) )
+			break;
+
+		if ( type == 2 )
+			continue;
+
+		ways = ((regs[1] >> 22) & 0x3ff) + 1;
+		partitions = ((regs[1] >> 12) & 0x3ff) + 1;
+		line = (regs[1] & 0xfff) + 1;
+		sets = (int)regs[2] + 1;
+
+		if ( ways * partitions * line * sets > size )
+			size = ways * partitions * line * sets;
+	}
+
+	if ( !size )
+	{
+		cpuid_count(0x80000006, 0, regs);
+
+		size = (int)(regs[2] >> 16) * 1024;
+
+		if ( (int)(regs[3] >> 18) * 512 * 1024 > size )
+			size = (int)(regs[3] >> 18) * 512 * 1024;
+	}
+#endif
+
+	return size ? size : cpu_cache_size_default;
+}
+
+int
+cpu_cache_size_get(void)
+{
+	if ( cpu_cache_size < 0 )
+		cpu_cache_size = cpu_cache_size_probe();
+
+	return cpu_cache_size;
+}
@@ -0,0 +1,94 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _CPU_H
+#define _CPU_H
+
+/** \file cpu.h
+ *  \ingroup Core
+ *  \brief Runtime detection of cpu features used to select kernels.
+ */
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_X86 1
+#endif
+
+/* Visual Studio only has SSSE3 intrinsics from 2008 on */
+#if defined(CPU_X86) && ( !defined(_MSC_VER) || _MSC_VER >= 1500 )
+#define CPU_SSSE3 1
+#endif
+
+/* ... and F16C intrinsics from 2012 on */
+#if defined(CPU_X86) && ( !defined(_MSC_VER) || _MSC_VER >= 1700 )
+#define CPU_F16C 1
+#endif
+
+/* Kernels for instruction sets beyond the compiler's baseline are
+ * built per function. Callers must check cpu_flags_get() before
+ * calling them.
+ */
+#if defined(__GNUC__)
+#define CPU_TARGET(x) __attribute__((target(x)))
+#else
+#define CPU_TARGET(x)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum cpu_flag
+{
+	cpu_flag_sse2  = 1 << 0,
+	cpu_flag_ssse3 = 1 << 1,
+	cpu_flag_f16c  = 1 << 2,
+};
+
+/**
+ *  \brief Get the cpu features available on this machine
+ *  
+ *  \return Bitwise or of cpu_flag values
+ *  
+ *  \details The features are probed on the first call and cached.
+ */
+int
+cpu_flags_get(void);
+
+/**
+ *  \brief Get the size of the largest cpu cache
+ *  
+ *  \return Size in bytes of the last level cache
+ *  
+ *  \details Probed on the first call and cached. A default size is
+ *  returned when the cpu does not report its caches.
+ */
+int
+cpu_cache_size_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
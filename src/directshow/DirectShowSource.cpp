@@ -1121,6 +1121,41 @@ DirectShowSource::mapDirectShowMediaTypeToVidcapFourcc(DWORD data, int & fourcc)
 	case 0x39555659:
 		fourcc = VIDCAP_FOURCC_YVU9;
 		break;
+	case 0x47504a4d: // MJPG
+		fourcc = VIDCAP_FOURCC_MJPG;
+		break;
+	case 0x34363248: // H264
+		fourcc = VIDCAP_FOURCC_H264;
+		break;
+	case 0x30303859: // Y800
+	case 0x20203859: // Y8
+	case 0x59455247: // GREY
+		fourcc = VIDCAP_FOURCC_GREY;
+		break;
+	case 0x20303159: // Y10
+		fourcc = VIDCAP_FOURCC_Y10;
+		break;
+	case 0x20363159: // Y16
+		fourcc = VIDCAP_FOURCC_Y16;
+		break;
+	case 0x3231564e: // NV12
+		fourcc = VIDCAP_FOURCC_NV12;
+		break;
+	case 0x30313050: // P010
+		fourcc = VIDCAP_FOURCC_P010;
+		break;
+	case 0x31384142: // BA81
+		fourcc = VIDCAP_FOURCC_BA81;
+		break;
+	case 0x47524247: // GBRG
+		fourcc = VIDCAP_FOURCC_GBRG;
+		break;
+	case 0x47425247: // GRBG
+		fourcc = VIDCAP_FOURCC_GRBG;
+		break;
+	case 0x42474752: // RGGB
+		fourcc = VIDCAP_FOURCC_RGGB;
+		break;
 	default:
 		log_warn("failed to map 0x%08x to vidcap fourcc\n", data);
 		return -1;
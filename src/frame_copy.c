@@ -0,0 +1,124 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file frame_copy.c
+ *  \ingroup Core
+ *  \brief Copies of whole frames and frame planes.
+ */
+
+#include <string.h>
+
+#include "cpu.h"
+#include "frame_copy.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+#ifdef CPU_X86
+/* 64 bytes per step with the source prefetched 1 KB ahead. The
+ * destination is brought to a 16 byte boundary with a regular copy,
+ * which movntdq requires, and the tail of the row is also copied
+ * regularly.
+ */
+CPU_TARGET("sse2") static void
+copy_row_stream_sse2(char * dst, const char * src, int n)
+{
+	const int head = (int)((16 - ((size_t)dst & 15)) & 15);
+	int i;
+
+	if ( n < head + 64 )
+	{
+		memcpy(dst, src, n);
+		return;
+	}
+
+	memcpy(dst, src, head);
+
+	for ( i = head; i + 64 <= n; i += 64 )
+	{
+		const __m128i * s = (const __m128i *)(src + i);
+		__m128i * d = (__m128i *)(dst + i);
+
+		_mm_prefetch(src + i + 1024, _MM_HINT_T0);
+
+		_mm_stream_si128(d, _mm_loadu_si128(s));
+		_mm_stream_si128(d + 1, _mm_loadu_si128(s + 1));
+		_mm_stream_si128(d + 2, _mm_loadu_si128(s + 2));
+		_mm_stream_si128(d + 3, _mm_loadu_si128(s + 3));
+	}
+
+	memcpy(dst + i, src + i, n - i);
+}
+
+CPU_TARGET("sse2") static void
+copy_rows_stream_sse2(char * dst, int dst_stride,
+		const char * src, int src_stride,
+		int row_bytes, int rows)
+{
+	int i;
+
+	for ( i = 0; i < rows; ++i )
+		copy_row_stream_sse2(dst + i * dst_stride,
+				src + i * src_stride, row_bytes);
+
+	/* Streaming stores are weakly ordered. Make them visible before
+	 * the frame is handed to another thread.
+	 */
+	_mm_sfence();
+}
+#endif
+
+void
+frame_copy_rows(char * dst, int dst_stride,
+		const char * src, int src_stride,
+		int row_bytes, int rows)
+{
+	int i;
+
+	if ( row_bytes < 1 || rows < 1 )
+		return;
+
+	/* Tightly packed rows are one long row */
+	if ( dst_stride == row_bytes && src_stride == row_bytes )
+	{
+		row_bytes *= rows;
+		rows = 1;
+	}
+
+#ifdef CPU_X86
+	/* Stream copies of at least half the cache */
+	if ( (cpu_flags_get() & cpu_flag_sse2) &&
+			row_bytes >= cpu_cache_size_get() / 2 / rows )
+	{
+		copy_rows_stream_sse2(dst, dst_stride, src, src_stride,
+				row_bytes, rows);
+		return;
+	}
+#endif
+
+	for ( i = 0; i < rows; ++i )
+		memcpy(dst + i * dst_stride, src + i * src_stride, row_bytes);
+}
@@ -0,0 +1,63 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _FRAME_COPY_H
+#define _FRAME_COPY_H
+
+/** \file frame_copy.h
+ *  \ingroup Core
+ *  \brief Copies of whole frames and frame planes.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  \brief Copy rows between two strided buffers
+ *
+ *  \param [in] dst        First destination row
+ *  \param [in] dst_stride Bytes between destination rows
+ *  \param [in] src        First source row
+ *  \param [in] src_stride Bytes between source rows
+ *  \param [in] row_bytes  Bytes to copy from each row
+ *  \param [in] rows       Number of rows
+ *
+ *  \details Copies larger than half the last level cache bypass the
+ *  cache with non-temporal stores where the cpu has them, so that a
+ *  frame that is only read once more does not evict the caller's
+ *  working set. Smaller copies use regular stores, and tightly packed
+ *  rows are copied as one block.
+ */
+void
+frame_copy_rows(char * dst, int dst_stride,
+		const char * src, int src_stride,
+		int row_bytes, int rows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
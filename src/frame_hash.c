@@ -0,0 +1,130 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file frame_hash.c
+ *  \ingroup Core
+ *  \brief Sampled content hashes of captured buffers.
+ */
+
+#include <string.h>
+
+#include "frame_hash.h"
+
+/* The rounds of xxHash32, over samples of the buffer */
+
+enum
+{
+	hash_samples = 256,
+	hash_sample_bytes = 64,
+	hash_stripe_bytes = 16,
+};
+
+static const unsigned int prime1 = 2654435761U;
+static const unsigned int prime2 = 2246822519U;
+static const unsigned int prime3 = 3266489917U;
+static const unsigned int prime5 = 374761393U;
+
+static __inline unsigned int
+rotl(unsigned int x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static __inline unsigned int
+read32(const unsigned char * p)
+{
+	unsigned int v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static __inline unsigned int
+hash_round(unsigned int acc, unsigned int input)
+{
+	return rotl(acc + input * prime2, 13) * prime1;
+}
+
+static void
+hash_stripes(unsigned int acc[4], const unsigned char * p, int stripes)
+{
+	for ( ; stripes; --stripes, p += hash_stripe_bytes )
+	{
+		acc[0] = hash_round(acc[0], read32(p));
+		acc[1] = hash_round(acc[1], read32(p + 4));
+		acc[2] = hash_round(acc[2], read32(p + 8));
+		acc[3] = hash_round(acc[3], read32(p + 12));
+	}
+}
+
+unsigned int
+frame_hash(const char * data, int size)
+{
+	const unsigned char * p = (const unsigned char *)data;
+	const unsigned char * tail = p;
+	int tail_bytes = 0;
+	unsigned int acc[4];
+	unsigned int h;
+	int i;
+
+	acc[0] = prime1 + prime2;
+	acc[1] = prime2;
+	acc[2] = 0;
+	acc[3] = 0 - prime1;
+
+	if ( size <= hash_samples * hash_sample_bytes )
+	{
+		hash_stripes(acc, p, size / hash_stripe_bytes);
+		tail = p + size / hash_stripe_bytes * hash_stripe_bytes;
+		tail_bytes = size % hash_stripe_bytes;
+	}
+	else
+	{
+		const int step = (size - hash_sample_bytes) /
+			(hash_samples - 1);
+
+		for ( i = 0; i < hash_samples - 1; ++i )
+			hash_stripes(acc, p + i * step,
+					hash_sample_bytes / hash_stripe_bytes);
+
+		/* The last sample ends the buffer */
+		hash_stripes(acc, p + size - hash_sample_bytes,
+				hash_sample_bytes / hash_stripe_bytes);
+	}
+
+	h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) +
+		rotl(acc[3], 18) + (unsigned int)size;
+
+	for ( i = 0; i < tail_bytes; ++i )
+		h = rotl(h + tail[i] * prime5, 11) * prime1;
+
+	h ^= h >> 15;
+	h *= prime2;
+	h ^= h >> 13;
+	h *= prime3;
+	h ^= h >> 16;
+
+	return h;
+}
@@ -0,0 +1,56 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _FRAME_HASH_H
+#define _FRAME_HASH_H
+
+/** \file frame_hash.h
+ *  \ingroup Core
+ *  \brief Content hashes for spotting repeated frames.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  \brief Hash the content of a captured buffer
+ *
+ *  \param [in] data Buffer as received from the device
+ *  \param [in] size Size of the buffer in bytes
+ *  \return Hash of the buffer
+ *
+ *  \details Small buffers are hashed whole. Larger ones are hashed
+ *           over evenly spread samples, which sensor noise is certain
+ *           to reach in any new frame while costing a few microseconds.
+ */
+unsigned int
+frame_hash(const char * data, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
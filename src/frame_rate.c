@@ -0,0 +1,152 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file frame_rate.c
+ *  \ingroup Core
+ *  \brief Decimation and repetition of frames to an exact rational rate.
+ */
+
+#include "frame_rate.h"
+#include "logging.h"
+
+enum
+{
+	frame_rate_max_gap = 2, /* seconds */
+};
+
+static void
+tv_add(struct timeval * tv, long sec, long usec)
+{
+	tv->tv_sec += sec + usec / 1000000;
+	tv->tv_usec += usec % 1000000;
+
+	if ( tv->tv_usec >= 1000000 )
+	{
+		tv->tv_usec -= 1000000;
+		++tv->tv_sec;
+	}
+	else if ( tv->tv_usec < 0 )
+	{
+		tv->tv_usec += 1000000;
+		--tv->tv_sec;
+	}
+}
+
+/* Only this conversion rounds, and its result is never accumulated */
+static __inline long
+frac_to_usecs(const struct frame_rate * rate, long frac)
+{
+	return (long)((double)frac * 1000000.0 / rate->fps_numerator);
+}
+
+static struct timeval
+tick_time(const struct frame_rate * rate, const struct timeval * origin,
+		long sec, long frac)
+{
+	struct timeval tv = *origin;
+
+	tv_add(&tv, sec, frac_to_usecs(rate, frac));
+
+	return tv;
+}
+
+static __inline void
+tick_advance(const struct frame_rate * rate, long * sec, long * frac)
+{
+	*frac += rate->fps_denominator;
+	*sec += *frac / rate->fps_numerator;
+	*frac %= rate->fps_numerator;
+}
+
+void
+frame_rate_init(struct frame_rate * rate, int fps_numerator,
+		int fps_denominator)
+{
+	rate->fps_numerator = fps_numerator;
+	rate->fps_denominator = fps_denominator;
+	rate->started = 0;
+}
+
+static void
+frame_rate_start(struct frame_rate * rate, const struct timeval * arrival,
+		const struct timeval * wall)
+{
+	rate->origin = *arrival;
+	rate->origin_wall = *wall;
+	rate->next_sec = 0;
+	rate->next_frac = 0;
+	rate->started = 1;
+}
+
+int
+frame_rate_frame(struct frame_rate * rate, const struct timeval * arrival,
+		const struct timeval * wall)
+{
+	struct timeval tick;
+	double behind; /* ticks between the next tick and the frame */
+	int ticks, i;
+
+	if ( !rate->started )
+		frame_rate_start(rate, arrival, wall);
+
+	tick = tick_time(rate, &rate->origin, rate->next_sec, rate->next_frac);
+
+	if ( arrival->tv_sec - tick.tv_sec > frame_rate_max_gap )
+	{
+		log_info("frame rate restarted after a %ld second stall\n",
+				(long)(arrival->tv_sec - tick.tv_sec));
+		frame_rate_start(rate, arrival, wall);
+		tick = rate->origin;
+	}
+
+	behind = ((double)(arrival->tv_sec - tick.tv_sec) * 1000000.0 +
+			(arrival->tv_usec - tick.tv_usec)) *
+		rate->fps_numerator / rate->fps_denominator / 1000000.0;
+
+	if ( behind < -1.0 )
+		return 0;
+
+	ticks = behind >= 1.0 ? 1 + (int)behind : 1;
+
+	rate->first_sec = rate->next_sec;
+	rate->first_frac = rate->next_frac;
+
+	for ( i = 0; i < ticks; ++i )
+		tick_advance(rate, &rate->next_sec, &rate->next_frac);
+
+	return ticks;
+}
+
+struct timeval
+frame_rate_tick_time(const struct frame_rate * rate, int index)
+{
+	long sec = rate->first_sec;
+	long frac = rate->first_frac;
+
+	while ( index-- > 0 )
+		tick_advance(rate, &sec, &frac);
+
+	return tick_time(rate, &rate->origin_wall, sec, frac);
+}
@@ -0,0 +1,108 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _FRAME_RATE_H
+#define _FRAME_RATE_H
+
+/** \file frame_rate.h
+ *  \ingroup Core
+ *  \brief Conversion of captured frames to a constant frame rate.
+ */
+
+#include "os_funcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Output ticks at an exact rational rate. Tick times are kept as whole
+ * seconds and a count of 1/fps_numerator seconds since the origin so
+ * that they never accumulate rounding error.
+ */
+struct frame_rate
+{
+	int fps_numerator;
+	int fps_denominator;
+	int started;
+
+	/* The first frame, on both clocks */
+	struct timeval origin;
+	struct timeval origin_wall;
+
+	long next_sec;  /* next tick to fill */
+	long next_frac;
+	long first_sec; /* first tick filled by the last frame */
+	long first_frac;
+};
+
+/**
+ *  \brief Start converting to a rate
+ *
+ *  \param [out] rate            Converter
+ *  \param [in]  fps_numerator   Output frame rate numerator
+ *  \param [in]  fps_denominator Output frame rate denominator
+ */
+void
+frame_rate_init(struct frame_rate * rate, int fps_numerator,
+		int fps_denominator);
+
+/**
+ *  \brief Place a frame on the output ticks
+ *
+ *  \param [in] rate    Converter
+ *  \param [in] arrival Monotonic arrival time of the frame,
+ *                      see vc_now_monotonic()
+ *  \param [in] wall    Wall clock time of the frame, see vc_now()
+ *  \return Number of consecutive ticks the frame fills: 0 when it is
+ *          to be dropped, more than 1 when it is to be repeated
+ *
+ *  \details Ticks follow the first frame exactly. A frame fills the
+ *           next tick unless it arrives over a tick ahead of it, and
+ *           also fills any whole ticks it arrives behind. Jitter of
+ *           less than a tick thus never drops or repeats frames. After
+ *           a stall of more than frame_rate_max_gap seconds the ticks
+ *           restart from the frame ending it rather than repeating it
+ *           for the whole stall.
+ */
+int
+frame_rate_frame(struct frame_rate * rate, const struct timeval * arrival,
+		const struct timeval * wall);
+
+/**
+ *  \brief Wall clock time of a tick filled by the last frame
+ *
+ *  \param [in] rate  Converter
+ *  \param [in] index Index among the ticks the last frame filled
+ *  \return Time of the tick
+ */
+struct timeval
+frame_rate_tick_time(const struct frame_rate * rate, int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file frame_stats.c
+ *  \ingroup Core
+ *  \brief Luma statistics of delivered frames.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "conv.h"
+#include "cpu.h"
+#include "frame_stats.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+int
+frame_stats_supported(int fourcc)
+{
+	int step, offset;
+
+	return !conv_fmt_luma_layout_get(fourcc, &step, &offset);
+}
+
+/* Sums over luma samples [from, n) of a row: the samples, their
+ * differences with the next sample and with the sample above. The
+ * row pointers include the luma offset.
+ */
+static void
+row_sums_c(const unsigned char * row, const unsigned char * above,
+		int n, int step, int from, unsigned int sums[3])
+{
+	int i;
+
+	for ( i = from; i < n; ++i )
+	{
+		const int y = row[i * step];
+
+		sums[0] += y;
+
+		if ( i + 1 < n )
+			sums[1] += abs(row[(i + 1) * step] - y);
+
+		if ( above )
+			sums[2] += abs(above[i * step] - y);
+	}
+}
+
+#ifdef CPU_X86
+/* 16 luma samples from the start of a row, gathered from the even or
+ * odd bytes of packed 4:2:2
+ */
+CPU_TARGET("sse2") static __inline __m128i
+luma16_sse2(const unsigned char * row, int step, int offset)
+{
+	__m128i a, b;
+
+	if ( step == 1 )
+		return _mm_loadu_si128((const __m128i *)row);
+
+	a = _mm_loadu_si128((const __m128i *)row);
+	b = _mm_loadu_si128((const __m128i *)(row + 16));
+
+	if ( offset )
+	{
+		a = _mm_srli_epi16(a, 8);
+		b = _mm_srli_epi16(b, 8);
+	}
+	else
+	{
+		a = _mm_and_si128(a, _mm_set1_epi16(0xff));
+		b = _mm_and_si128(b, _mm_set1_epi16(0xff));
+	}
+
+	return _mm_packus_epi16(a, b);
+}
+
+CPU_TARGET("sse2") static __inline unsigned int
+sad_total_sse2(__m128i v)
+{
+	return _mm_cvtsi128_si32(v) +
+		_mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+}
+
+/* psadbw sums the samples against zero and the absolute differences
+ * against the shifted and the previous row, 16 samples at a time.
+ */
+CPU_TARGET("sse2") static void
+row_sums_sse2(const unsigned char * row, const unsigned char * above,
+		int n, int step, int offset, unsigned int sums[3])
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum = zero;
+	__m128i h_diff = zero;
+	__m128i v_diff = zero;
+	int i;
+
+	/* The next sample is also loaded, so one sample is kept spare */
+	for ( i = 0; i + 17 <= n; i += 16 )
+	{
+		const __m128i y = luma16_sse2(row + i * step, step, offset);
+
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(y, zero));
+		h_diff = _mm_add_epi64(h_diff, _mm_sad_epu8(y,
+					luma16_sse2(row + (i + 1) * step,
+						step, offset)));
+
+		if ( above )
+			v_diff = _mm_add_epi64(v_diff, _mm_sad_epu8(y,
+						luma16_sse2(above + i * step,
+							step, offset)));
+	}
+
+	sums[0] += sad_total_sse2(sum);
+	sums[1] += sad_total_sse2(h_diff);
+	sums[2] += sad_total_sse2(v_diff);
+
+	row_sums_c(row + offset, above ? above + offset : 0, n, step, i,
+			sums);
+}
+#endif
+
+/* Neighbouring samples are counted in separate histograms so that runs
+ * of one value, as in flat or dark frames, do not serialize on a single
+ * counter.
+ */
+static void
+histogram_row(const unsigned char * row, int n, int step,
+		unsigned int histograms[4][256])
+{
+	int i;
+
+	for ( i = 0; i + 4 <= n; i += 4 )
+	{
+		++histograms[0][row[i * step]];
+		++histograms[1][row[(i + 1) * step]];
+		++histograms[2][row[(i + 2) * step]];
+		++histograms[3][row[(i + 3) * step]];
+	}
+
+	for ( ; i < n; ++i )
+		++histograms[0][row[i * step]];
+}
+
+void
+frame_stats_compute(int fourcc, int width, int height, const char * frame,
+		struct vidcap_frame_stats * stats)
+{
+	const double diffs = (double)(width - 1) * height +
+		(double)width * (height - 1);
+	unsigned int histograms[4][256];
+	double sum = 0;
+	double diff = 0;
+	int step, offset;
+	int y, i;
+
+	memset(stats->histogram, 0, sizeof(stats->histogram));
+	memset(histograms, 0, sizeof(histograms));
+	stats->mean = 0;
+	stats->sharpness = 0;
+
+	if ( conv_fmt_luma_layout_get(fourcc, &step, &offset) || width < 1 ||
+			height < 1 )
+		return;
+
+	for ( y = 0; y < height; ++y )
+	{
+		const unsigned char * row =
+			(const unsigned char *)frame + y * width * step;
+		const unsigned char * above = y ? row - width * step : 0;
+		unsigned int sums[3] = { 0, 0, 0 };
+
+#ifdef CPU_X86
+		if ( cpu_flags_get() & cpu_flag_sse2 )
+			row_sums_sse2(row, above, width, step, offset, sums);
+		else
+#endif
+			row_sums_c(row + offset, above ? above + offset : 0,
+					width, step, 0, sums);
+
+		histogram_row(row + offset, width, step, histograms);
+
+		sum += sums[0];
+		diff += sums[1] + (double)sums[2];
+	}
+
+	for ( i = 0; i < 256; ++i )
+		stats->histogram[i] = histograms[0][i] + histograms[1][i] +
+			histograms[2][i] + histograms[3][i];
+
+	stats->mean = (float)(sum / ((double)width * height));
+
+	if ( diffs > 0 )
+		stats->sharpness = (float)(diff / diffs);
+}
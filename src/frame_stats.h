@@ -0,0 +1,66 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _FRAME_STATS_H
+#define _FRAME_STATS_H
+
+/** \file frame_stats.h
+ *  \ingroup Core
+ *  \brief Luma statistics of delivered frames.
+ */
+
+#include <vidcap/vidcap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  \brief Tells whether statistics can be gathered from a fourcc
+ *
+ *  \param [in] fourcc Fourcc of the frames
+ *  \return 1 if the frames carry an 8-bit luma sample per pixel
+ */
+int
+frame_stats_supported(int fourcc);
+
+/**
+ *  \brief Gather the luma statistics of one frame
+ *
+ *  \param [in]  fourcc Fourcc of the frame, see frame_stats_supported()
+ *  \param [in]  width  Width of the frame
+ *  \param [in]  height Height of the frame
+ *  \param [in]  frame  Tightly packed frame
+ *  \param [out] stats  Statistics of the frame
+ */
+void
+frame_stats_compute(int fourcc, int width, int height, const char * frame,
+		struct vidcap_frame_stats * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -50,6 +50,24 @@ const int hot_fourcc_list[] =
 	VIDCAP_FOURCC_RGB32,
 	VIDCAP_FOURCC_I420,
 	VIDCAP_FOURCC_YUY2,
+	VIDCAP_FOURCC_MJPG,
+	VIDCAP_FOURCC_H264,
+	VIDCAP_FOURCC_GREY,
+	VIDCAP_FOURCC_Y10,
+	VIDCAP_FOURCC_Y16,
+	VIDCAP_FOURCC_P010,
+	VIDCAP_FOURCC_BA81,
+	VIDCAP_FOURCC_GBRG,
+	VIDCAP_FOURCC_GRBG,
+	VIDCAP_FOURCC_RGGB,
+	VIDCAP_FOURCC_BGRA,
+	VIDCAP_FOURCC_RGBA,
+	VIDCAP_FOURCC_ARGB,
+	VIDCAP_FOURCC_BGR24,
+	VIDCAP_FOURCC_RGB565,
+	VIDCAP_FOURCC_NV12,
+	VIDCAP_FOURCC_RGB_F32,
+	VIDCAP_FOURCC_RGB_F16,
 };
 
 const int hot_fourcc_list_len =
@@ -0,0 +1,262 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file jitter_buffer.c
+ *  \ingroup Core
+ *  \brief A small ring of frames released on a monotonic schedule.
+ */
+
+#include <stdlib.h>
+
+#include "jitter_buffer.h"
+#include "logging.h"
+
+struct jitter_buffer
+{
+	vc_mutex lock;
+
+	int slots;
+	void * objects[jitter_buffer_max_slots];
+	struct timeval release[jitter_buffer_max_slots];
+	int head; /* oldest frame */
+	int count;
+
+	void (*copy_object)(void *, const void *);
+
+	long target_usecs;
+	long delay_usecs;
+	double interval; /* mean arrival interval, in usecs */
+	double deviation; /* mean deviation from it */
+
+	int started;
+	struct timeval last_arrival;
+	struct timeval last_release;
+};
+
+static __inline long
+tv_diff_usecs(const struct timeval * t1, const struct timeval * t0)
+{
+	return (t1->tv_sec - t0->tv_sec) * 1000000L +
+		(t1->tv_usec - t0->tv_usec);
+}
+
+static __inline struct timeval
+tv_plus_usecs(const struct timeval * tv, long usecs)
+{
+	struct timeval sum;
+
+	sum.tv_sec = tv->tv_sec + usecs / 1000000;
+	sum.tv_usec = tv->tv_usec + usecs % 1000000;
+
+	if ( sum.tv_usec >= 1000000 )
+	{
+		sum.tv_usec -= 1000000;
+		++sum.tv_sec;
+	}
+	else if ( sum.tv_usec < 0 )
+	{
+		sum.tv_usec += 1000000;
+		--sum.tv_sec;
+	}
+
+	return sum;
+}
+
+struct jitter_buffer *
+jitter_buffer_create(int slots, void * objects[],
+		void (*copy_object)(void *, const void *),
+		int fps_numerator, int fps_denominator, long delay_usecs)
+{
+	struct jitter_buffer * jb;
+	int i;
+
+	if ( slots < 2 || slots > jitter_buffer_max_slots )
+	{
+		log_error("invalid number of jitter buffer slots %d\n", slots);
+		return 0;
+	}
+
+	if ( !(jb = calloc(1, sizeof(*jb))) )
+	{
+		log_oom(__FILE__, __LINE__);
+		return 0;
+	}
+
+	if ( vc_mutex_init(&jb->lock) )
+	{
+		log_error("failed to initialize jitter buffer lock\n");
+		free(jb);
+		return 0;
+	}
+
+	jb->slots = slots;
+
+	for ( i = 0; i < slots; ++i )
+		jb->objects[i] = objects[i];
+
+	jb->copy_object = copy_object;
+	jb->target_usecs = delay_usecs;
+	jb->delay_usecs = delay_usecs;
+	jb->interval = 1000000.0 * fps_denominator / fps_numerator;
+
+	return jb;
+}
+
+void
+jitter_buffer_destroy(struct jitter_buffer * jb)
+{
+	vc_mutex_destroy(&jb->lock);
+	free(jb);
+}
+
+/* Follows arrivals to keep releases evenly spaced: the mean interval
+ * sets the spacing while the delay sets the margin for late frames.
+ */
+static void
+jitter_buffer_adapt(struct jitter_buffer * jb, const struct timeval * arrival)
+{
+	double interval = tv_diff_usecs(arrival, &jb->last_arrival);
+	double deviation;
+	long limit;
+
+	/* A stall says nothing about the usual spacing */
+	if ( interval > 4.0 * jb->interval )
+		interval = 4.0 * jb->interval;
+
+	deviation = interval > jb->interval ?
+		interval - jb->interval : jb->interval - interval;
+
+	jb->deviation += (deviation - jb->deviation) / 16.0;
+	jb->interval += (interval - jb->interval) / 16.0;
+
+	jb->delay_usecs = (long)(2.0 * jb->deviation);
+
+	if ( jb->delay_usecs < jb->target_usecs )
+		jb->delay_usecs = jb->target_usecs;
+
+	/* Frames held longer would overflow the slots */
+	limit = (long)((jb->slots - 1) * jb->interval);
+
+	if ( jb->delay_usecs > limit )
+		jb->delay_usecs = limit;
+}
+
+int
+jitter_buffer_write(struct jitter_buffer * jb, const void * object,
+		const struct timeval * arrival)
+{
+	struct timeval release;
+	int flags = 0;
+	int slot;
+
+	vc_mutex_lock(&jb->lock);
+
+	if ( jb->started )
+	{
+		struct timeval even, target;
+
+		jitter_buffer_adapt(jb, arrival);
+
+		even = tv_plus_usecs(&jb->last_release, (long)jb->interval);
+		target = tv_plus_usecs(arrival, jb->delay_usecs);
+
+		release = tv_plus_usecs(&even,
+				tv_diff_usecs(&target, &even) / 16);
+
+		if ( tv_diff_usecs(&release, &jb->last_release) < 0 )
+			release = jb->last_release;
+
+		if ( tv_diff_usecs(&release, arrival) < 0 )
+		{
+			release = *arrival;
+			flags |= jitter_buffer_late;
+		}
+	}
+	else
+	{
+		release = tv_plus_usecs(arrival, jb->delay_usecs);
+		jb->started = 1;
+	}
+
+	jb->last_arrival = *arrival;
+	jb->last_release = release;
+
+	if ( jb->count == jb->slots )
+	{
+		jb->head = (jb->head + 1) % jb->slots;
+		--jb->count;
+		flags |= jitter_buffer_overflow;
+	}
+
+	slot = (jb->head + jb->count) % jb->slots;
+	jb->copy_object(jb->objects[slot], object);
+	jb->release[slot] = release;
+	++jb->count;
+
+	vc_mutex_unlock(&jb->lock);
+
+	return flags;
+}
+
+int
+jitter_buffer_read(struct jitter_buffer * jb, void * object,
+		const struct timeval * now, long * wait_usecs)
+{
+	vc_mutex_lock(&jb->lock);
+
+	if ( !jb->count )
+	{
+		*wait_usecs = -1;
+		vc_mutex_unlock(&jb->lock);
+		return -1;
+	}
+
+	*wait_usecs = tv_diff_usecs(&jb->release[jb->head], now);
+
+	if ( *wait_usecs > 0 )
+	{
+		vc_mutex_unlock(&jb->lock);
+		return -1;
+	}
+
+	*wait_usecs = 0;
+	jb->copy_object(object, jb->objects[jb->head]);
+	jb->head = (jb->head + 1) % jb->slots;
+	--jb->count;
+
+	vc_mutex_unlock(&jb->lock);
+
+	return 0;
+}
+
+void
+jitter_buffer_state_get(struct jitter_buffer * jb, int * count,
+		long * delay_usecs)
+{
+	vc_mutex_lock(&jb->lock);
+	*count = jb->count;
+	*delay_usecs = jb->delay_usecs;
+	vc_mutex_unlock(&jb->lock);
+}
@@ -0,0 +1,124 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _JITTER_BUFFER_H
+#define _JITTER_BUFFER_H
+
+/** \file jitter_buffer.h
+ *  \ingroup Core
+ *  \brief Frames held back and released at an even pace.
+ */
+
+#include "os_funcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+	jitter_buffer_max_slots = 16,
+
+	/* Outcomes of jitter_buffer_write() */
+	jitter_buffer_late = 1,     /* arrived after its release time */
+	jitter_buffer_overflow = 2, /* the oldest frame made room for it */
+};
+
+struct jitter_buffer;
+
+/**
+ *  \brief Create a jitter buffer
+ *
+ *  \param [in] slots           Number of objects, up to
+ *                              jitter_buffer_max_slots
+ *  \param [in] objects         Objects in which frames are held
+ *  \param [in] copy_object     Copies a frame into or out of an object
+ *  \param [in] fps_numerator   Expected frame rate numerator
+ *  \param [in] fps_denominator Expected frame rate denominator
+ *  \param [in] delay_usecs     Least delay between the arrival and the
+ *                              release of a frame
+ *  \return The jitter buffer, or 0 on failure
+ */
+struct jitter_buffer *
+jitter_buffer_create(int slots, void * objects[],
+		void (*copy_object)(void *, const void *),
+		int fps_numerator, int fps_denominator, long delay_usecs);
+
+/**
+ *  \brief Destroy a jitter buffer
+ *
+ *  \param [in] jb Jitter buffer
+ */
+void
+jitter_buffer_destroy(struct jitter_buffer * jb);
+
+/**
+ *  \brief Hold a frame and schedule its release
+ *
+ *  \param [in] jb      Jitter buffer
+ *  \param [in] object  Frame to copy in
+ *  \param [in] arrival Monotonic arrival time of the frame
+ *  \return Zero, or jitter_buffer_late and jitter_buffer_overflow flags
+ *
+ *  \details Releases follow each other at the mean arrival interval,
+ *           drawn slowly toward the arrival times plus the delay. The
+ *           delay grows beyond the one asked for to twice the
+ *           mean deviation of arrival intervals, within what the slots
+ *           can hold.
+ */
+int
+jitter_buffer_write(struct jitter_buffer * jb, const void * object,
+		const struct timeval * arrival);
+
+/**
+ *  \brief Take the oldest frame if it is due
+ *
+ *  \param [in]  jb         Jitter buffer
+ *  \param [out] object     Object to copy the frame out to
+ *  \param [in]  now        Current monotonic time
+ *  \param [out] wait_usecs Time until the oldest frame is due, -1 when
+ *                          there is none
+ *  \return Zero if a frame was taken, -1 otherwise
+ */
+int
+jitter_buffer_read(struct jitter_buffer * jb, void * object,
+		const struct timeval * now, long * wait_usecs);
+
+/**
+ *  \brief Get the number of frames held and the current delay
+ *
+ *  \param [in]  jb          Jitter buffer
+ *  \param [out] count       Frames held
+ *  \param [out] delay_usecs Current delay
+ */
+void
+jitter_buffer_state_get(struct jitter_buffer * jb, int * count,
+		long * delay_usecs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file motion.c
+ *  \ingroup Core
+ *  \brief Motion detection on a reduced luma plane.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "conv.h"
+#include "logging.h"
+#include "motion.h"
+
+enum
+{
+	/* The luma plane is averaged over squares of motion_scale pixels
+	 * and compared in blocks of motion_block reduced pixels.
+	 */
+	motion_scale = 4,
+	motion_block = 8,
+};
+
+struct motion
+{
+	int step;
+	int offset;
+	int width;
+	int small_width;
+	int small_height;
+
+	unsigned short * column_sums;
+	unsigned char * current;
+	unsigned char * reference;
+	int has_reference;
+
+	unsigned char * blocks;
+	struct vidcap_motion info;
+};
+
+/* Where luma, or green as a stand-in for it, lies in the rows of a
+ * fourcc. Frames stored bottom up are left out since their blocks
+ * would be reported upside down.
+ */
+static int
+motion_layout_get(int fourcc, int * step, int * offset)
+{
+	const unsigned int green = 0xff00;
+
+	if ( !conv_fmt_luma_layout_get(fourcc, step, offset) )
+		return 0;
+
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_RGB32:
+		/* a native-endian word */
+		*step = 4;
+		*offset = ((const unsigned char *)&green)[1] ? 1 : 2;
+		return 0;
+	case VIDCAP_FOURCC_BGRA:
+	case VIDCAP_FOURCC_RGBA:
+		*step = 4;
+		*offset = 1;
+		return 0;
+	case VIDCAP_FOURCC_ARGB:
+		*step = 4;
+		*offset = 2;
+		return 0;
+	case VIDCAP_FOURCC_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BGR24:
+		*step = 3;
+		*offset = 1;
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+struct motion *
+motion_create(int fourcc, int width, int height)
+{
+	struct motion * m;
+	int step, offset;
+
+	if ( motion_layout_get(fourcc, &step, &offset) ||
+			width < motion_scale || height < motion_scale )
+	{
+		log_error("cannot detect motion in %dx%d %s\n", width, height,
+				vidcap_fourcc_string_get(fourcc));
+		return 0;
+	}
+
+	if ( !(m = calloc(1, sizeof(*m))) )
+	{
+		log_oom(__FILE__, __LINE__);
+		return 0;
+	}
+
+	m->step = step;
+	m->offset = offset;
+	m->width = width;
+	m->small_width = width / motion_scale;
+	m->small_height = height / motion_scale;
+
+	m->info.block_width = motion_block * motion_scale;
+	m->info.block_height = motion_block * motion_scale;
+	m->info.columns = (m->small_width + motion_block - 1) / motion_block;
+	m->info.rows = (m->small_height + motion_block - 1) / motion_block;
+
+	if ( !(m->column_sums = malloc(m->small_width * motion_scale *
+					sizeof(*m->column_sums))) ||
+			!(m->current = malloc(m->small_width *
+					m->small_height)) ||
+			!(m->reference = malloc(m->small_width *
+					m->small_height)) ||
+			!(m->blocks = malloc(m->info.columns * m->info.rows)) )
+	{
+		log_oom(__FILE__, __LINE__);
+		motion_destroy(m);
+		return 0;
+	}
+
+	m->info.blocks = m->blocks;
+
+	return m;
+}
+
+void
+motion_destroy(struct motion * m)
+{
+	free(m->column_sums);
+	free(m->current);
+	free(m->reference);
+	free(m->blocks);
+	free(m);
+}
+
+/* Average the luma of each square into the current reduced plane. The
+ * rows of a square are first summed per column, which the compiler
+ * can vectorize, then each run of columns is summed.
+ */
+static void
+motion_reduce(struct motion * m, const unsigned char * frame)
+{
+	const int row_bytes = m->width * m->step;
+	const int columns = m->small_width * motion_scale;
+	int x, y, r, i;
+
+	for ( y = 0; y < m->small_height; ++y )
+	{
+		const unsigned char * rows =
+			frame + y * motion_scale * row_bytes + m->offset;
+		unsigned char * out = m->current + y * m->small_width;
+
+		memset(m->column_sums, 0, columns * sizeof(*m->column_sums));
+
+		for ( r = 0; r < motion_scale; ++r )
+		{
+			const unsigned char * row = rows + r * row_bytes;
+
+			if ( m->step == 1 )
+				for ( x = 0; x < columns; ++x )
+					m->column_sums[x] += row[x];
+			else
+				for ( x = 0; x < columns; ++x )
+					m->column_sums[x] += row[x * m->step];
+		}
+
+		for ( x = 0; x < m->small_width; ++x )
+		{
+			const unsigned short * sums =
+				m->column_sums + x * motion_scale;
+			int sum = motion_scale * motion_scale / 2;
+
+			for ( i = 0; i < motion_scale; ++i )
+				sum += sums[i];
+
+			out[x] = (unsigned char)(sum /
+					(motion_scale * motion_scale));
+		}
+	}
+}
+
+/* Sum of absolute differences with the reference over one block,
+ * against the threshold scaled to the block's size. Blocks on the
+ * right and bottom edges may be partial.
+ */
+static int
+block_changed(const struct motion * m, int bx, int by, int threshold)
+{
+	const int x0 = bx * motion_block;
+	const int y0 = by * motion_block;
+	const int x1 = x0 + motion_block < m->small_width ?
+		x0 + motion_block : m->small_width;
+	const int y1 = y0 + motion_block < m->small_height ?
+		y0 + motion_block : m->small_height;
+	int sad = 0;
+	int x, y;
+
+	for ( y = y0; y < y1; ++y )
+	{
+		const unsigned char * cur = m->current + y * m->small_width;
+		const unsigned char * ref = m->reference + y * m->small_width;
+
+		for ( x = x0; x < x1; ++x )
+			sad += abs(cur[x] - ref[x]);
+	}
+
+	return sad > threshold * (x1 - x0) * (y1 - y0);
+}
+
+int
+motion_detect(struct motion * m, const char * frame, int threshold,
+		int min_blocks)
+{
+	const int blocks = m->info.columns * m->info.rows;
+	int bx, by;
+
+	motion_reduce(m, (const unsigned char *)frame);
+
+	if ( !m->has_reference )
+	{
+		memset(m->blocks, 1, blocks);
+		m->info.moving_blocks = blocks;
+		return 1;
+	}
+
+	m->info.moving_blocks = 0;
+
+	for ( by = 0; by < m->info.rows; ++by )
+	{
+		for ( bx = 0; bx < m->info.columns; ++bx )
+		{
+			const int changed = block_changed(m, bx, by, threshold);
+
+			m->blocks[by * m->info.columns + bx] =
+				(unsigned char)changed;
+			m->info.moving_blocks += changed;
+		}
+	}
+
+	return m->info.moving_blocks >= (min_blocks > 0 ? min_blocks : 1);
+}
+
+void
+motion_reference_set(struct motion * m)
+{
+	unsigned char * reference = m->reference;
+
+	m->reference = m->current;
+	m->current = reference;
+	m->has_reference = 1;
+}
+
+const struct vidcap_motion *
+motion_info_get(const struct motion * m)
+{
+	return &m->info;
+}
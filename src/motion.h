@@ -0,0 +1,99 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _MOTION_H
+#define _MOTION_H
+
+/** \file motion.h
+ *  \ingroup Core
+ *  \brief Motion detection on a reduced luma plane.
+ */
+
+#include <vidcap/vidcap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct motion;
+
+/**
+ *  \brief Create a motion detector for frames of one format
+ *
+ *  \param [in] fourcc Fourcc of the frames
+ *  \param [in] width  Width of the frames
+ *  \param [in] height Height of the frames
+ *  \return The detector or 0 on failure
+ */
+struct motion *
+motion_create(int fourcc, int width, int height);
+
+/**
+ *  \brief Release a motion detector
+ *
+ *  \param [in] m Detector to release
+ */
+void
+motion_destroy(struct motion * m);
+
+/**
+ *  \brief Compare a frame with the reference frame
+ *
+ *  \param [in] m          Detector
+ *  \param [in] frame      Tightly packed frame
+ *  \param [in] threshold  Mean absolute luma difference above which a
+ *                         block has changed
+ *  \param [in] min_blocks Changed blocks making the frame one with
+ *                         motion
+ *  \return 1 if the frame has motion or there is no reference yet,
+ *          0 otherwise
+ */
+int
+motion_detect(struct motion * m, const char * frame, int threshold,
+		int min_blocks);
+
+/**
+ *  \brief Make the frame last given to motion_detect() the reference
+ *
+ *  \param [in] m Detector
+ */
+void
+motion_reference_set(struct motion * m);
+
+/**
+ *  \brief Get the blocks changed in the frame last given to
+ *         motion_detect()
+ *
+ *  \param [in] m Detector
+ *  \return The changed blocks, valid until the next detection
+ */
+const struct vidcap_motion *
+motion_info_get(const struct motion * m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
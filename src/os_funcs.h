@@ -38,7 +38,8 @@
 #include "config.h"
 #endif
 
-#if defined(HAVE_NANOSLEEP) || defined(HAVE_GETTIMEOFDAY)
+#if defined(HAVE_NANOSLEEP) || defined(HAVE_GETTIMEOFDAY) || \
+	defined(HAVE_CLOCK_GETTIME)
 #include <sys/time.h>
 #include <time.h>
 #endif
@@ -122,6 +123,40 @@ vc_now(void)
 	return tv;
 }
 
+/**
+ *  \brief Time that only moves forward at a steady rate
+ *  
+ *  \return Time since an arbitrary origin
+ *  
+ *  \details Unlike vc_now(), changes to the wall clock do not affect
+ *           it, which suits measuring intervals. Falls back to vc_now()
+ *           where no monotonic clock is available.
+ */
+static __inline struct timeval
+vc_now_monotonic(void)
+{
+	struct timeval tv;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	tv.tv_sec  = (long)ts.tv_sec;
+	tv.tv_usec = (long)(ts.tv_nsec / 1000);
+#elif defined(WIN32)
+	LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	tv.tv_sec  = (long)(count.QuadPart / freq.QuadPart);
+	tv.tv_usec = (long)(count.QuadPart % freq.QuadPart * 1000000 /
+			freq.QuadPart);
+#else
+	tv = vc_now();
+#endif
+	return tv;
+}
+
 /**
  *  \brief vc_create_thread
  *  
@@ -0,0 +1,388 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file pyramid.c
+ *  \ingroup Core
+ *  \brief Successive half-size copies of delivered frames.
+ */
+
+#include <stdlib.h>
+
+#include "conv.h"
+#include "cpu.h"
+#include "logging.h"
+#include "pyramid.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+enum
+{
+	pyramid_max_levels = 8,
+	pyramid_max_planes = 3,
+
+	/* Pixels whose bytes are all averaged independently use their
+	 * size as kind. 4:2:2 shares chroma between pixel pairs, and
+	 * puts luma first (yuy2) or second (2vuy) in each byte pair.
+	 */
+	pyramid_kind_422 = 0,
+	pyramid_kind_422_chroma_first = -1,
+};
+
+typedef void (*halve_row_func)(unsigned char * dst,
+		const unsigned char * a, const unsigned char * b,
+		int dst_width, int kind);
+
+struct pyramid_plane
+{
+	int kind;
+	int width;
+	int height;
+	int offset_num; /* offset within a level, in level pixels ... */
+	int offset_den; /* ... times num / den */
+};
+
+struct pyramid
+{
+	int fourcc;
+	int levels;
+	int num_planes;
+	struct pyramid_plane planes[pyramid_max_planes];
+
+	char * bufs[pyramid_max_levels];
+	struct vidcap_image images[pyramid_max_levels];
+
+	halve_row_func halve_row;
+};
+
+static void
+halve_row_c(unsigned char * dst, const unsigned char * a,
+		const unsigned char * b, int dst_width, int kind)
+{
+	int i, c;
+
+	if ( kind <= pyramid_kind_422 )
+	{
+		const int y = kind == pyramid_kind_422 ? 0 : 1;
+		const int u = 1 - y;
+		const int v = 3 - y;
+
+		/* Two macropixels (Y0 U Y1 V, or U Y0 V Y1) make one */
+		for ( i = 0; i < dst_width / 2; ++i, a += 8, b += 8, dst += 4 )
+		{
+			dst[y] = (unsigned char)
+				((a[y] + a[y + 2] + b[y] + b[y + 2] + 2) >> 2);
+			dst[u] = (unsigned char)
+				((a[u] + a[u + 4] + b[u] + b[u + 4] + 2) >> 2);
+			dst[y + 2] = (unsigned char)
+				((a[y + 4] + a[y + 6] + b[y + 4] + b[y + 6] +
+				  2) >> 2);
+			dst[v] = (unsigned char)
+				((a[v] + a[v + 4] + b[v] + b[v + 4] + 2) >> 2);
+		}
+		return;
+	}
+
+	for ( i = 0; i < dst_width; ++i, a += 2 * kind, b += 2 * kind )
+		for ( c = 0; c < kind; ++c )
+			*dst++ = (unsigned char)((a[c] + a[c + kind] +
+					b[c] + b[c + kind] + 2) >> 2);
+}
+
+#ifdef CPU_X86
+CPU_TARGET("sse2") static void
+halve_row_sse2(unsigned char * dst, const unsigned char * a,
+		const unsigned char * b, int dst_width, int kind)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low_bytes = _mm_set1_epi16(0xff);
+	const __m128i round = _mm_set1_epi16(2);
+	int i = 0;
+
+	if ( kind == 1 )
+	{
+		for ( ; i + 16 <= dst_width; i += 16 )
+		{
+			__m128i s[2];
+			int h;
+
+			for ( h = 0; h < 2; ++h )
+			{
+				const __m128i va = _mm_loadu_si128(
+					(const __m128i *)(a + 2 * i + 16 * h));
+				const __m128i vb = _mm_loadu_si128(
+					(const __m128i *)(b + 2 * i + 16 * h));
+
+				s[h] = _mm_add_epi16(
+					_mm_add_epi16(_mm_and_si128(va, low_bytes),
+						_mm_srli_epi16(va, 8)),
+					_mm_add_epi16(_mm_and_si128(vb, low_bytes),
+						_mm_srli_epi16(vb, 8)));
+				s[h] = _mm_srli_epi16(_mm_add_epi16(s[h], round), 2);
+			}
+
+			_mm_storeu_si128((__m128i *)(dst + i),
+					_mm_packus_epi16(s[0], s[1]));
+		}
+	}
+	else if ( kind == 4 )
+	{
+		for ( ; i + 4 <= dst_width; i += 4 )
+		{
+			__m128i s[2];
+			int h;
+
+			/* Sum horizontal pixel pairs in the low half of each
+			 * 16-bit lane group, then gather two pairs together.
+			 */
+			for ( h = 0; h < 2; ++h )
+			{
+				const __m128i va = _mm_loadu_si128(
+					(const __m128i *)(a + 8 * i + 16 * h));
+				const __m128i vb = _mm_loadu_si128(
+					(const __m128i *)(b + 8 * i + 16 * h));
+				const __m128i lo = _mm_add_epi16(
+						_mm_unpacklo_epi8(va, zero),
+						_mm_unpacklo_epi8(vb, zero));
+				const __m128i hi = _mm_add_epi16(
+						_mm_unpackhi_epi8(va, zero),
+						_mm_unpackhi_epi8(vb, zero));
+
+				s[h] = _mm_unpacklo_epi64(
+					_mm_add_epi16(lo, _mm_srli_si128(lo, 8)),
+					_mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+				s[h] = _mm_srli_epi16(_mm_add_epi16(s[h], round), 2);
+			}
+
+			_mm_storeu_si128((__m128i *)(dst + 4 * i),
+					_mm_packus_epi16(s[0], s[1]));
+		}
+	}
+
+	halve_row_c(dst + i * kind, a + 2 * i * kind, b + 2 * i * kind,
+			dst_width - i, kind);
+}
+#endif
+
+/* Planes of the fourccs that can be halved, at full size */
+static int
+pyramid_planes_init(int fourcc, int width, int height,
+		struct pyramid_plane * planes)
+{
+	struct pyramid_plane * plane = planes;
+
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_I420:
+		plane[0].kind = plane[1].kind = plane[2].kind = 1;
+		plane[0].width = width;
+		plane[0].height = height;
+		plane[0].offset_num = 0;
+		plane[0].offset_den = 1;
+		plane[1].width = plane[2].width = width / 2;
+		plane[1].height = plane[2].height = height / 2;
+		plane[1].offset_num = 1;
+		plane[1].offset_den = 1;
+		plane[2].offset_num = 5;
+		plane[2].offset_den = 4;
+		return 3;
+	case VIDCAP_FOURCC_YUY2:
+		plane->kind = pyramid_kind_422;
+		break;
+	case VIDCAP_FOURCC_2VUY:
+		plane->kind = pyramid_kind_422_chroma_first;
+		break;
+	case VIDCAP_FOURCC_GREY:
+		plane->kind = 1;
+		break;
+	case VIDCAP_FOURCC_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BGR24:
+		plane->kind = 3;
+		break;
+	case VIDCAP_FOURCC_RGB32:
+	case VIDCAP_FOURCC_BGRA:
+	case VIDCAP_FOURCC_RGBA:
+	case VIDCAP_FOURCC_ARGB:
+		plane->kind = 4;
+		break;
+	default:
+		return 0;
+	}
+
+	plane->width = width;
+	plane->height = height;
+	plane->offset_num = 0;
+	plane->offset_den = 1;
+	return 1;
+}
+
+int
+pyramid_supported(int fourcc, int width, int height, int levels)
+{
+	struct pyramid_plane planes[pyramid_max_planes];
+	int x_align = 1;
+	int y_align = 1;
+
+	if ( levels < 1 || levels > pyramid_max_levels )
+		return 0;
+
+	if ( !pyramid_planes_init(fourcc, width, height, planes) ||
+			conv_fmt_align_get(fourcc, &x_align, &y_align) )
+		return 0;
+
+	/* Every level must halve exactly and remain a valid frame */
+	x_align <<= levels;
+	y_align <<= levels;
+
+	return width % x_align == 0 && height % y_align == 0;
+}
+
+struct pyramid *
+pyramid_create(int fourcc, int width, int height, int levels)
+{
+	struct pyramid * pyr;
+	int l;
+
+	if ( !pyramid_supported(fourcc, width, height, levels) )
+	{
+		log_error("cannot halve %dx%d %s %d times\n",
+				width, height,
+				vidcap_fourcc_string_get(fourcc), levels);
+		return 0;
+	}
+
+	if ( !(pyr = calloc(1, sizeof(*pyr))) )
+	{
+		log_oom(__FILE__, __LINE__);
+		return 0;
+	}
+
+	pyr->fourcc = fourcc;
+	pyr->levels = levels;
+	pyr->num_planes = pyramid_planes_init(fourcc, width, height,
+			pyr->planes);
+
+	for ( l = 0; l < levels; ++l )
+	{
+		struct vidcap_image * image = &pyr->images[l];
+
+		image->width = width >> (l + 1);
+		image->height = height >> (l + 1);
+		image->fourcc = fourcc;
+		image->video_data_size = conv_fmt_size_get(image->width,
+				image->height, fourcc);
+
+		if ( !(pyr->bufs[l] = malloc(image->video_data_size)) )
+		{
+			log_oom(__FILE__, __LINE__);
+			pyramid_destroy(pyr);
+			return 0;
+		}
+
+		image->video_data = pyr->bufs[l];
+	}
+
+	pyr->halve_row = halve_row_c;
+
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+		pyr->halve_row = halve_row_sse2;
+#endif
+
+	return pyr;
+}
+
+void
+pyramid_destroy(struct pyramid * pyr)
+{
+	int l;
+
+	for ( l = 0; l < pyramid_max_levels; ++l )
+		free(pyr->bufs[l]);
+
+	free(pyr);
+}
+
+static __inline int
+row_bytes(const struct pyramid_plane * plane, int level)
+{
+	const int width = plane->width >> level;
+
+	return plane->kind <= pyramid_kind_422 ? 2 * width :
+		plane->kind * width;
+}
+
+static __inline unsigned char *
+plane_row(const struct pyramid * pyr, const struct pyramid_plane * plane,
+		const char * frame, int level, int row)
+{
+	const char * base = level ? pyr->bufs[level - 1] : frame;
+	const int level_pixels = (pyr->planes[0].width >> level) *
+		(pyr->planes[0].height >> level);
+
+	return (unsigned char *)base +
+		level_pixels * plane->offset_num / plane->offset_den +
+		row * row_bytes(plane, level);
+}
+
+/* Produce one row of a level, then any row of the next level that the
+ * new row completes.
+ */
+static void
+cascade_row(const struct pyramid * pyr, const struct pyramid_plane * plane,
+		const char * frame, int level, int row)
+{
+	pyr->halve_row(plane_row(pyr, plane, frame, level, row),
+			plane_row(pyr, plane, frame, level - 1, 2 * row),
+			plane_row(pyr, plane, frame, level - 1, 2 * row + 1),
+			plane->width >> level, plane->kind);
+
+	if ( level < pyr->levels && (row & 1) )
+		cascade_row(pyr, plane, frame, level + 1, row / 2);
+}
+
+int
+pyramid_build(struct pyramid * pyr, const char * frame)
+{
+	int p, y;
+
+	for ( p = 0; p < pyr->num_planes; ++p )
+	{
+		const struct pyramid_plane * plane = &pyr->planes[p];
+
+		for ( y = 0; y < plane->height / 2; ++y )
+			cascade_row(pyr, plane, frame, 1, y);
+	}
+
+	return 0;
+}
+
+const struct vidcap_image *
+pyramid_images_get(const struct pyramid * pyr)
+{
+	return pyr->images;
+}
@@ -0,0 +1,101 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PYRAMID_H
+#define _PYRAMID_H
+
+/** \file pyramid.h
+ *  \ingroup Core
+ *  \brief Successive half-size copies of delivered frames.
+ */
+
+#include <vidcap/vidcap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct pyramid;
+
+/**
+ *  \brief Tells whether a frame can be halved a number of times
+ *
+ *  \param [in] fourcc Fourcc of the frames
+ *  \param [in] width  Width of the full-size frames
+ *  \param [in] height Height of the full-size frames
+ *  \param [in] levels Number of half-size levels
+ *  \return 1 if every level is a whole, valid frame, 0 otherwise
+ */
+int
+pyramid_supported(int fourcc, int width, int height, int levels);
+
+/**
+ *  \brief Create a pyramid for frames of one format
+ *
+ *  \param [in] fourcc Fourcc of the frames
+ *  \param [in] width  Width of the full-size frames
+ *  \param [in] height Height of the full-size frames
+ *  \param [in] levels Number of half-size levels
+ *  \return The pyramid or 0 on failure
+ */
+struct pyramid *
+pyramid_create(int fourcc, int width, int height, int levels);
+
+/**
+ *  \brief Release a pyramid
+ *
+ *  \param [in] pyr Pyramid to release
+ */
+void
+pyramid_destroy(struct pyramid * pyr);
+
+/**
+ *  \brief Fill every level from one full-size frame
+ *
+ *  \param [in] pyr   Pyramid
+ *  \param [in] frame Tightly packed full-size frame
+ *  \return Returns 0 on success
+ *
+ *  \details Each pair of rows is consumed as soon as it is produced, so
+ *           the frame is read once and every level is built from rows
+ *           that are still in cache.
+ */
+int
+pyramid_build(struct pyramid * pyr, const char * frame);
+
+/**
+ *  \brief Get the levels of a pyramid, largest first
+ *
+ *  \param [in] pyr Pyramid
+ *  \return Array of as many images as there are levels
+ */
+const struct vidcap_image *
+pyramid_images_get(const struct pyramid * pyr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
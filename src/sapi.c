@@ -34,6 +34,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "frame_hash.h"
+#include "frame_stats.h"
 #include "hotlist.h"
 #include "logging.h"
 #include "sapi.h"
@@ -65,55 +67,17 @@ tv_add_usecs(struct timeval *t1, struct timeval *t0, long usecs)
 	t1->tv_sec = t0->tv_sec + secs_carried;
 }
 
-static int
-enforce_framerate(struct sapi_src_context * src_ctx)
+/* Frames only need dropping when the device runs faster than the
+ * nominal rate, or may do so because it did not confirm its rate
+ */
+static __inline int
+decimation_needed(const struct sapi_src_context * src_ctx)
 {
-	struct timeval  tv_earliest_next;
-	struct timeval  tv_now;
-	struct timeval *tv_oldest = 0;
-	int first_time = 0;
-
-	if ( !src_ctx->frame_times )
-		return 0;
-
-	first_time = !sliding_window_count(src_ctx->frame_times);
-
-	tv_now = vc_now();
-
-	if ( !first_time && !tv_greater_or_equal(
-				&tv_now, &src_ctx->frame_time_next) )
-		return 0;
-
-	/* Allow frame through */
-
-	tv_oldest = sliding_window_peek_front(src_ctx->frame_times);
-
-	if ( !tv_oldest )
-		tv_oldest = &tv_now;
-
-	/* calculate next frame time based on sliding window */
-	tv_add_usecs(&src_ctx->frame_time_next, tv_oldest,
-			sliding_window_count(src_ctx->frame_times) *
-			1000000 *
-			src_ctx->fmt_nominal.fps_denominator /
-			src_ctx->fmt_nominal.fps_numerator);
-
-	/* calculate the earliest allowable next frame time
-	 * based on: now + arbitrary minimum spacing
-	 */
-	tv_add_usecs(&tv_earliest_next, &tv_now, 900000 *
-			src_ctx->fmt_nominal.fps_denominator /
-			src_ctx->fmt_nominal.fps_numerator);
-
-	/* if earliest allowable > next, next = earliest */
-	/* if there's been a stall, pace ourselves       */
-	if ( tv_greater_or_equal(&tv_earliest_next,
-				&src_ctx->frame_time_next) )
-		src_ctx->frame_time_next = tv_earliest_next;
-
-	sliding_window_slide(src_ctx->frame_times, &tv_now);
-
-	return 1;
+	return !src_ctx->fps_granted ||
+		src_ctx->fmt_native.fps_numerator *
+		src_ctx->fmt_nominal.fps_denominator >
+		src_ctx->fmt_nominal.fps_numerator *
+		src_ctx->fmt_native.fps_denominator;
 }
 
 int
@@ -212,6 +176,76 @@ acknowledge_error(struct sapi_src_context * src_ctx)
 	src_ctx->capture_error_ack = 1;
 }
 
+/* Regions are cropped from the unconverted frame so that only their
+ * pixels go through the (more expensive) format conversion.
+ */
+static int
+convert_rois(struct sapi_src_context * src_ctx, const char * buf)
+{
+	int i;
+
+	for ( i = 0; i < src_ctx->roi_count; ++i )
+	{
+		const struct sapi_roi * roi = &src_ctx->rois[i];
+		char * crop_buf = roi->conv_func ? roi->crop_buf : roi->buf;
+
+		if ( conv_crop(src_ctx->fmt_native.width,
+					src_ctx->fmt_native.height,
+					src_ctx->fmt_native.fourcc,
+					roi->roi.x, roi->roi.y,
+					roi->roi.width, roi->roi.height,
+					buf, crop_buf) )
+			return -1;
+
+		if ( roi->conv_func && roi->conv_func(&src_ctx->conv_params,
+					roi->roi.width, roi->roi.height,
+					crop_buf, roi->buf) )
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Returns 1 when the frame is to be delivered: it moved, or enough
+ * still frames have passed since the last one delivered. A delivered
+ * frame becomes the reference for the next ones.
+ */
+static int
+motion_gate(struct sapi_src_context * src_ctx, const char * frame)
+{
+	if ( !motion_detect(src_ctx->motion, frame, src_ctx->motion_threshold,
+				src_ctx->motion_min_blocks) &&
+			( !src_ctx->motion_idle_interval ||
+			  ++src_ctx->motion_idle_frames <
+					src_ctx->motion_idle_interval ) )
+		return 0;
+
+	src_ctx->motion_idle_frames = 0;
+	motion_reference_set(src_ctx->motion);
+
+	return 1;
+}
+
+/* Planar yuv frames start with their luma plane, which is already a
+ * grey frame of the same size.
+ */
+static int
+grey_in_place(const struct sapi_src_context * src_ctx)
+{
+	if ( src_ctx->fmt_nominal.fourcc != VIDCAP_FOURCC_GREY )
+		return 0;
+
+	switch ( src_ctx->fmt_native.fourcc )
+	{
+	case VIDCAP_FOURCC_I420:
+	case VIDCAP_FOURCC_NV12:
+	case VIDCAP_FOURCC_YVU9:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
 static int
 deliver_frame(struct sapi_src_context * src_ctx)
 {
@@ -220,6 +254,8 @@ deliver_frame(struct sapi_src_context * src_ctx)
 	void * buf = 0;
 	int buf_data_size = 0;
 	int send_frame = 0;
+	int repeats = 1;
+	int i;
 
 	struct vidcap_capture_info cap_info;
 
@@ -228,6 +264,8 @@ deliver_frame(struct sapi_src_context * src_ctx)
 	int video_data_size;
 	int stride;
 	int error_status;
+	int conv_width = src_ctx->fmt_native.width;
+	int conv_height = src_ctx->fmt_native.height;
 
 	if ( src_ctx->use_timer_thread )
 	{
@@ -237,6 +275,10 @@ deliver_frame(struct sapi_src_context * src_ctx)
 
 		frame = &src_ctx->timer_thread_frame;
 	}
+	else if ( src_ctx->jitter_thread_started )
+	{
+		frame = &src_ctx->jitter_frame;
+	}
 	else
 	{
 		frame = &src_ctx->callback_frame;
@@ -249,25 +291,37 @@ deliver_frame(struct sapi_src_context * src_ctx)
 	cap_info.capture_time_sec  = frame->capture_time.tv_sec;
 	cap_info.capture_time_usec = frame->capture_time.tv_usec;
 
-	/** \bug right now enforce_framerate() and the capture timer
-	 *           thread's main loop BOTH use the frame_time_next field
-	 */
-	if ( src_ctx->use_timer_thread )
+	if ( src_ctx->use_timer_thread || error_status )
 	{
 		send_frame = 1;
 	}
+	else if ( src_ctx->rate_mode == VIDCAP_RATE_CONSTANT )
+	{
+		repeats = frame_rate_frame(&src_ctx->frame_rate,
+				&frame->arrival_time, &frame->capture_time);
+		send_frame = repeats > 0;
+	}
 	else
 	{
-		if ( !error_status )
-			send_frame = enforce_framerate(src_ctx);
-
-		if ( send_frame < 0 )
-			error_status = -1000;
+		send_frame = !decimation_needed(src_ctx) ||
+			frame_rate_frame(&src_ctx->frame_rate,
+					&frame->arrival_time,
+					&frame->capture_time) > 0;
 	}
 
 	cap_info.error_status = error_status;
+	cap_info.duplicate = frame->duplicate;
+
+	/* Frames nobody will see are not worth converting */
+	if ( !( send_frame || error_status ) || !cap_callback ||
+			cap_data == VIDCAP_INVALID_USER_DATA )
+		return 0;
 
+	/* Compressed payloads go straight through. There is no
+	 * conversion function bound for them either.
+	 */
 	if ( !cap_info.error_status && stride &&
+			!conv_fmt_is_compressed(src_ctx->fmt_native.fourcc) &&
 			!destridify(src_ctx->fmt_native.width,
 				src_ctx->fmt_native.height,
 				src_ctx->fmt_native.fourcc,
@@ -284,16 +338,77 @@ deliver_frame(struct sapi_src_context * src_ctx)
 		buf_data_size = video_data_size;
 	}
 
+	/* Still frames are dropped before any work is spent on them */
+	if ( !cap_info.error_status && src_ctx->motion &&
+			!motion_gate(src_ctx, buf) )
+		return 0;
+
+	cap_info.motion = !cap_info.error_status && src_ctx->motion ?
+		motion_info_get(src_ctx->motion) : 0;
+
+	if ( !cap_info.error_status && src_ctx->scaler &&
+			src_ctx->scale_before_conv )
+	{
+		scaler_scale(src_ctx->scaler, buf, src_ctx->scale_buf);
+		buf = src_ctx->scale_buf;
+		buf_data_size = src_ctx->scale_buf_size;
+		conv_width = src_ctx->fmt_nominal.width;
+		conv_height = src_ctx->fmt_nominal.height;
+	}
+
+	if ( !cap_info.error_status && src_ctx->transform &&
+			src_ctx->transform_before_conv )
+	{
+		transform_apply(src_ctx->transform,
+				src_ctx->fmt_native.fourcc,
+				conv_width, conv_height,
+				buf, src_ctx->transform_buf);
+		buf = src_ctx->transform_buf;
+		buf_data_size = src_ctx->transform_buf_size;
+
+		if ( transform_swaps_dimensions(src_ctx->transform) )
+		{
+			const int width = conv_width;
+			conv_width = conv_height;
+			conv_height = width;
+		}
+	}
+
+	cap_info.roi_count = 0;
+	cap_info.roi_images = 0;
+
 	if ( cap_info.error_status )
 	{
 		cap_info.video_data = 0;
 		cap_info.video_data_size = 0;
 	}
+	else if ( src_ctx->roi_count )
+	{
+		if ( convert_rois(src_ctx, buf) )
+		{
+			log_error("failed region of interest conversion\n");
+			cap_info.error_status = -1;
+		}
+		else
+		{
+			cap_info.roi_count = src_ctx->roi_count;
+			cap_info.roi_images = src_ctx->roi_images;
+		}
+
+		cap_info.video_data = 0;
+		cap_info.video_data_size = 0;
+	}
+	else if ( grey_in_place(src_ctx) )
+	{
+		cap_info.video_data = buf;
+		cap_info.video_data_size = conv_width * conv_height;
+	}
 	else if ( src_ctx->fmt_conv_func )
 	{
 		if ( src_ctx->fmt_conv_func(
-					src_ctx->fmt_native.width,
-					src_ctx->fmt_native.height,
+					&src_ctx->conv_params,
+					conv_width,
+					conv_height,
 					buf,
 					src_ctx->fmt_conv_buf) )
 		{
@@ -310,36 +425,151 @@ deliver_frame(struct sapi_src_context * src_ctx)
 		cap_info.video_data_size = buf_data_size;
 	}
 
+	if ( !cap_info.error_status && src_ctx->scaler &&
+			!src_ctx->scale_before_conv )
+	{
+		scaler_scale(src_ctx->scaler, cap_info.video_data,
+				src_ctx->scale_buf);
+		cap_info.video_data = src_ctx->scale_buf;
+		cap_info.video_data_size = src_ctx->scale_buf_size;
+	}
+
+	if ( !cap_info.error_status && src_ctx->transform &&
+			!src_ctx->transform_before_conv )
+	{
+		transform_apply(src_ctx->transform,
+				src_ctx->fmt_nominal.fourcc,
+				src_ctx->fmt_nominal.width,
+				src_ctx->fmt_nominal.height,
+				cap_info.video_data, src_ctx->transform_buf);
+		cap_info.video_data = src_ctx->transform_buf;
+		cap_info.video_data_size = src_ctx->transform_buf_size;
+	}
+
 	cap_info.format = src_ctx->fmt_nominal;
 
-	if ( ( send_frame || error_status ) && cap_callback &&
-			cap_data != VIDCAP_INVALID_USER_DATA )
+	if ( transform_swaps_dimensions(src_ctx->transform) )
 	{
-		/** \bug Need to check return code (and pass it back).
-		 *           Application may want capture to stop.
-		 *           Ensure we don't perform any more callbacks.
-		 */
+		cap_info.format.width = src_ctx->fmt_nominal.height;
+		cap_info.format.height = src_ctx->fmt_nominal.width;
+	}
+
+	cap_info.pyramid_count = 0;
+	cap_info.pyramid = 0;
+
+	if ( !cap_info.error_status && src_ctx->pyramid &&
+			cap_info.video_data &&
+			!pyramid_build(src_ctx->pyramid, cap_info.video_data) )
+	{
+		cap_info.pyramid_count = src_ctx->pyramid_levels;
+		cap_info.pyramid = pyramid_images_get(src_ctx->pyramid);
+	}
+
+	/* Statistics come from the native frame, which needs no
+	 * conversion to reach its luma, when it has any
+	 */
+	cap_info.stats = 0;
+
+	if ( !cap_info.error_status && src_ctx->frame_stats_enabled )
+	{
+		if ( frame_stats_supported(src_ctx->fmt_native.fourcc) )
+		{
+			frame_stats_compute(src_ctx->fmt_native.fourcc,
+					conv_width, conv_height, buf,
+					&src_ctx->frame_stats);
+			cap_info.stats = &src_ctx->frame_stats;
+		}
+		else if ( cap_info.video_data &&
+				frame_stats_supported(cap_info.format.fourcc) )
+		{
+			frame_stats_compute(cap_info.format.fourcc,
+					cap_info.format.width,
+					cap_info.format.height,
+					cap_info.video_data,
+					&src_ctx->frame_stats);
+			cap_info.stats = &src_ctx->frame_stats;
+		}
+	}
+
+	/* Further formats are converted from the frame on request,
+	 * see vidcap_src_frame_convert(). Zero marks an empty cache slot.
+	 */
+	if ( !cap_info.error_status )
+	{
+		src_ctx->frame_buf = buf;
+		src_ctx->frame_width = conv_width;
+		src_ctx->frame_height = conv_height;
+		src_ctx->frame_image.width = cap_info.format.width;
+		src_ctx->frame_image.height = cap_info.format.height;
+		src_ctx->frame_image.fourcc = cap_info.format.fourcc;
+		src_ctx->frame_image.video_data = cap_info.video_data;
+		src_ctx->frame_image.video_data_size =
+			cap_info.video_data_size;
+
+		if ( !++src_ctx->frame_count )
+			++src_ctx->frame_count;
+
+		vc_mutex_lock(&src_ctx->stats_lock);
+		src_ctx->stats.delivered += repeats;
+		vc_mutex_unlock(&src_ctx->stats_lock);
+	}
+
+	/** \bug Need to check return code (and pass it back).
+	 *           Application may want capture to stop.
+	 *           Ensure we don't perform any more callbacks.
+	 */
+	for ( i = 0; i < repeats; ++i )
+	{
+		/* At a constant rate, frames carry the time of their tick */
+		if ( !cap_info.error_status &&
+				src_ctx->rate_mode == VIDCAP_RATE_CONSTANT &&
+				!src_ctx->use_timer_thread )
+		{
+			const struct timeval tick =
+				frame_rate_tick_time(&src_ctx->frame_rate, i);
+
+			cap_info.capture_time_sec = tick.tv_sec;
+			cap_info.capture_time_usec = tick.tv_usec;
+		}
+
 		cap_callback(src_ctx, cap_data, &cap_info);
+	}
 
-		if ( src_ctx->use_timer_thread )
+	src_ctx->frame_buf = 0;
+
+	if ( src_ctx->use_timer_thread )
+	{
+		if ( error_status )
 		{
-			if ( error_status )
-			{
-				/* Let capture thread know that the app
-				 * Has received the error status.
-				 * Ensure we don't deliver any more frames.
-				 */
-				acknowledge_error(src_ctx);
-
-				/* inform calling function of error */
-				return 1;
-			}
+			/* Let capture thread know that the app
+			 * Has received the error status.
+			 * Ensure we don't deliver any more frames.
+			 */
+			acknowledge_error(src_ctx);
+
+			/* inform calling function of error */
+			return 1;
 		}
 	}
 
 	return 0;
 }
 
+/* Compares a buffer with the one received before it */
+static int
+frame_is_duplicate(struct sapi_src_context * src_ctx, const char * video_data,
+		int video_data_size)
+{
+	const unsigned int hash = frame_hash(video_data, video_data_size);
+	const int duplicate = src_ctx->last_hash_valid &&
+		hash == src_ctx->last_hash;
+
+	src_ctx->last_hash = hash;
+	src_ctx->last_hash_valid = 1;
+
+	return duplicate;
+}
+
 /** \note stride-ignorant sapis should pass a stride of zero */
 int
 sapi_src_capture_notify(struct sapi_src_context * src_ctx,
@@ -361,14 +591,66 @@ sapi_src_capture_notify(struct sapi_src_context * src_ctx,
 		return 0;
 	}
 
+	/* Frames copied for another thread must fit their buffer. The
+	 * size of compressed frames is only a guess.
+	 */
+	if ( !error_status && video_data_size > src_ctx->buffered_frame_size &&
+			(src_ctx->use_timer_thread ||
+			 src_ctx->jitter_thread_started) )
+	{
+		log_error("dropped %d byte frame, buffers hold %d\n",
+				video_data_size,
+				src_ctx->buffered_frame_size);
+		return 0;
+	}
+
+	if ( !error_status )
+	{
+		frame->duplicate = src_ctx->duplicates_mode &&
+			frame_is_duplicate(src_ctx, video_data,
+					video_data_size);
+
+		vc_mutex_lock(&src_ctx->stats_lock);
+		++src_ctx->stats.captured;
+		if ( frame->duplicate )
+			++src_ctx->stats.duplicates;
+		vc_mutex_unlock(&src_ctx->stats_lock);
+
+		/* Not even buffered for the timer thread */
+		if ( frame->duplicate &&
+				src_ctx->duplicates_mode == VIDCAP_DUPLICATES_DROP )
+			return 0;
+	}
+	else
+	{
+		frame->duplicate = 0;
+	}
+
 	/* Package the video information */
 	frame->video_data_size = video_data_size;
 	frame->error_status = error_status;
 	frame->stride = stride;
 	frame->capture_time = vc_now();
+	frame->arrival_time = vc_now_monotonic();
 	frame->video_data = video_data;
 
-	if ( src_ctx->use_timer_thread )
+	if ( src_ctx->jitter_thread_started && !error_status )
+	{
+		/* held back - for delivery by the jitter buffer thread */
+		const int flags = jitter_buffer_write(src_ctx->jitter, frame,
+				&frame->arrival_time);
+
+		vc_mutex_lock(&src_ctx->stats_lock);
+
+		if ( flags & jitter_buffer_late )
+			++src_ctx->stats.late;
+
+		if ( flags & jitter_buffer_overflow )
+			++src_ctx->stats.overflowed;
+
+		vc_mutex_unlock(&src_ctx->stats_lock);
+	}
+	else if ( src_ctx->use_timer_thread )
 	{
 		/* buffer the frame - for processing by the timer thread */
 		double_buffer_write(src_ctx->double_buff, frame);
@@ -381,6 +663,10 @@ sapi_src_capture_notify(struct sapi_src_context * src_ctx,
 	}
 	else
 	{
+		/* Errors overtake any frames still held */
+		if ( error_status )
+			sapi_src_jitter_stop(src_ctx);
+
 		/* process the frame now */
 		deliver_frame(src_ctx);
 	}
@@ -496,6 +782,47 @@ sapi_src_timer_thread_idled(struct sapi_src_context * src_ctx)
 		vc_millisleep(10);
 }
 
+unsigned int
+STDCALL sapi_src_jitter_thread_func(void * args)
+{
+	struct sapi_src_context * src_ctx = args;
+	const long max_sleep_usecs = 5000;
+
+	while ( src_ctx->jitter_running )
+	{
+		struct timeval now = vc_now_monotonic();
+		long wait_usecs;
+
+		if ( !jitter_buffer_read(src_ctx->jitter,
+					&src_ctx->jitter_frame, &now,
+					&wait_usecs) )
+		{
+			/* Rate decisions follow the even release times */
+			src_ctx->jitter_frame.arrival_time = now;
+			deliver_frame(src_ctx);
+			continue;
+		}
+
+		if ( wait_usecs < 0 || wait_usecs > max_sleep_usecs )
+			wait_usecs = max_sleep_usecs;
+
+		vc_millisleep((wait_usecs + 999) / 1000);
+	}
+
+	return 0;
+}
+
+void
+sapi_src_jitter_stop(struct sapi_src_context * src_ctx)
+{
+	if ( !src_ctx->jitter_thread_started )
+		return;
+
+	src_ctx->jitter_running = 0;
+	vc_thread_join(&src_ctx->jitter_thread);
+	src_ctx->jitter_thread_started = 0;
+}
+
 int
 sapi_can_convert_native_to_nominal(const struct vidcap_fmt_info * fmt_native,
 		const struct vidcap_fmt_info * fmt_nominal)
@@ -511,8 +838,16 @@ sapi_can_convert_native_to_nominal(const struct vidcap_fmt_info * fmt_native,
 	if ( native_fps < nominal_fps )
 		return 0;
 
-	if ( fmt_native->width != fmt_nominal->width ||
-			fmt_native->height != fmt_nominal->height )
+	/* Compressed formats can only be passed through untouched */
+	if ( conv_fmt_is_compressed(fmt_native->fourcc) ||
+			conv_fmt_is_compressed(fmt_nominal->fourcc) )
+		return fmt_native->fourcc == fmt_nominal->fourcc &&
+			fmt_native->width == fmt_nominal->width &&
+			fmt_native->height == fmt_nominal->height;
+
+	if ( ( fmt_native->width != fmt_nominal->width ||
+			fmt_native->height != fmt_nominal->height ) &&
+			!sapi_scale_fourcc_get(fmt_native, fmt_nominal) )
 		return 0;
 
 	if ( fmt_native->fourcc == fmt_nominal->fourcc )
@@ -524,3 +859,82 @@ sapi_can_convert_native_to_nominal(const struct vidcap_fmt_info * fmt_native,
 	return 0;
 }
 
+int
+sapi_scale_fourcc_get(const struct vidcap_fmt_info * fmt_native,
+		const struct vidcap_fmt_info * fmt_nominal)
+{
+	const int native_supported =
+		scaler_fourcc_supported(fmt_native->fourcc);
+	const int nominal_supported =
+		scaler_fourcc_supported(fmt_nominal->fourcc);
+
+	/* Convert the smaller of the two frames */
+	const int shrinking =
+		fmt_nominal->width * fmt_nominal->height <=
+		fmt_native->width * fmt_native->height;
+
+	if ( shrinking && native_supported )
+		return fmt_native->fourcc;
+
+	if ( nominal_supported )
+		return fmt_nominal->fourcc;
+
+	if ( native_supported )
+		return fmt_native->fourcc;
+
+	return 0;
+}
+
+
+int
+sapi_format_cost_get(const struct vidcap_fmt_info * fmt_native,
+		const struct vidcap_fmt_info * fmt_nominal)
+{
+	const int resized = fmt_native->width != fmt_nominal->width ||
+		fmt_native->height != fmt_nominal->height;
+	const int scale_fourcc = resized ?
+		sapi_scale_fourcc_get(fmt_native, fmt_nominal) : 0;
+
+	/* Every frame is read once as it arrives */
+	int cost = conv_fmt_size_get(fmt_native->width, fmt_native->height,
+			fmt_native->fourcc);
+
+	if ( resized )
+	{
+		if ( !scale_fourcc )
+			return -1;
+
+		cost += conv_fmt_size_get(fmt_native->width,
+				fmt_native->height, scale_fourcc) +
+			conv_fmt_size_get(fmt_nominal->width,
+				fmt_nominal->height, scale_fourcc);
+	}
+
+	if ( fmt_native->fourcc != fmt_nominal->fourcc )
+	{
+		/* Conversion runs at the size of the scaler's input or
+		 * output, whichever is in the native fourcc
+		 */
+		const struct vidcap_fmt_info * conv_fmt =
+			resized && scale_fourcc != fmt_native->fourcc ?
+			fmt_native : fmt_nominal;
+
+		if ( !conv_conversion_func_get(fmt_native->fourcc,
+					fmt_nominal->fourcc) )
+			return -1;
+
+		cost += conv_fmt_size_get(conv_fmt->width, conv_fmt->height,
+				fmt_native->fourcc) +
+			conv_fmt_size_get(conv_fmt->width, conv_fmt->height,
+				fmt_nominal->fourcc);
+	}
+
+	/* Enlarged frames cost little but carry no more detail than the
+	 * native frame, so they are made to lose against real ones
+	 */
+	if ( fmt_native->width * fmt_native->height <
+			fmt_nominal->width * fmt_nominal->height )
+		cost *= 2;
+
+	return cost;
+}
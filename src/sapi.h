@@ -113,6 +113,36 @@ int
 sapi_can_convert_native_to_nominal(const struct vidcap_fmt_info * fmt_native,
 		const struct vidcap_fmt_info * fmt_nominal);
 
+/**
+ *  \brief Pick the fourcc in which a native to nominal resize happens
+ *  
+ *  \param [in] fmt_native  Native format of the device
+ *  \param [in] fmt_nominal Format requested by the application
+ *  \return The fourcc to scale in, or 0 if no scaling is possible
+ *  
+ *  \details Scaling is done before conversion when shrinking and after
+ *           conversion when enlarging, so that the conversion always
+ *           runs over the smaller frame.
+ */
+int
+sapi_scale_fourcc_get(const struct vidcap_fmt_info * fmt_native,
+		const struct vidcap_fmt_info * fmt_nominal);
+
+/**
+ *  \brief Estimate the work of delivering frames in a format
+ *  
+ *  \param [in] fmt_native  Native format of the device
+ *  \param [in] fmt_nominal Format requested by the application
+ *  \return Bytes read and written per frame by destriding, scaling
+ *          and conversion, or -1 if the frames cannot be delivered
+ *  
+ *  \details Enlarging frames doubles their cost so that a native size
+ *           close to the requested one is preferred.
+ */
+int
+sapi_format_cost_get(const struct vidcap_fmt_info * fmt_native,
+		const struct vidcap_fmt_info * fmt_nominal);
+
 #ifdef __cplusplus
 }
 #endif
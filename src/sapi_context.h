@@ -36,19 +36,53 @@
 
 #include <vidcap/vidcap.h>
 #include "double_buffer.h"
-#include "sliding_window.h"
 
 #include "conv.h"
+#include "frame_rate.h"
+#include "jitter_buffer.h"
+#include "motion.h"
+#include "pyramid.h"
+#include "scaler.h"
+#include "transform.h"
 
 struct sapi_context;
 
+struct sapi_roi
+{
+	struct vidcap_roi roi;
+	conv_func conv_func;
+	char * crop_buf; /* native fourcc, only needed when converting */
+	char * buf;
+	int buf_size;
+};
+
+/* A conversion of the delivered frame made on request */
+struct sapi_frame_conv
+{
+	int fourcc;
+	conv_func conv_func; /* 0 for the native fourcc */
+	struct scaler * scaler; /* when the source scales after conversion */
+	char * buf;
+	int buf_size;
+	char * work_buf; /* between the steps after conversion */
+	int work_buf_size;
+	const char * data; /* the converted frame, in buf or work_buf */
+	unsigned int frame; /* frame_count of the frame in data */
+};
+
+enum { sapi_frame_conv_max = 4 };
+
+enum { sapi_jitter_slots = 8 };
+
 struct frame_info
 {
 	char * video_data;
 	int video_data_size;
 	int error_status;
 	int stride;
+	int duplicate;
 	struct timeval capture_time;
+	struct timeval arrival_time; /* monotonic */
 };
 
 /**
@@ -70,19 +104,67 @@ struct sapi_src_context
 	int (*stop_capture)(struct sapi_src_context *);
 
 	struct vidcap_src_info src_info;
-	struct sliding_window * frame_times;
+	int rate_mode;
+	struct frame_rate frame_rate;
 	struct timeval frame_time_next;
 	struct double_buffer * double_buff;
 
 	struct vidcap_fmt_info fmt_nominal;
 	struct vidcap_fmt_info fmt_native;
+	int fps_granted; /* the device confirmed the native frame rate */
 	conv_func fmt_conv_func;
+	struct conv_params conv_params;
+	int bit_shift;
 	char * fmt_conv_buf;
 	int fmt_conv_buf_size;
 
 	char * stride_free_buf;
 	int stride_free_buf_size;
 
+	int scale_mode;
+	struct scaler * scaler;
+	int scale_before_conv;
+	char * scale_buf;
+	int scale_buf_size;
+
+	int transform;
+	int transform_before_conv;
+	char * transform_buf;
+	int transform_buf_size;
+
+	int pyramid_levels;
+	struct pyramid * pyramid;
+
+	int frame_stats_enabled;
+	struct vidcap_frame_stats frame_stats;
+
+	int motion_threshold;
+	int motion_min_blocks;
+	int motion_idle_interval;
+	int motion_idle_frames;
+	struct motion * motion;
+
+	int duplicates_mode;
+	unsigned int last_hash;
+	int last_hash_valid;
+	vc_mutex stats_lock; /* stats are updated by capture threads */
+	struct vidcap_src_stats stats;
+
+	struct sapi_roi * rois;
+	struct vidcap_image * roi_images;
+	int roi_count;
+
+	/* Frame being delivered in native fourcc, only set during the
+	 * capture callback
+	 */
+	const char * frame_buf;
+	int frame_width;
+	int frame_height;
+	struct vidcap_image frame_image; /* as delivered, if it was */
+	unsigned int frame_count;
+	struct sapi_frame_conv frame_convs[sapi_frame_conv_max];
+	int frame_conv_count;
+
 	struct vidcap_fmt_info * fmt_list;
 	int fmt_list_len;
 
@@ -93,6 +175,7 @@ struct sapi_src_context
 
 	struct frame_info buffered_frames[2];
 	struct frame_info timer_thread_frame;
+	int buffered_frame_size; /* room for each buffered frame */
 
 	int use_timer_thread;
 	struct frame_info callback_frame;
@@ -103,6 +186,19 @@ struct sapi_src_context
 	int kill_timer_thread;
 	int capture_error_ack;
 
+	/* Frames held back by the jitter buffer are delivered by its
+	 * own thread
+	 */
+	long jitter_delay_usecs;
+	struct jitter_buffer * jitter;
+	struct frame_info jitter_frames[sapi_jitter_slots];
+	struct frame_info jitter_frame;
+	char * jitter_buf;
+	vc_thread jitter_thread;
+	unsigned int jitter_thread_id;
+	int jitter_running;
+	int jitter_thread_started;
+
 	void * priv;
 };
 
@@ -184,4 +280,24 @@ sapi_src_timer_thread_idled(struct sapi_src_context * src_ctx);
 unsigned int
 STDCALL sapi_src_timer_thread_func(void *);
 
+/**
+ *  \brief Deliver frames from the jitter buffer until stopped
+ *
+ *  \param [in] args Source context
+ *  \return Zero
+ */
+unsigned int
+STDCALL sapi_src_jitter_thread_func(void * args);
+
+/**
+ *  \brief Stop the jitter buffer thread and wait for it to exit
+ *
+ *  \param [in] src_ctx Source context
+ *
+ *  \details Frames still held are not delivered. Does nothing when
+ *           the thread is not running.
+ */
+void
+sapi_src_jitter_stop(struct sapi_src_context * src_ctx);
+
 #endif
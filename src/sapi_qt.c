@@ -107,7 +107,7 @@ map_ostype_to_fourcc(OSType pixel_format, int * fourcc)
 		*fourcc = VIDCAP_FOURCC_RGB555;
 		return 1;
 	case k24RGBPixelFormat:
-		*fourcc = VIDCAP_FOURCC_RGB24;
+		*fourcc = VIDCAP_FOURCC_RGB24_RED_FIRST;
 		return 1;
 	case kYVU9PixelFormat:
 		*fourcc = VIDCAP_FOURCC_YVU9;
@@ -141,7 +141,7 @@ map_fourcc_to_ostype(int fourcc, OSType * pixel_format)
 	case VIDCAP_FOURCC_RGB555:
 		*pixel_format = k16LE555PixelFormat;
 		return 1;
-	case VIDCAP_FOURCC_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
 		*pixel_format = k24RGBPixelFormat;
 		return 1;
 	case VIDCAP_FOURCC_YVU9:
@@ -171,7 +171,7 @@ map_nominal_fourcc_to_native_fourcc(int nominal_fourcc)
 		return nominal_fourcc;
 
 	case VIDCAP_FOURCC_RGB555:
-	case VIDCAP_FOURCC_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
 	case VIDCAP_FOURCC_YVU9:
 	case VIDCAP_FOURCC_I420:
 	default:
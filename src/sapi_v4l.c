@@ -85,7 +85,9 @@ struct sapi_v4l_src_context
 
 	struct video_capability caps;
 	struct video_picture picture;
+	unsigned int palettes; /* bit per entry of palette_list accepted */
 	struct video_window window;
+	int fps_control; /* the driver takes its frame rate in window flags */
 	struct video_mbuf mbuf;
 
 	int capturing;
@@ -165,6 +167,10 @@ map_fourcc_to_palette(int fourcc, uint16_t * palette)
 		*palette = VIDEO_PALETTE_RGB555;
 		break;
 
+	case VIDCAP_FOURCC_GREY:
+		*palette = VIDEO_PALETTE_GREY;
+		break;
+
 	case VIDCAP_FOURCC_YVU9:
 		return 1;
 
@@ -175,6 +181,24 @@ map_fourcc_to_palette(int fourcc, uint16_t * palette)
 	return 0;
 }
 
+/* Palettes probed at acquire, with the depth the device expects */
+static const struct
+{
+	uint16_t palette;
+	uint16_t depth;
+} palette_list[] =
+{
+	{ VIDEO_PALETTE_YUV420P, 12 },
+	{ VIDEO_PALETTE_YUYV,    16 },
+	{ VIDEO_PALETTE_UYVY,    16 },
+	{ VIDEO_PALETTE_GREY,     8 },
+	{ VIDEO_PALETTE_RGB24,   24 },
+	{ VIDEO_PALETTE_RGB32,   32 },
+	{ VIDEO_PALETTE_RGB555,  16 },
+};
+
+enum { palette_list_len = sizeof(palette_list) / sizeof(palette_list[0]) };
+
 static int
 map_palette_to_fourcc(uint16_t palette, int * fourcc)
 {
@@ -204,6 +228,10 @@ map_palette_to_fourcc(uint16_t palette, int * fourcc)
 		*fourcc = VIDCAP_FOURCC_RGB555;
 		break;
 
+	case VIDEO_PALETTE_GREY:
+		*fourcc = VIDCAP_FOURCC_GREY;
+		break;
+
 	default:
 		return -1;
 	}
@@ -686,6 +714,60 @@ source_capture_stop(struct sapi_src_context * src_ctx)
 	return 0;
 }
 
+static __inline int
+clamp_dimension(int value, int min, int max)
+{
+	if ( value < min )
+		return min;
+	if ( value > max )
+		return max;
+	return value;
+}
+
+/* Picks the native format for a nominal one among the palettes the
+ * device accepts: the cheapest to deliver, which is the nominal
+ * fourcc itself when accepted.
+ */
+static int
+native_format_get(const struct sapi_v4l_src_context * v4l_src_ctx,
+		const struct vidcap_fmt_info * fmt_nominal,
+		struct vidcap_fmt_info * fmt_native, int * palette_index)
+{
+	struct vidcap_fmt_info candidate = *fmt_nominal;
+	int best_cost = -1;
+	int i;
+
+	candidate.width = clamp_dimension(fmt_nominal->width,
+			v4l_src_ctx->caps.minwidth,
+			v4l_src_ctx->caps.maxwidth);
+	candidate.height = clamp_dimension(fmt_nominal->height,
+			v4l_src_ctx->caps.minheight,
+			v4l_src_ctx->caps.maxheight);
+
+	for ( i = 0; i < palette_list_len; ++i )
+	{
+		int cost;
+
+		if ( !(v4l_src_ctx->palettes & (1u << i)) ||
+				map_palette_to_fourcc(palette_list[i].palette,
+					&candidate.fourcc) ||
+				!sapi_can_convert_native_to_nominal(&candidate,
+					fmt_nominal) )
+			continue;
+
+		cost = sapi_format_cost_get(&candidate, fmt_nominal);
+
+		if ( cost >= 0 && ( best_cost < 0 || cost < best_cost ) )
+		{
+			best_cost = cost;
+			*fmt_native = candidate;
+			*palette_index = i;
+		}
+	}
+
+	return best_cost < 0 ? -1 : 0;
+}
+
 static int
 source_format_validate(struct sapi_src_context * src_ctx,
 		const struct vidcap_fmt_info * fmt_nominal,
@@ -694,24 +776,24 @@ source_format_validate(struct sapi_src_context * src_ctx,
 	struct sapi_v4l_src_context * v4l_src_ctx =
 		(struct sapi_v4l_src_context *)src_ctx->priv;
 
-	*fmt_native = *fmt_nominal;
-
 	uint16_t palette;
+	int palette_index;
 
-	if ( fmt_nominal->width < v4l_src_ctx->caps.minwidth ||
+	/* Sizes the device cannot produce are only offered when binding,
+	 * in which case the closest native size is scaled.
+	 */
+	if ( !forBinding &&
+			( fmt_nominal->width < v4l_src_ctx->caps.minwidth ||
 			fmt_nominal->width > v4l_src_ctx->caps.maxwidth ||
 			fmt_nominal->height < v4l_src_ctx->caps.minheight ||
-			fmt_nominal->height > v4l_src_ctx->caps.maxheight )
+			fmt_nominal->height > v4l_src_ctx->caps.maxheight ) )
 		return 0;
 
 	if ( map_fourcc_to_palette(fmt_nominal->fourcc, &palette) )
 		return 0;
 
-	if ( map_palette_to_fourcc(v4l_src_ctx->picture.palette,
-				&fmt_native->fourcc) )
-		return 0;
-
-	if ( !sapi_can_convert_native_to_nominal(fmt_native, fmt_nominal) )
+	if ( native_format_get(v4l_src_ctx, fmt_nominal, fmt_native,
+				&palette_index) )
 		return 0;
 
 	return 1;
@@ -723,17 +805,20 @@ source_format_bind(struct sapi_src_context * src_ctx,
 {
 	struct sapi_v4l_src_context * v4l_src_ctx =
 		(struct sapi_v4l_src_context *)src_ctx->priv;
+	int palette_index;
 
-	memcpy(&src_ctx->fmt_native, fmt_info, sizeof(*fmt_info));
-
-	if ( map_palette_to_fourcc(v4l_src_ctx->picture.palette,
-				&src_ctx->fmt_native.fourcc) )
+	if ( native_format_get(v4l_src_ctx, fmt_info, &src_ctx->fmt_native,
+				&palette_index) )
 	{
-		log_warn("failed map_palette_to_fourcc %d\n",
-				v4l_src_ctx->picture.palette);
+		log_warn("no palette of %s can deliver %s\n",
+				v4l_src_ctx->device_path,
+				vidcap_fourcc_string_get(fmt_info->fourcc));
 		return -1;
 	}
 
+	v4l_src_ctx->picture.palette = palette_list[palette_index].palette;
+	v4l_src_ctx->picture.depth = palette_list[palette_index].depth;
+
 	if ( ioctl(v4l_src_ctx->fd, VIDIOCSPICT, &v4l_src_ctx->picture) == -1 )
 	{
 		log_warn("failed to set v4l picture parameters\n");
@@ -743,16 +828,23 @@ source_format_bind(struct sapi_src_context * src_ctx,
 	/* Only set the parameters we know/care about. */
 	v4l_src_ctx->window.x = 0;
 	v4l_src_ctx->window.y = 0;
-	v4l_src_ctx->window.width = fmt_info->width;
-	v4l_src_ctx->window.height = fmt_info->height;
-	/** \todo for pwc, framerate is encoded in flags. For other
-	 *        cameras, who knows.
+	v4l_src_ctx->window.width = clamp_dimension(fmt_info->width,
+			v4l_src_ctx->caps.minwidth,
+			v4l_src_ctx->caps.maxwidth);
+	v4l_src_ctx->window.height = clamp_dimension(fmt_info->height,
+			v4l_src_ctx->caps.minheight,
+			v4l_src_ctx->caps.maxheight);
+
+	/* Ask for the whole rate at or above the nominal one, leaving
+	 * any remainder to decimation
 	 */
-	v4l_src_ctx->window.flags =
-		(v4l_src_ctx->window.flags & ~v4l_fps_mask) |
-		(((src_ctx->fmt_native.fps_numerator /
-		   src_ctx->fmt_native.fps_denominator) << v4l_fps_shift) &
-		 v4l_fps_mask);
+	if ( v4l_src_ctx->fps_control )
+		v4l_src_ctx->window.flags =
+			(v4l_src_ctx->window.flags & ~v4l_fps_mask) |
+			((((fmt_info->fps_numerator +
+			    fmt_info->fps_denominator - 1) /
+			   fmt_info->fps_denominator) << v4l_fps_shift) &
+			 v4l_fps_mask);
 
 	if ( ioctl(v4l_src_ctx->fd, VIDIOCSWIN, &v4l_src_ctx->window) == -1 )
 	{
@@ -772,6 +864,19 @@ source_format_bind(struct sapi_src_context * src_ctx,
 		return -1;
 	}
 
+	if ( v4l_src_ctx->fps_control &&
+			(v4l_src_ctx->window.flags & v4l_fps_mask) )
+	{
+		src_ctx->fmt_native.fps_numerator =
+			(v4l_src_ctx->window.flags & v4l_fps_mask) >>
+			v4l_fps_shift;
+		src_ctx->fmt_native.fps_denominator = 1;
+		src_ctx->fps_granted = 1;
+
+		log_debug("%s granted %d fps\n", v4l_src_ctx->device_path,
+				src_ctx->fmt_native.fps_numerator);
+	}
+
 	if ( ioctl(v4l_src_ctx->fd, VIDIOCGMBUF, &v4l_src_ctx->mbuf) == -1 )
 	{
 		log_warn("failed to get v4l memory info for %s\n",
@@ -817,6 +922,50 @@ source_release(struct sapi_src_context * src_ctx)
 	return ret;
 }
 
+/* Round-trips each palette through the device, keeping those it
+ * reads back unchanged, then restores the current picture settings.
+ */
+static int
+palettes_probe(struct sapi_v4l_src_context * v4l_src_ctx)
+{
+	struct video_picture picture;
+	int i;
+
+	v4l_src_ctx->palettes = 0;
+
+	for ( i = 0; i < palette_list_len; ++i )
+	{
+		picture = v4l_src_ctx->picture;
+		picture.palette = palette_list[i].palette;
+		picture.depth = palette_list[i].depth;
+
+		if ( ioctl(v4l_src_ctx->fd, VIDIOCSPICT, &picture) == -1 ||
+				ioctl(v4l_src_ctx->fd, VIDIOCGPICT, &picture) == -1 )
+			continue;
+
+		if ( picture.palette == palette_list[i].palette )
+			v4l_src_ctx->palettes |= 1u << i;
+	}
+
+	if ( ioctl(v4l_src_ctx->fd, VIDIOCSPICT, &v4l_src_ctx->picture) == -1 )
+	{
+		log_warn("failed to restore v4l picture parameters for %s\n",
+				v4l_src_ctx->device_path);
+		return -1;
+	}
+
+	/* Drivers that refuse to change palette still deliver theirs */
+	for ( i = 0; i < palette_list_len; ++i )
+		if ( palette_list[i].palette == v4l_src_ctx->picture.palette )
+			v4l_src_ctx->palettes |= 1u << i;
+
+	if ( !v4l_src_ctx->palettes )
+		log_warn("no usable v4l palette for %s\n",
+				v4l_src_ctx->device_path);
+
+	return 0;
+}
+
 static int
 source_acquire(struct sapi_context * sapi_ctx,
 		struct sapi_src_context * src_ctx,
@@ -927,6 +1076,13 @@ source_acquire(struct sapi_context * sapi_ctx,
 		goto bail;
 	}
 
+	if ( palettes_probe(v4l_src_ctx) )
+		goto bail;
+
+	/* Only pwc is known to report its frame rate in window flags */
+	v4l_src_ctx->fps_control =
+		(v4l_src_ctx->window.flags & v4l_fps_mask) != 0;
+
 	/* Add all sources with the same device path to the acquired
 	 * source list.
 	 */
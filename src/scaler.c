@@ -0,0 +1,640 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file scaler.c
+ *  \ingroup Core
+ *  \brief Resizing of frames between native and nominal sizes.
+ *
+ *  Scaling is a pass of its own over whole frames, placed on whichever
+ *  side of the fourcc conversion has the smaller frame. Conversions
+ *  only take whole frames, so fusing the two would need a scaled
+ *  variant of every conversion.
+ *
+ *  Only the vertical steps, which blend or add whole rows, use SSE2.
+ *  The horizontal steps read their samples at positions taken from a
+ *  table, which SSE2 cannot load as a vector.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "conv.h"
+#include "cpu.h"
+#include "logging.h"
+#include "scaler.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+enum
+{
+	scaler_max_planes = 3,
+	scaler_max_channels = 4,
+
+	/* Area averaging accumulates rows in 16 bits */
+	scaler_max_area_rows = 257,
+};
+
+/* A channel is one kind of sample within a plane row. Packed formats
+ * interleave several channels with a different sampling period.
+ */
+struct scaler_channel
+{
+	int offset;
+	int step;
+	int x_div;
+};
+
+struct scaler_plane
+{
+	int x_div;
+	int y_div;
+	int bytes_per_pixel;
+	int num_channels;
+	struct scaler_channel channels[scaler_max_channels];
+};
+
+struct scaler_layout
+{
+	int fourcc;
+	int num_planes;
+	struct scaler_plane planes[scaler_max_planes];
+};
+
+static const struct scaler_layout scaler_layouts[] =
+{
+	{ VIDCAP_FOURCC_I420, 3, {
+		{ 1, 1, 1, 1, { { 0, 1, 1 } } },
+		{ 2, 2, 1, 1, { { 0, 1, 1 } } },
+		{ 2, 2, 1, 1, { { 0, 1, 1 } } } } },
+	{ VIDCAP_FOURCC_NV12, 2, {
+		{ 1, 1, 1, 1, { { 0, 1, 1 } } },
+		{ 2, 2, 2, 2, { { 0, 2, 1 }, { 1, 2, 1 } } } } },
+	{ VIDCAP_FOURCC_GREY, 1, {
+		{ 1, 1, 1, 1, { { 0, 1, 1 } } } } },
+	{ VIDCAP_FOURCC_YUY2, 1, {
+		{ 1, 1, 2, 3, { { 0, 2, 1 }, { 1, 4, 2 }, { 3, 4, 2 } } } } },
+	{ VIDCAP_FOURCC_2VUY, 1, {
+		{ 1, 1, 2, 3, { { 1, 2, 1 }, { 0, 4, 2 }, { 2, 4, 2 } } } } },
+	{ VIDCAP_FOURCC_RGB24, 1, {
+		{ 1, 1, 3, 3, { { 0, 3, 1 }, { 1, 3, 1 }, { 2, 3, 1 } } } } },
+	{ VIDCAP_FOURCC_BOTTOM_UP_RGB24, 1, {
+		{ 1, 1, 3, 3, { { 0, 3, 1 }, { 1, 3, 1 }, { 2, 3, 1 } } } } },
+	{ VIDCAP_FOURCC_RGB24_RED_FIRST, 1, {
+		{ 1, 1, 3, 3, { { 0, 3, 1 }, { 1, 3, 1 }, { 2, 3, 1 } } } } },
+	{ VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST, 1, {
+		{ 1, 1, 3, 3, { { 0, 3, 1 }, { 1, 3, 1 }, { 2, 3, 1 } } } } },
+	{ VIDCAP_FOURCC_BGR24, 1, {
+		{ 1, 1, 3, 3, { { 0, 3, 1 }, { 1, 3, 1 }, { 2, 3, 1 } } } } },
+	{ VIDCAP_FOURCC_RGB32, 1, {
+		{ 1, 1, 4, 4, { { 0, 4, 1 }, { 1, 4, 1 },
+				{ 2, 4, 1 }, { 3, 4, 1 } } } } },
+	{ VIDCAP_FOURCC_BGRA, 1, {
+		{ 1, 1, 4, 4, { { 0, 4, 1 }, { 1, 4, 1 },
+				{ 2, 4, 1 }, { 3, 4, 1 } } } } },
+	{ VIDCAP_FOURCC_RGBA, 1, {
+		{ 1, 1, 4, 4, { { 0, 4, 1 }, { 1, 4, 1 },
+				{ 2, 4, 1 }, { 3, 4, 1 } } } } },
+	{ VIDCAP_FOURCC_ARGB, 1, {
+		{ 1, 1, 4, 4, { { 0, 4, 1 }, { 1, 4, 1 },
+				{ 2, 4, 1 }, { 3, 4, 1 } } } } },
+};
+
+static const int scaler_layouts_len =
+	sizeof(scaler_layouts) / sizeof(struct scaler_layout);
+
+/* Source positions for each destination sample along one axis.
+ * Nearest uses first, bilinear blends first and second by weight/256,
+ * area averages [first, second).
+ */
+struct scaler_map
+{
+	int * first;
+	int * second;
+	int * weight;
+};
+
+typedef void (*blend_row_func)(unsigned char * dst,
+		const unsigned char * a, const unsigned char * b,
+		int n, int weight);
+
+typedef void (*accumulate_row_func)(unsigned short * acc,
+		const unsigned char * src, int n);
+
+struct scaler
+{
+	int mode;
+	const struct scaler_layout * layout;
+
+	int src_width;
+	int src_height;
+	int dst_width;
+	int dst_height;
+
+	struct scaler_map y_maps[scaler_max_planes];
+	struct scaler_map x_maps[scaler_max_planes][scaler_max_channels];
+
+	unsigned char * row_buf;
+	unsigned short * acc_buf;
+
+	blend_row_func blend_row;
+	accumulate_row_func accumulate_row;
+};
+
+static void
+blend_row_c(unsigned char * dst, const unsigned char * a,
+		const unsigned char * b, int n, int weight)
+{
+	const int inv_weight = 256 - weight;
+	int i;
+
+	for ( i = 0; i < n; ++i )
+		dst[i] = (unsigned char)
+			((a[i] * inv_weight + b[i] * weight + 128) >> 8);
+}
+
+static void
+accumulate_row_c(unsigned short * acc, const unsigned char * src, int n)
+{
+	int i;
+
+	for ( i = 0; i < n; ++i )
+		acc[i] = (unsigned short)(acc[i] + src[i]);
+}
+
+#ifdef CPU_X86
+/* Both weights are below 256, so the weighted sum of two 8-bit samples
+ * (plus rounding) fits in an unsigned 16-bit lane.
+ */
+CPU_TARGET("sse2") static void
+blend_row_sse2(unsigned char * dst, const unsigned char * a,
+		const unsigned char * b, int n, int weight)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i wa = _mm_set1_epi16((short)(256 - weight));
+	const __m128i wb = _mm_set1_epi16((short)weight);
+	const __m128i round = _mm_set1_epi16(128);
+	int i;
+
+	for ( i = 0; i + 16 <= n; i += 16 )
+	{
+		const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+
+		__m128i lo = _mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+		__m128i hi = _mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+
+	blend_row_c(dst + i, a + i, b + i, n - i, weight);
+}
+
+CPU_TARGET("sse2") static void
+accumulate_row_sse2(unsigned short * acc, const unsigned char * src, int n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int i;
+
+	for ( i = 0; i + 16 <= n; i += 16 )
+	{
+		const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i * a = (__m128i *)(acc + i);
+
+		_mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a),
+					_mm_unpacklo_epi8(s, zero)));
+		_mm_storeu_si128(a + 1, _mm_add_epi16(_mm_loadu_si128(a + 1),
+					_mm_unpackhi_epi8(s, zero)));
+	}
+
+	accumulate_row_c(acc + i, src + i, n - i);
+}
+#endif
+
+static const struct scaler_layout *
+scaler_layout_get(int fourcc)
+{
+	int i;
+
+	for ( i = 0; i < scaler_layouts_len; ++i )
+		if ( scaler_layouts[i].fourcc == fourcc )
+			return &scaler_layouts[i];
+
+	return 0;
+}
+
+int
+scaler_fourcc_supported(int fourcc)
+{
+	return scaler_layout_get(fourcc) != 0;
+}
+
+static void
+scaler_map_free(struct scaler_map * map)
+{
+	free(map->first);
+	free(map->second);
+	free(map->weight);
+}
+
+static int
+scaler_map_init(struct scaler_map * map, int mode, int src_len, int dst_len)
+{
+	int i;
+
+	map->first = malloc(dst_len * sizeof(int));
+	map->second = malloc(dst_len * sizeof(int));
+	map->weight = malloc(dst_len * sizeof(int));
+
+	if ( !map->first || !map->second || !map->weight )
+	{
+		log_oom(__FILE__, __LINE__);
+		return -1;
+	}
+
+	for ( i = 0; i < dst_len; ++i )
+	{
+		/* centre of destination sample i in source coordinates */
+		const double centre = (i + 0.5) * src_len / dst_len;
+
+		switch ( mode )
+		{
+		case VIDCAP_SCALE_BOX:
+			map->first[i] = (int)centre;
+			map->second[i] = map->first[i];
+			map->weight[i] = 0;
+			break;
+
+		case VIDCAP_SCALE_AREA:
+			map->first[i] = (int)((double)i * src_len / dst_len);
+			map->second[i] =
+				(int)((double)(i + 1) * src_len / dst_len);
+			if ( map->second[i] <= map->first[i] )
+				map->second[i] = map->first[i] + 1;
+			if ( map->second[i] - map->first[i] >
+					scaler_max_area_rows )
+				map->second[i] = map->first[i] +
+					scaler_max_area_rows;
+			break;
+
+		case VIDCAP_SCALE_BILINEAR:
+		default:
+		{
+			int pos = (int)((centre - 0.5) * 256.0);
+
+			if ( pos < 0 )
+				pos = 0;
+
+			map->first[i] = pos >> 8;
+			map->weight[i] = pos & 0xff;
+			map->second[i] = map->first[i] + 1;
+
+			if ( map->second[i] >= src_len )
+			{
+				map->first[i] = src_len - 1;
+				map->second[i] = src_len - 1;
+				map->weight[i] = 0;
+			}
+			break;
+		}
+		}
+
+		if ( map->first[i] >= src_len )
+			map->first[i] = src_len - 1;
+	}
+
+	return 0;
+}
+
+struct scaler *
+scaler_create(int mode, int fourcc,
+		int src_width, int src_height,
+		int dst_width, int dst_height)
+{
+	const struct scaler_layout * layout = scaler_layout_get(fourcc);
+	struct scaler * sc;
+	int max_row_bytes = 0;
+	int p, c;
+
+	if ( !layout )
+	{
+		log_error("scaling not supported for %s\n",
+				vidcap_fourcc_string_get(fourcc));
+		return 0;
+	}
+
+	if ( src_width < 4 || src_height < 4 || dst_width < 4 || dst_height < 4 )
+	{
+		log_error("invalid scaling %dx%d -> %dx%d\n",
+				src_width, src_height, dst_width, dst_height);
+		return 0;
+	}
+
+	sc = calloc(1, sizeof(*sc));
+
+	if ( !sc )
+	{
+		log_oom(__FILE__, __LINE__);
+		return 0;
+	}
+
+	sc->mode = mode;
+	sc->layout = layout;
+	sc->src_width = src_width;
+	sc->src_height = src_height;
+	sc->dst_width = dst_width;
+	sc->dst_height = dst_height;
+
+	for ( p = 0; p < layout->num_planes; ++p )
+	{
+		const struct scaler_plane * plane = &layout->planes[p];
+		const int src_plane_width = src_width / plane->x_div;
+		const int dst_plane_width = dst_width / plane->x_div;
+		const int row_bytes = src_plane_width * plane->bytes_per_pixel;
+
+		if ( row_bytes > max_row_bytes )
+			max_row_bytes = row_bytes;
+
+		if ( scaler_map_init(&sc->y_maps[p], mode,
+					src_height / plane->y_div,
+					dst_height / plane->y_div) )
+			goto bail;
+
+		for ( c = 0; c < plane->num_channels; ++c )
+		{
+			const int x_div = plane->channels[c].x_div;
+
+			if ( scaler_map_init(&sc->x_maps[p][c], mode,
+						src_plane_width / x_div,
+						dst_plane_width / x_div) )
+				goto bail;
+		}
+	}
+
+	sc->row_buf = malloc(max_row_bytes);
+	sc->acc_buf = malloc(max_row_bytes * sizeof(unsigned short));
+
+	if ( !sc->row_buf || !sc->acc_buf )
+	{
+		log_oom(__FILE__, __LINE__);
+		goto bail;
+	}
+
+	sc->blend_row = blend_row_c;
+	sc->accumulate_row = accumulate_row_c;
+
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+	{
+		sc->blend_row = blend_row_sse2;
+		sc->accumulate_row = accumulate_row_sse2;
+	}
+#endif
+
+	return sc;
+
+bail:
+	scaler_destroy(sc);
+	return 0;
+}
+
+void
+scaler_destroy(struct scaler * sc)
+{
+	int p, c;
+
+	for ( p = 0; p < scaler_max_planes; ++p )
+	{
+		scaler_map_free(&sc->y_maps[p]);
+
+		for ( c = 0; c < scaler_max_channels; ++c )
+			scaler_map_free(&sc->x_maps[p][c]);
+	}
+
+	free(sc->row_buf);
+	free(sc->acc_buf);
+	free(sc);
+}
+
+static void
+scale_row_box(const struct scaler_plane * plane,
+		const struct scaler_map * x_maps, int dst_plane_width,
+		const unsigned char * src, unsigned char * dst)
+{
+	int c, i;
+
+	for ( c = 0; c < plane->num_channels; ++c )
+	{
+		const struct scaler_channel * ch = &plane->channels[c];
+		const int * first = x_maps[c].first;
+		const int n = dst_plane_width / ch->x_div;
+		unsigned char * d = dst + ch->offset;
+		const unsigned char * s = src + ch->offset;
+
+		for ( i = 0; i < n; ++i )
+			d[i * ch->step] = s[first[i] * ch->step];
+	}
+}
+
+static void
+scale_row_bilinear(const struct scaler_plane * plane,
+		const struct scaler_map * x_maps, int dst_plane_width,
+		const unsigned char * src, unsigned char * dst)
+{
+	int c, i;
+
+	for ( c = 0; c < plane->num_channels; ++c )
+	{
+		const struct scaler_channel * ch = &plane->channels[c];
+		const int * first = x_maps[c].first;
+		const int * second = x_maps[c].second;
+		const int * weight = x_maps[c].weight;
+		const int n = dst_plane_width / ch->x_div;
+		unsigned char * d = dst + ch->offset;
+		const unsigned char * s = src + ch->offset;
+
+		for ( i = 0; i < n; ++i )
+		{
+			const int a = s[first[i] * ch->step];
+			const int b = s[second[i] * ch->step];
+
+			d[i * ch->step] = (unsigned char)
+				((a * (256 - weight[i]) + b * weight[i] + 128)
+				 >> 8);
+		}
+	}
+}
+
+static void
+scale_row_area(const struct scaler_plane * plane,
+		const struct scaler_map * x_maps, int dst_plane_width,
+		const unsigned short * acc, int rows, unsigned char * dst)
+{
+	int c, i, x;
+
+	for ( c = 0; c < plane->num_channels; ++c )
+	{
+		const struct scaler_channel * ch = &plane->channels[c];
+		const int * first = x_maps[c].first;
+		const int * second = x_maps[c].second;
+		const int n = dst_plane_width / ch->x_div;
+		unsigned char * d = dst + ch->offset;
+		const unsigned short * s = acc + ch->offset;
+
+		for ( i = 0; i < n; ++i )
+		{
+			const unsigned int count =
+				(second[i] - first[i]) * rows;
+			unsigned int sum = 0;
+
+			for ( x = first[i]; x < second[i]; ++x )
+				sum += s[x * ch->step];
+
+			d[i * ch->step] = (unsigned char)
+				((sum + count / 2) / count);
+		}
+	}
+}
+
+static void
+scale_plane(struct scaler * sc, int p,
+		const unsigned char * src, unsigned char * dst)
+{
+	const struct scaler_plane * plane = &sc->layout->planes[p];
+	const struct scaler_map * y_map = &sc->y_maps[p];
+	const struct scaler_map * x_maps = sc->x_maps[p];
+	const int src_plane_width = sc->src_width / plane->x_div;
+	const int dst_plane_width = sc->dst_width / plane->x_div;
+	const int dst_plane_height = sc->dst_height / plane->y_div;
+	const int src_row_bytes = src_plane_width * plane->bytes_per_pixel;
+	const int dst_row_bytes = dst_plane_width * plane->bytes_per_pixel;
+	const int same_width = src_plane_width == dst_plane_width;
+	int y, i;
+
+	for ( y = 0; y < dst_plane_height; ++y )
+	{
+		unsigned char * d = dst + y * dst_row_bytes;
+		const unsigned char * row =
+			src + y_map->first[y] * src_row_bytes;
+
+		switch ( sc->mode )
+		{
+		case VIDCAP_SCALE_BOX:
+			if ( same_width )
+				memcpy(d, row, dst_row_bytes);
+			else
+				scale_row_box(plane, x_maps, dst_plane_width,
+						row, d);
+			break;
+
+		case VIDCAP_SCALE_AREA:
+		{
+			const int rows = y_map->second[y] - y_map->first[y];
+
+			for ( i = 0; i < src_row_bytes; ++i )
+				sc->acc_buf[i] = row[i];
+
+			for ( i = 1; i < rows; ++i )
+				sc->accumulate_row(sc->acc_buf,
+						row + i * src_row_bytes,
+						src_row_bytes);
+
+			if ( same_width )
+			{
+				for ( i = 0; i < dst_row_bytes; ++i )
+					d[i] = (unsigned char)
+						((sc->acc_buf[i] + rows / 2) /
+						 rows);
+			}
+			else
+			{
+				scale_row_area(plane, x_maps, dst_plane_width,
+						sc->acc_buf, rows, d);
+			}
+			break;
+		}
+
+		case VIDCAP_SCALE_BILINEAR:
+		default:
+			/* Blend the two source rows, straight into the
+			 * destination when no horizontal pass is needed.
+			 */
+			if ( y_map->weight[y] )
+			{
+				unsigned char * blended =
+					same_width ? d : sc->row_buf;
+
+				sc->blend_row(blended, row,
+						src + y_map->second[y] *
+						src_row_bytes,
+						src_row_bytes, y_map->weight[y]);
+
+				if ( same_width )
+					break;
+
+				row = blended;
+			}
+
+			if ( same_width )
+				memcpy(d, row, dst_row_bytes);
+			else
+				scale_row_bilinear(plane, x_maps,
+						dst_plane_width, row, d);
+			break;
+		}
+	}
+}
+
+int
+scaler_scale(struct scaler * sc, const char * src, char * dst)
+{
+	const unsigned char * s = (const unsigned char *)src;
+	unsigned char * d = (unsigned char *)dst;
+	int p;
+
+	for ( p = 0; p < sc->layout->num_planes; ++p )
+	{
+		const struct scaler_plane * plane = &sc->layout->planes[p];
+
+		scale_plane(sc, p, s, d);
+
+		s += (sc->src_width / plane->x_div) *
+			(sc->src_height / plane->y_div) *
+			plane->bytes_per_pixel;
+		d += (sc->dst_width / plane->x_div) *
+			(sc->dst_height / plane->y_div) *
+			plane->bytes_per_pixel;
+	}
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _SCALER_H
+#define _SCALER_H
+
+/** \file scaler.h
+ *  \ingroup Core
+ *  \brief Resizing of frames between native and nominal sizes.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct scaler;
+
+/**
+ *  \brief Tells whether frames of a fourcc can be scaled
+ *
+ *  \param [in] fourcc Fourcc of the frames to scale
+ *  \return 1 if supported, 0 otherwise
+ */
+int
+scaler_fourcc_supported(int fourcc);
+
+/**
+ *  \brief Create a scaler for one fourcc and a pair of frame sizes
+ *
+ *  \param [in] mode       One of enum vidcap_scale_mode
+ *  \param [in] fourcc     Fourcc of both source and destination frames
+ *  \param [in] src_width  Width of the source frames
+ *  \param [in] src_height Height of the source frames
+ *  \param [in] dst_width  Width of the destination frames
+ *  \param [in] dst_height Height of the destination frames
+ *  \return The scaler or 0 on failure
+ *
+ *  \details Sample positions and filter weights are computed here, once,
+ *           so that scaler_scale() only has to walk the pixels.
+ */
+struct scaler *
+scaler_create(int mode, int fourcc,
+		int src_width, int src_height,
+		int dst_width, int dst_height);
+
+/**
+ *  \brief Release a scaler
+ *
+ *  \param [in] sc Scaler to release
+ */
+void
+scaler_destroy(struct scaler * sc);
+
+/**
+ *  \brief Scale one frame
+ *
+ *  \param [in] sc  Scaler
+ *  \param [in] src Tightly packed source frame
+ *  \param [in] dst Destination frame, conv_fmt_size_get() bytes in size
+ *  \return Returns 0 on success
+ */
+int
+scaler_scale(struct scaler * sc, const char * src, char * dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
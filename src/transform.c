@@ -0,0 +1,555 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/** \file transform.c
+ *  \ingroup Core
+ *  \brief Rotation and mirroring of frames.
+ */
+
+#include <string.h>
+
+#include "conv.h"
+#include "cpu.h"
+#include "frame_copy.h"
+#include "logging.h"
+#include "transform.h"
+
+#ifdef CPU_X86
+#include <emmintrin.h>
+#endif
+
+enum
+{
+	/* Destination blocks are walked so that both the rows written and
+	 * the source columns read stay in cache.
+	 */
+	transform_block = 64,
+};
+
+/* Any mix of flips and rotation is a transpose (or not) followed by
+ * mirroring the result horizontally and/or vertically.
+ */
+struct transform_op
+{
+	int transpose;
+	int flip_h;
+	int flip_v;
+};
+
+/* Source of destination pixel (x, y) is origin + x * x_step + y * y_step */
+struct plane_walk
+{
+	const unsigned char * origin;
+	int x_step;
+	int y_step;
+};
+
+typedef void (*tile_func)(const struct plane_walk * walk,
+		unsigned char * dst, int dst_stride, int x, int y);
+
+static void
+transform_op_get(int transform, struct transform_op * op)
+{
+	const int quarter_turns = transform & VIDCAP_TRANSFORM_ROTATE_MASK;
+	int flip_h;
+	int i;
+
+	op->transpose = 0;
+	op->flip_h = (transform & VIDCAP_TRANSFORM_FLIP_H) != 0;
+	op->flip_v = (transform & VIDCAP_TRANSFORM_FLIP_V) != 0;
+
+	/* A clockwise quarter turn is a transpose followed by a horizontal
+	 * mirror. Transposing exchanges the mirrors done before it.
+	 */
+	for ( i = 0; i < quarter_turns; ++i )
+	{
+		flip_h = op->flip_h;
+		op->flip_h = !op->flip_v;
+		op->flip_v = flip_h;
+		op->transpose = !op->transpose;
+	}
+}
+
+static void
+plane_walk_init(const struct transform_op * op, const unsigned char * src,
+		int width, int height, int bytes_per_pixel,
+		struct plane_walk * walk)
+{
+	const int stride = width * bytes_per_pixel;
+	const int last_row = (height - 1) * stride;
+	const int last_col = (width - 1) * bytes_per_pixel;
+
+	if ( !op->transpose )
+	{
+		walk->x_step = op->flip_h ? -bytes_per_pixel : bytes_per_pixel;
+		walk->y_step = op->flip_v ? -stride : stride;
+		walk->origin = src + (op->flip_v ? last_row : 0) +
+			(op->flip_h ? last_col : 0);
+	}
+	else
+	{
+		walk->x_step = op->flip_h ? -stride : stride;
+		walk->y_step = op->flip_v ? -bytes_per_pixel : bytes_per_pixel;
+		walk->origin = src + (op->flip_h ? last_row : 0) +
+			(op->flip_v ? last_col : 0);
+	}
+}
+
+static void
+gather_rect(const struct plane_walk * walk, int bytes_per_pixel,
+		unsigned char * dst, int dst_stride,
+		int x0, int y0, int x1, int y1)
+{
+	int x, y;
+
+	for ( y = y0; y < y1; ++y )
+	{
+		const unsigned char * s =
+			walk->origin + x0 * walk->x_step + y * walk->y_step;
+		unsigned char * d = dst + y * dst_stride + x0 * bytes_per_pixel;
+
+		switch ( bytes_per_pixel )
+		{
+		case 1:
+			for ( x = x0; x < x1; ++x, s += walk->x_step )
+				*d++ = *s;
+			break;
+		case 4:
+			for ( x = x0; x < x1; ++x, s += walk->x_step, d += 4 )
+				memcpy(d, s, 4);
+			break;
+		default:
+			for ( x = x0; x < x1; ++x, s += walk->x_step )
+			{
+				memcpy(d, s, bytes_per_pixel);
+				d += bytes_per_pixel;
+			}
+			break;
+		}
+	}
+}
+
+static void
+reverse_row_c(unsigned char * dst, const unsigned char * src_last,
+		int width, int bytes_per_pixel)
+{
+	struct plane_walk walk;
+
+	walk.origin = src_last;
+	walk.x_step = -bytes_per_pixel;
+	walk.y_step = 0;
+
+	gather_rect(&walk, bytes_per_pixel, dst, 0, 0, 0, width, 1);
+}
+
+#ifdef CPU_X86
+/* src_last points at the last pixel of the source row */
+CPU_TARGET("sse2") static void
+reverse_row_sse2(unsigned char * dst, const unsigned char * src_last,
+		int width, int bytes_per_pixel)
+{
+	int x = 0;
+
+	if ( bytes_per_pixel == 1 )
+	{
+		for ( ; x + 16 <= width; x += 16 )
+		{
+			__m128i v = _mm_loadu_si128(
+					(const __m128i *)(src_last - x - 15));
+
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+			v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8),
+					_mm_srli_epi16(v, 8));
+
+			_mm_storeu_si128((__m128i *)(dst + x), v);
+		}
+	}
+	else if ( bytes_per_pixel == 4 )
+	{
+		for ( ; x + 4 <= width; x += 4 )
+		{
+			__m128i v = _mm_loadu_si128(
+					(const __m128i *)(src_last - 4 * (x + 3)));
+
+			_mm_storeu_si128((__m128i *)(dst + 4 * x),
+					_mm_shuffle_epi32(v,
+						_MM_SHUFFLE(0, 1, 2, 3)));
+		}
+	}
+
+	reverse_row_c(dst + x * bytes_per_pixel,
+			src_last - x * bytes_per_pixel,
+			width - x, bytes_per_pixel);
+}
+
+/* Reading a source row gives a destination column. When walking the
+ * source backwards the row is loaded from its far end and the columns
+ * come out in reverse order instead of being reversed in registers.
+ */
+CPU_TARGET("sse2") static void
+transpose_tile8_sse2(const struct plane_walk * walk,
+		unsigned char * dst, int dst_stride, int x, int y)
+{
+	const int reversed = walk->y_step < 0;
+	const unsigned char * s = walk->origin + x * walk->x_step +
+		(reversed ? y + 7 : y) * walk->y_step;
+	__m128i r[8], b[4], c[4], d[4], col;
+	int i;
+
+	for ( i = 0; i < 8; ++i, s += walk->x_step )
+		r[i] = _mm_loadl_epi64((const __m128i *)s);
+
+	for ( i = 0; i < 4; ++i )
+		b[i] = _mm_unpacklo_epi8(r[2 * i], r[2 * i + 1]);
+
+	c[0] = _mm_unpacklo_epi16(b[0], b[1]);
+	c[1] = _mm_unpackhi_epi16(b[0], b[1]);
+	c[2] = _mm_unpacklo_epi16(b[2], b[3]);
+	c[3] = _mm_unpackhi_epi16(b[2], b[3]);
+
+	d[0] = _mm_unpacklo_epi32(c[0], c[2]);
+	d[1] = _mm_unpackhi_epi32(c[0], c[2]);
+	d[2] = _mm_unpacklo_epi32(c[1], c[3]);
+	d[3] = _mm_unpackhi_epi32(c[1], c[3]);
+
+	for ( i = 0; i < 8; ++i )
+	{
+		const int row = reversed ? 7 - i : i;
+
+		col = i & 1 ? _mm_unpackhi_epi64(d[i / 2], d[i / 2]) : d[i / 2];
+
+		_mm_storel_epi64((__m128i *)(dst + (y + row) * dst_stride + x),
+				col);
+	}
+}
+
+CPU_TARGET("sse2") static void
+transpose_tile4x32_sse2(const struct plane_walk * walk,
+		unsigned char * dst, int dst_stride, int x, int y)
+{
+	const int reversed = walk->y_step < 0;
+	const unsigned char * s = walk->origin + x * walk->x_step +
+		(reversed ? y + 3 : y) * walk->y_step;
+	__m128i r[4], t[4], col[4];
+	int i;
+
+	for ( i = 0; i < 4; ++i, s += walk->x_step )
+		r[i] = _mm_loadu_si128((const __m128i *)s);
+
+	t[0] = _mm_unpacklo_epi32(r[0], r[1]);
+	t[1] = _mm_unpacklo_epi32(r[2], r[3]);
+	t[2] = _mm_unpackhi_epi32(r[0], r[1]);
+	t[3] = _mm_unpackhi_epi32(r[2], r[3]);
+
+	col[0] = _mm_unpacklo_epi64(t[0], t[1]);
+	col[1] = _mm_unpackhi_epi64(t[0], t[1]);
+	col[2] = _mm_unpacklo_epi64(t[2], t[3]);
+	col[3] = _mm_unpackhi_epi64(t[2], t[3]);
+
+	for ( i = 0; i < 4; ++i )
+	{
+		const int row = reversed ? 3 - i : i;
+
+		_mm_storeu_si128((__m128i *)(dst + (y + row) * dst_stride +
+					4 * x), col[i]);
+	}
+}
+#endif
+
+static void
+transpose_plane(const struct plane_walk * walk, int bytes_per_pixel,
+		unsigned char * dst, int dst_width, int dst_height)
+{
+	const int dst_stride = dst_width * bytes_per_pixel;
+	tile_func tile = 0;
+	int tile_size = 1;
+	int bx, by;
+
+#ifdef CPU_X86
+	if ( cpu_flags_get() & cpu_flag_sse2 )
+	{
+		if ( bytes_per_pixel == 1 )
+		{
+			tile = transpose_tile8_sse2;
+			tile_size = 8;
+		}
+		else if ( bytes_per_pixel == 4 )
+		{
+			tile = transpose_tile4x32_sse2;
+			tile_size = 4;
+		}
+	}
+#endif
+
+	for ( by = 0; by < dst_height; by += transform_block )
+	{
+		const int y1 = by + transform_block < dst_height ?
+			by + transform_block : dst_height;
+
+		for ( bx = 0; bx < dst_width; bx += transform_block )
+		{
+			const int x1 = bx + transform_block < dst_width ?
+				bx + transform_block : dst_width;
+			const int tx1 = bx + (x1 - bx) / tile_size * tile_size;
+			const int ty1 = by + (y1 - by) / tile_size * tile_size;
+			int x, y;
+
+			if ( !tile )
+			{
+				gather_rect(walk, bytes_per_pixel, dst,
+						dst_stride, bx, by, x1, y1);
+				continue;
+			}
+
+			for ( y = by; y < ty1; y += tile_size )
+				for ( x = bx; x < tx1; x += tile_size )
+					tile(walk, dst, dst_stride, x, y);
+
+			gather_rect(walk, bytes_per_pixel, dst, dst_stride,
+					tx1, by, x1, ty1);
+			gather_rect(walk, bytes_per_pixel, dst, dst_stride,
+					bx, ty1, x1, y1);
+		}
+	}
+}
+
+static void
+transform_plane(const struct transform_op * op, int bytes_per_pixel,
+		int width, int height,
+		const unsigned char * src, unsigned char * dst)
+{
+	const int row_bytes = width * bytes_per_pixel;
+	struct plane_walk walk;
+	int y;
+
+	plane_walk_init(op, src, width, height, bytes_per_pixel, &walk);
+
+	if ( op->transpose )
+	{
+		transpose_plane(&walk, bytes_per_pixel, dst, height, width);
+		return;
+	}
+
+	/* Rows only change order */
+	if ( !op->flip_h )
+	{
+		frame_copy_rows((char *)dst, row_bytes,
+				(const char *)walk.origin, walk.y_step,
+				row_bytes, height);
+		return;
+	}
+
+	for ( y = 0; y < height; ++y, dst += row_bytes )
+	{
+		const unsigned char * s = walk.origin + y * walk.y_step;
+
+#ifdef CPU_X86
+		if ( cpu_flags_get() & cpu_flag_sse2 )
+			reverse_row_sse2(dst, s, width, bytes_per_pixel);
+		else
+#endif
+			reverse_row_c(dst, s, width, bytes_per_pixel);
+	}
+}
+
+/* Chroma of 4:2:2 is shared by horizontal pairs of pixels. Once a frame
+ * is mirrored or turned, a destination pair may come from two source
+ * pairs, so its chroma is the average of both.
+ */
+static void
+transform_packed422(const struct transform_op * op,
+		int y_offset, int u_offset, int v_offset,
+		int width, int height,
+		const unsigned char * src, unsigned char * dst)
+{
+	const int dst_width = op->transpose ? height : width;
+	const int dst_height = op->transpose ? width : height;
+	const int stride = 2 * width;
+	int sx0, sx_dx, sx_dy;
+	int sy0, sy_dx, sy_dy;
+	int bx, by, x, y;
+
+	/* Source coordinates of destination pixel (x, y) */
+	if ( !op->transpose )
+	{
+		sx0 = op->flip_h ? width - 1 : 0;
+		sx_dx = op->flip_h ? -1 : 1;
+		sx_dy = 0;
+		sy0 = op->flip_v ? height - 1 : 0;
+		sy_dx = 0;
+		sy_dy = op->flip_v ? -1 : 1;
+	}
+	else
+	{
+		sx0 = op->flip_v ? width - 1 : 0;
+		sx_dx = 0;
+		sx_dy = op->flip_v ? -1 : 1;
+		sy0 = op->flip_h ? height - 1 : 0;
+		sy_dx = op->flip_h ? -1 : 1;
+		sy_dy = 0;
+	}
+
+	for ( by = 0; by < dst_height; by += transform_block )
+	{
+		const int y1 = by + transform_block < dst_height ?
+			by + transform_block : dst_height;
+
+		for ( bx = 0; bx < dst_width; bx += transform_block )
+		{
+			const int x1 = bx + transform_block < dst_width ?
+				bx + transform_block : dst_width;
+
+			for ( y = by; y < y1; ++y )
+			{
+				unsigned char * d = dst + (y * dst_width + bx) * 2;
+
+				for ( x = bx; x < x1; x += 2, d += 4 )
+				{
+					const int xb = x + 1 < dst_width ? x + 1 : x;
+					const int sx_a = sx0 + x * sx_dx + y * sx_dy;
+					const int sy_a = sy0 + x * sy_dx + y * sy_dy;
+					const int sx_b = sx0 + xb * sx_dx + y * sx_dy;
+					const int sy_b = sy0 + xb * sy_dx + y * sy_dy;
+					const unsigned char * pair_a =
+						src + sy_a * stride + 4 * (sx_a >> 1);
+					const unsigned char * pair_b =
+						src + sy_b * stride + 4 * (sx_b >> 1);
+
+					d[y_offset] = pair_a[y_offset + 2 * (sx_a & 1)];
+					d[y_offset + 2] =
+						pair_b[y_offset + 2 * (sx_b & 1)];
+					d[u_offset] = (unsigned char)((pair_a[u_offset] +
+							pair_b[u_offset] + 1) >> 1);
+					d[v_offset] = (unsigned char)((pair_a[v_offset] +
+							pair_b[v_offset] + 1) >> 1);
+				}
+			}
+		}
+	}
+}
+
+int
+transform_fourcc_supported(int fourcc)
+{
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_I420:
+	case VIDCAP_FOURCC_NV12:
+	case VIDCAP_FOURCC_P010:
+	case VIDCAP_FOURCC_YUY2:
+	case VIDCAP_FOURCC_2VUY:
+	case VIDCAP_FOURCC_RGB565:
+	case VIDCAP_FOURCC_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BGR24:
+	case VIDCAP_FOURCC_RGB32:
+	case VIDCAP_FOURCC_BGRA:
+	case VIDCAP_FOURCC_RGBA:
+	case VIDCAP_FOURCC_ARGB:
+	case VIDCAP_FOURCC_GREY:
+	case VIDCAP_FOURCC_Y10:
+	case VIDCAP_FOURCC_Y16:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+int
+transform_swaps_dimensions(int transform)
+{
+	return (transform & VIDCAP_TRANSFORM_ROTATE_MASK) ==
+			VIDCAP_TRANSFORM_ROTATE_90 ||
+		(transform & VIDCAP_TRANSFORM_ROTATE_MASK) ==
+			VIDCAP_TRANSFORM_ROTATE_270;
+}
+
+int
+transform_apply(int transform, int fourcc, int width, int height,
+		const char * src, char * dst)
+{
+	const unsigned char * s = (const unsigned char *)src;
+	unsigned char * d = (unsigned char *)dst;
+	struct transform_op op;
+
+	transform_op_get(transform, &op);
+
+	switch ( fourcc )
+	{
+	case VIDCAP_FOURCC_I420: {
+		const int y_size = width * height;
+		const int c_size = y_size / 4;
+
+		transform_plane(&op, 1, width, height, s, d);
+		transform_plane(&op, 1, width / 2, height / 2,
+				s + y_size, d + y_size);
+		transform_plane(&op, 1, width / 2, height / 2,
+				s + y_size + c_size, d + y_size + c_size);
+		return 0;
+		}
+	case VIDCAP_FOURCC_NV12:
+	case VIDCAP_FOURCC_P010: {
+		/* Interleaved u and v move together, as one pixel */
+		const int sample_bytes = fourcc == VIDCAP_FOURCC_P010 ? 2 : 1;
+		const int y_size = width * height * sample_bytes;
+
+		transform_plane(&op, sample_bytes, width, height, s, d);
+		transform_plane(&op, 2 * sample_bytes, width / 2, height / 2,
+				s + y_size, d + y_size);
+		return 0;
+		}
+	case VIDCAP_FOURCC_YUY2:
+		transform_packed422(&op, 0, 1, 3, width, height, s, d);
+		return 0;
+	case VIDCAP_FOURCC_2VUY:
+		transform_packed422(&op, 1, 0, 2, width, height, s, d);
+		return 0;
+	case VIDCAP_FOURCC_GREY:
+		transform_plane(&op, 1, width, height, s, d);
+		return 0;
+	case VIDCAP_FOURCC_Y10:
+	case VIDCAP_FOURCC_Y16:
+	case VIDCAP_FOURCC_RGB565:
+		transform_plane(&op, 2, width, height, s, d);
+		return 0;
+	case VIDCAP_FOURCC_RGB24:
+	case VIDCAP_FOURCC_RGB24_RED_FIRST:
+	case VIDCAP_FOURCC_BGR24:
+		transform_plane(&op, 3, width, height, s, d);
+		return 0;
+	case VIDCAP_FOURCC_RGB32:
+	case VIDCAP_FOURCC_BGRA:
+	case VIDCAP_FOURCC_RGBA:
+	case VIDCAP_FOURCC_ARGB:
+		transform_plane(&op, 4, width, height, s, d);
+		return 0;
+	default:
+		log_error("cannot transform fourcc [%s]\n",
+				vidcap_fourcc_string_get(fourcc));
+		return -1;
+	}
+}
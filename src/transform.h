@@ -0,0 +1,78 @@
+/*
+ * libvidcap - a cross-platform video capture library
+ *
+ * Copyright 2007 Wimba, Inc.
+ *
+ * Contributors:
+ * Peter Grayson <jpgrayson@gmail.com>
+ * Bill Cholewka <bcholew@gmail.com>
+ *
+ * libvidcap is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * libvidcap is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _TRANSFORM_H
+#define _TRANSFORM_H
+
+/** \file transform.h
+ *  \ingroup Core
+ *  \brief Rotation and mirroring of frames.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  \brief Tells whether frames of a fourcc can be transformed
+ *
+ *  \param [in] fourcc Fourcc of the frames to transform
+ *  \return 1 if supported, 0 otherwise
+ */
+int
+transform_fourcc_supported(int fourcc);
+
+/**
+ *  \brief Tells whether a transform exchanges width and height
+ *
+ *  \param [in] transform Bitwise or of enum vidcap_transform values
+ *  \return 1 for quarter turns, 0 otherwise
+ */
+int
+transform_swaps_dimensions(int transform);
+
+/**
+ *  \brief Rotate and/or mirror one frame
+ *
+ *  \param [in] transform Bitwise or of enum vidcap_transform values
+ *  \param [in] fourcc    Fourcc of both source and destination frames
+ *  \param [in] width     Width of the source frame
+ *  \param [in] height    Height of the source frame
+ *  \param [in] src       Tightly packed source frame
+ *  \param [in] dst       Destination frame, conv_fmt_size_get() bytes
+ *  \return Returns 0 on success
+ *
+ *  \details The flips are applied first, then the clockwise rotation.
+ *           Quarter turns produce a height x width frame.
+ */
+int
+transform_apply(int transform, int fourcc, int width, int height,
+		const char * src, char * dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
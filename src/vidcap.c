@@ -34,6 +34,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "colorimetry.h"
+#include "frame_copy.h"
 #include "logging.h"
 #include "sapi_context.h"
 #include "sapi.h"
@@ -314,6 +316,13 @@ vidcap_src_acquire(vidcap_sapi * sapi,
 		return 0;
 	}
 
+	if ( vc_mutex_init(&src_ctx->stats_lock) )
+	{
+		log_error("failed to initialize source stats lock\n");
+		free(src_ctx);
+		return 0;
+	}
+
 	/** \todo right now we always use the timer thread to enforce
 	 *        a very accurate framerate. Alternatively, we could
 	 *        allow an application to choose to forego this feature
@@ -321,6 +330,10 @@ vidcap_src_acquire(vidcap_sapi * sapi,
 	 */
 	src_ctx->use_timer_thread = 0;
 
+	src_ctx->scale_mode = VIDCAP_SCALE_BILINEAR;
+	src_ctx->bit_shift = -1;
+	conv_params_init(&src_ctx->conv_params);
+
 	if ( src_ctx->use_timer_thread )
 	{
 		src_ctx->kill_timer_thread = 0;
@@ -376,6 +389,7 @@ bail:
 		vc_thread_join(&src_ctx->capture_timer_thread);
 	}
 
+	vc_mutex_destroy(&src_ctx->stats_lock);
 	free(src_ctx);
 	return 0;
 }
@@ -389,6 +403,63 @@ vidcap_src_info_get(vidcap_src * src,
 	return 0;
 }
 
+static void
+rois_free(struct sapi_src_context * src_ctx)
+{
+	int i;
+
+	for ( i = 0; i < src_ctx->roi_count; ++i )
+	{
+		if ( src_ctx->rois[i].crop_buf )
+			free(src_ctx->rois[i].crop_buf);
+
+		if ( src_ctx->rois[i].buf )
+			free(src_ctx->rois[i].buf);
+	}
+
+	if ( src_ctx->rois )
+		free(src_ctx->rois);
+
+	if ( src_ctx->roi_images )
+		free(src_ctx->roi_images);
+
+	src_ctx->rois = 0;
+	src_ctx->roi_images = 0;
+	src_ctx->roi_count = 0;
+}
+
+static void
+frame_convs_free(struct sapi_src_context * src_ctx)
+{
+	int i;
+
+	for ( i = 0; i < src_ctx->frame_conv_count; ++i )
+	{
+		if ( src_ctx->frame_convs[i].scaler )
+			scaler_destroy(src_ctx->frame_convs[i].scaler);
+
+		free(src_ctx->frame_convs[i].buf);
+		free(src_ctx->frame_convs[i].work_buf);
+	}
+
+	src_ctx->frame_conv_count = 0;
+}
+
+static void
+jitter_free(struct sapi_src_context * src_ctx)
+{
+	sapi_src_jitter_stop(src_ctx);
+
+	if ( src_ctx->jitter )
+		jitter_buffer_destroy(src_ctx->jitter);
+
+	if ( src_ctx->jitter_buf )
+		free(src_ctx->jitter_buf);
+
+	src_ctx->jitter = 0;
+	src_ctx->jitter_buf = 0;
+}
+
 int
 vidcap_src_release(vidcap_src * src)
 {
@@ -407,6 +478,8 @@ vidcap_src_release(vidcap_src * src)
 		vc_thread_join(&src_ctx->capture_timer_thread);
 	}
 
+	jitter_free(src_ctx);
+
 	ret = src_ctx->release(src_ctx);
 
 	if ( src_ctx->fmt_list_len )
@@ -418,9 +491,25 @@ vidcap_src_release(vidcap_src * src)
 	if ( src_ctx->stride_free_buf )
 		free(src_ctx->stride_free_buf);
 
-	if ( src_ctx->frame_times )
-		sliding_window_destroy(src_ctx->frame_times);
+	if ( src_ctx->scaler )
+		scaler_destroy(src_ctx->scaler);
 
+	if ( src_ctx->scale_buf )
+		free(src_ctx->scale_buf);
+
+	if ( src_ctx->transform_buf )
+		free(src_ctx->transform_buf);
+
+	if ( src_ctx->pyramid )
+		pyramid_destroy(src_ctx->pyramid);
+
+	if ( src_ctx->motion )
+		motion_destroy(src_ctx->motion);
+
+	rois_free(src_ctx);
+	frame_convs_free(src_ctx);
+
+	vc_mutex_destroy(&src_ctx->stats_lock);
 	free(src_ctx);
 
 	return ret;
@@ -440,6 +529,175 @@ vidcap_format_enumerate(vidcap_src * src,
 	return 1;
 }
 
+static int
+scaler_bind(struct sapi_src_context * src_ctx)
+{
+	int scale_fourcc;
+
+	if ( src_ctx->scaler )
+	{
+		scaler_destroy(src_ctx->scaler);
+		src_ctx->scaler = 0;
+	}
+
+	if ( src_ctx->scale_buf )
+	{
+		free(src_ctx->scale_buf);
+		src_ctx->scale_buf = 0;
+	}
+
+	if ( src_ctx->fmt_native.width == src_ctx->fmt_nominal.width &&
+			src_ctx->fmt_native.height == src_ctx->fmt_nominal.height )
+		return 0;
+
+	scale_fourcc = sapi_scale_fourcc_get(&src_ctx->fmt_native,
+			&src_ctx->fmt_nominal);
+
+	if ( !scale_fourcc )
+	{
+		log_error("cannot scale %s %dx%d to %s %dx%d\n",
+				vidcap_fourcc_string_get(src_ctx->fmt_native.fourcc),
+				src_ctx->fmt_native.width,
+				src_ctx->fmt_native.height,
+				vidcap_fourcc_string_get(src_ctx->fmt_nominal.fourcc),
+				src_ctx->fmt_nominal.width,
+				src_ctx->fmt_nominal.height);
+		return -1;
+	}
+
+	src_ctx->scale_before_conv =
+		scale_fourcc == src_ctx->fmt_native.fourcc;
+
+	src_ctx->scaler = scaler_create(src_ctx->scale_mode, scale_fourcc,
+			src_ctx->fmt_native.width, src_ctx->fmt_native.height,
+			src_ctx->fmt_nominal.width, src_ctx->fmt_nominal.height);
+
+	if ( !src_ctx->scaler )
+		return -1;
+
+	src_ctx->scale_buf_size = conv_fmt_size_get(
+			src_ctx->fmt_nominal.width,
+			src_ctx->fmt_nominal.height,
+			scale_fourcc);
+
+	if ( !(src_ctx->scale_buf = malloc(src_ctx->scale_buf_size)) )
+	{
+		log_oom(__FILE__, __LINE__);
+		return -1;
+	}
+
+	log_debug("format bind requires scaling %dx%d -> %dx%d (%s)\n",
+			src_ctx->fmt_native.width, src_ctx->fmt_native.height,
+			src_ctx->fmt_nominal.width, src_ctx->fmt_nominal.height,
+			vidcap_fourcc_string_get(scale_fourcc));
+
+	return 0;
+}
+
+static int
+transform_bind(struct sapi_src_context * src_ctx)
+{
+	const struct vidcap_fmt_info * native = &src_ctx->fmt_native;
+	const struct vidcap_fmt_info * nominal = &src_ctx->fmt_nominal;
+	int before_ok, after_ok;
+	int before_size, after_size;
+	int width, height;
+
+	if ( src_ctx->transform_buf )
+	{
+		free(src_ctx->transform_buf);
+		src_ctx->transform_buf = 0;
+	}
+
+	if ( !src_ctx->transform )
+		return 0;
+
+	/* Size of the frame entering conversion */
+	width = src_ctx->scaler && src_ctx->scale_before_conv ?
+		nominal->width : native->width;
+	height = src_ctx->scaler && src_ctx->scale_before_conv ?
+		nominal->height : native->height;
+
+	/* An enlarging scaler after conversion expects upright frames */
+	before_ok = transform_fourcc_supported(native->fourcc) &&
+		!(src_ctx->scaler && !src_ctx->scale_before_conv);
+	after_ok = transform_fourcc_supported(nominal->fourcc);
+
+	if ( !before_ok && !after_ok )
+	{
+		log_error("cannot transform %s or %s frames\n",
+				vidcap_fourcc_string_get(native->fourcc),
+				vidcap_fourcc_string_get(nominal->fourcc));
+		return -1;
+	}
+
+	before_size = conv_fmt_size_get(width, height, native->fourcc);
+	after_size = conv_fmt_size_get(nominal->width, nominal->height,
+			nominal->fourcc);
+
+	/* Move the fewest bytes */
+	src_ctx->transform_before_conv = before_ok &&
+		( !after_ok || before_size <= after_size );
+
+	src_ctx->transform_buf_size = src_ctx->transform_before_conv ?
+		before_size : after_size;
+
+	if ( !(src_ctx->transform_buf = malloc(src_ctx->transform_buf_size)) )
+	{
+		log_oom(__FILE__, __LINE__);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+pyramid_bind(struct sapi_src_context * src_ctx)
+{
+	const int swap = transform_swaps_dimensions(src_ctx->transform);
+
+	if ( src_ctx->pyramid )
+	{
+		pyramid_destroy(src_ctx->pyramid);
+		src_ctx->pyramid = 0;
+	}
+
+	if ( !src_ctx->pyramid_levels )
+		return 0;
+
+	/* The pyramid is made of the frame as delivered */
+	src_ctx->pyramid = pyramid_create(src_ctx->fmt_nominal.fourcc,
+			swap ? src_ctx->fmt_nominal.height :
+				src_ctx->fmt_nominal.width,
+			swap ? src_ctx->fmt_nominal.width :
+				src_ctx->fmt_nominal.height,
+			src_ctx->pyramid_levels);
+
+	return src_ctx->pyramid ? 0 : -1;
+}
+
+static int
+motion_bind(struct sapi_src_context * src_ctx)
+{
+	if ( src_ctx->motion )
+	{
+		motion_destroy(src_ctx->motion);
+		src_ctx->motion = 0;
+	}
+
+	src_ctx->motion_idle_frames = 0;
+
+	if ( !src_ctx->motion_threshold )
+		return 0;
+
+	/* Motion is detected in the native frame, before conversion */
+	src_ctx->motion = motion_create(src_ctx->fmt_native.fourcc,
+			src_ctx->fmt_native.width,
+			src_ctx->fmt_native.height);
+
+	return src_ctx->motion ? 0 : -1;
+}
+
 int
 vidcap_format_bind(vidcap_src * src,
 		const struct vidcap_fmt_info * fmt_info)
@@ -450,6 +708,10 @@ vidcap_format_bind(vidcap_src * src,
 	if ( src_ctx->src_state == src_capturing )
 		return -1;
 
+	/* Regions are only meaningful for the format they were set for */
+	rois_free(src_ctx);
+	frame_convs_free(src_ctx);
+
 	if ( !fmt_info )
 	{
 		if ( !src_ctx->fmt_list_len )
@@ -472,16 +734,44 @@ vidcap_format_bind(vidcap_src * src,
 		return -1;
 	}
 
-	if ( src_ctx->format_bind(src_ctx, fmt_info) )
-		return -1;
+	/* The old binding is torn down from here on. Until this one is
+	 * complete the source is left unbound, so that capture cannot
+	 * start with half of it.
+	 */
+	src_ctx->src_state = src_acquired;
+	src_ctx->fmt_conv_func = 0;
 
+	/* The backend may refine the native format, such as with the
+	 * frame rate the device granted
+	 */
 	src_ctx->fmt_native = fmt_native;
+	src_ctx->fps_granted = 0;
+
+	if ( src_ctx->format_bind(src_ctx, fmt_info) )
+		goto bail;
+
+	if ( src_ctx->fps_granted &&
+			(long)src_ctx->fmt_native.fps_numerator *
+				fmt_info->fps_denominator <
+			(long)fmt_info->fps_numerator *
+				src_ctx->fmt_native.fps_denominator )
+		log_warn("%s granted %d/%d fps of the %d/%d asked for\n",
+				src_ctx->src_info.identifier,
+				src_ctx->fmt_native.fps_numerator,
+				src_ctx->fmt_native.fps_denominator,
+				fmt_info->fps_numerator,
+				fmt_info->fps_denominator);
+
 	src_ctx->fmt_nominal = *fmt_info;
 
 	src_ctx->fmt_conv_func = conv_conversion_func_get(
 			src_ctx->fmt_native.fourcc,
 			src_ctx->fmt_nominal.fourcc);
 
+	src_ctx->conv_params.bit_shift = src_ctx->bit_shift >= 0 ?
+		src_ctx->bit_shift :
+		conv_fmt_bit_shift_get(src_ctx->fmt_native.fourcc);
+
 	if ( src_ctx->stride_free_buf )
 	{
 		free(src_ctx->stride_free_buf);
@@ -498,14 +788,18 @@ vidcap_format_bind(vidcap_src * src,
 		log_error("failed to get stride-free buffer size for %s\n",
 				vidcap_fourcc_string_get(
 						src_ctx->fmt_native.fourcc));
-		return -1;
+		goto bail;
 	}
 
-	if ( !(src_ctx->stride_free_buf =
+	/* Compressed frames are passed through without destriding,
+	 * but the size bound is still used for frame buffering.
+	 */
+	if ( !conv_fmt_is_compressed(src_ctx->fmt_native.fourcc) &&
+			!(src_ctx->stride_free_buf =
 				malloc(src_ctx->stride_free_buf_size)) )
 	{
 		log_oom(__FILE__, __LINE__);
-		return -1;
+		goto bail;
 	}
 
 	if ( src_ctx->fmt_conv_buf )
@@ -514,11 +808,20 @@ vidcap_format_bind(vidcap_src * src,
 		src_ctx->fmt_conv_buf = 0;
 	}
 
+	if ( scaler_bind(src_ctx) || transform_bind(src_ctx) ||
+			pyramid_bind(src_ctx) || motion_bind(src_ctx) )
+		goto bail;
+
 	if ( src_ctx->fmt_conv_func )
 	{
+		/* When enlarging, conversion happens at the native size */
+		const struct vidcap_fmt_info * conv_fmt =
+			src_ctx->scaler && !src_ctx->scale_before_conv ?
+			&src_ctx->fmt_native : &src_ctx->fmt_nominal;
+
 		src_ctx->fmt_conv_buf_size = conv_fmt_size_get(
-					src_ctx->fmt_nominal.width,
-					src_ctx->fmt_nominal.height,
+					conv_fmt->width,
+					conv_fmt->height,
 					src_ctx->fmt_nominal.fourcc);
 
 		if ( !src_ctx->fmt_conv_buf_size )
@@ -526,14 +829,14 @@ vidcap_format_bind(vidcap_src * src,
 			log_error("failed to get buffer size for %s\n",
 					vidcap_fourcc_string_get(
 						fmt_info->fourcc));
-			return -1;
+			goto bail;
 		}
 
 		if ( !(src_ctx->fmt_conv_buf =
 					malloc(src_ctx->fmt_conv_buf_size)) )
 		{
 			log_oom(__FILE__, __LINE__);
-			return -1;
+			goto bail;
 		}
 
 		log_debug("format bind requires conversion: %s\n",
@@ -543,123 +846,1034 @@ vidcap_format_bind(vidcap_src * src,
 	src_ctx->src_state = src_bound;
 
 	return 0;
+
+bail:
+	src_ctx->fmt_conv_func = 0;
+	return -1;
 }
 
-int
-vidcap_format_info_get(vidcap_src * src,
-		struct vidcap_fmt_info * fmt_info)
+struct fmt_candidate
 {
-	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
-	*fmt_info = src_ctx->fmt_nominal;
-	return 0;
+	int preference;
+	struct vidcap_fmt_info format;
+	int cost;
+};
+
+/* Fills the zero fields of a preference from a listed format, if the
+ * other fields match it
+ */
+static int
+preference_fill(const struct vidcap_fmt_info * pref,
+		const struct vidcap_fmt_info * listed,
+		struct vidcap_fmt_info * fmt)
+{
+	if ( ( pref->fourcc && pref->fourcc != listed->fourcc ) ||
+			( pref->width && pref->width != listed->width ) ||
+			( pref->height && pref->height != listed->height ) ||
+			( pref->fps_numerator &&
+			  pref->fps_numerator * listed->fps_denominator !=
+			  listed->fps_numerator * pref->fps_denominator ) )
+		return 0;
+
+	*fmt = *listed;
+
+	if ( pref->fps_numerator )
+	{
+		fmt->fps_numerator = pref->fps_numerator;
+		fmt->fps_denominator = pref->fps_denominator;
+	}
+
+	return 1;
 }
 
-static __inline void
-copy_frame_info(void * fr2, const void *fr1)
+static void
+candidate_add(struct sapi_src_context * src_ctx,
+		struct fmt_candidate * candidates, int * count,
+		int preference, const struct vidcap_fmt_info * fmt)
 {
-	const struct frame_info *frame_orig = (struct frame_info *)fr1;
-	struct frame_info *frame_dup = (struct frame_info *)fr2;
+	struct fmt_candidate * candidate = &candidates[*count];
+	struct vidcap_fmt_info fmt_native;
 
-	frame_dup->capture_time    = frame_orig->capture_time;
-	frame_dup->error_status    = frame_orig->error_status;
-	frame_dup->stride          = frame_orig->stride;
-	frame_dup->video_data_size = frame_orig->video_data_size;
+	if ( !src_ctx->format_validate(src_ctx, fmt, &fmt_native, 1) )
+		return;
+
+	if ( (candidate->cost = sapi_format_cost_get(&fmt_native, fmt)) < 0 )
+		return;
 
-	memcpy(frame_dup->video_data,
-			frame_orig->video_data,
-			frame_orig->video_data_size);
+	candidate->preference = preference;
+	candidate->format = *fmt;
+	++*count;
 }
 
 int
-vidcap_src_capture_start(vidcap_src * src,
-		vidcap_src_capture_callback callback,
-		void * user_data)
+vidcap_format_negotiate(vidcap_src * src,
+		const struct vidcap_fmt_info * preferences, int count,
+		struct vidcap_fmt_choice * chosen)
 {
-	int ret = 0;
 	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
-	const int sliding_window_seconds = 4;
-
-	/* Assume worst-case video data with stride is 50%
-	 * bigger than without a stride.
-	 */
-	/** \bug Defer measurement of stride-full 
-	 *           buffer until first capture callback
-	 */
-	const int stride_full_buf_size = src_ctx->stride_free_buf_size * 3 / 2;
+	struct fmt_candidate * candidates;
+	struct fmt_candidate * best;
+	int candidate_count = 0;
+	int i, j;
 
-	if ( user_data == VIDCAP_INVALID_USER_DATA )
-		return -3;
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
 
-	if ( src_ctx->src_state != src_bound )
-		return -4;
+	if ( count < 1 )
+	{
+		log_error("no format preferences\n");
+		return -1;
+	}
 
-	memset(src_ctx->buffered_frames, 0, sizeof(src_ctx->buffered_frames));
-	src_ctx->timer_thread_frame.video_data = 0;
-	src_ctx->frame_times = 0;
-	src_ctx->double_buff = 0;
+	if ( !(candidates = malloc(count * (src_ctx->fmt_list_len + 1) *
+					sizeof(*candidates))) )
+	{
+		log_oom(__FILE__, __LINE__);
+		return -1;
+	}
 
-	if ( src_ctx->use_timer_thread )
+	/* Complete preferences are tried as they are, others are
+	 * completed by each format of the source they match
+	 */
+	for ( i = 0; i < count; ++i )
 	{
-		/* allocate space for double-buffering video buffers */
-		src_ctx->buffered_frames[0].video_data =
-				malloc(2 * stride_full_buf_size);
-		if ( !src_ctx->buffered_frames[0].video_data )
+		const struct vidcap_fmt_info * pref = &preferences[i];
+		struct vidcap_fmt_info fmt;
+
+		if ( pref->fourcc && pref->width && pref->height &&
+				pref->fps_numerator )
 		{
-			log_oom(__FILE__, __LINE__);
-			ret = -6;
-			goto capture_start_bail;
+			candidate_add(src_ctx, candidates, &candidate_count,
+					i, pref);
+			continue;
 		}
 
-		src_ctx->buffered_frames[1].video_data =
-				src_ctx->buffered_frames[0].video_data +
-						stride_full_buf_size;
+		for ( j = 0; j < src_ctx->fmt_list_len; ++j )
+			if ( preference_fill(pref, &src_ctx->fmt_list[j], &fmt) )
+				candidate_add(src_ctx, candidates,
+						&candidate_count, i, &fmt);
+	}
 
-		src_ctx->timer_thread_frame.video_data =
-				malloc(stride_full_buf_size);
-		if ( !src_ctx->timer_thread_frame.video_data )
-		{
-			log_oom(__FILE__, __LINE__);
-			ret = -6;
-			goto capture_start_bail;
-		}
+	/* Cheapest first, the earlier preference on a tie. A candidate
+	 * the source then fails to bind is dropped.
+	 */
+	for ( ;; )
+	{
+		best = 0;
 
-		src_ctx->double_buff = double_buffer_create(&copy_frame_info,
-				&src_ctx->buffered_frames[0], &src_ctx->buffered_frames[1]);
-		if ( !src_ctx->double_buff )
-		{
-			ret = -5;
-			goto capture_start_bail;
-		}
+		for ( i = 0; i < candidate_count; ++i )
+			if ( candidates[i].cost >= 0 &&
+					( !best || candidates[i].cost < best->cost ) )
+				best = &candidates[i];
+
+		if ( !best || !vidcap_format_bind(src, &best->format) )
+			break;
+
+		best->cost = -1;
 	}
-	else
+
+	if ( !best )
 	{
-		src_ctx->frame_time_next.tv_sec = 0;
-		src_ctx->frame_time_next.tv_usec = 0;
-		src_ctx->frame_times = sliding_window_create(sliding_window_seconds *
-				src_ctx->fmt_nominal.fps_numerator / 
-				src_ctx->fmt_nominal.fps_denominator,
-				sizeof(struct timeval));
+		log_error("none of %d format preferences could be bound\n",
+				count);
+		free(candidates);
+		return -1;
+	}
 
-		if ( !src_ctx->frame_times )
-			return -2;
+	if ( chosen )
+	{
+		chosen->preference = best->preference;
+		chosen->format = src_ctx->fmt_nominal;
+		chosen->native = src_ctx->fmt_native;
+		chosen->conversion = src_ctx->fmt_conv_func ?
+			conv_conversion_name_get(src_ctx->fmt_conv_func) : 0;
+		chosen->scale_fourcc = src_ctx->scaler ?
+			sapi_scale_fourcc_get(&src_ctx->fmt_native,
+					&src_ctx->fmt_nominal) : 0;
+		chosen->cost = sapi_format_cost_get(&src_ctx->fmt_native,
+				&src_ctx->fmt_nominal);
 	}
 
-	src_ctx->capture_callback = callback;
-	src_ctx->capture_data = user_data;
+	log_debug("negotiated %dx%d %s from preference %d of %d\n",
+			src_ctx->fmt_nominal.width, src_ctx->fmt_nominal.height,
+			vidcap_fourcc_string_get(src_ctx->fmt_nominal.fourcc),
+			best->preference, count);
 
-	if ( (ret = src_ctx->start_capture(src_ctx)) )
-		goto capture_start_bail;
+	free(candidates);
 
-	src_ctx->src_state = src_capturing;
 	return 0;
+}
 
-capture_start_bail:
+int
+vidcap_format_info_get(vidcap_src * src,
+		struct vidcap_fmt_info * fmt_info)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+	*fmt_info = src_ctx->fmt_nominal;
+	return 0;
+}
 
-	src_ctx->capture_callback = 0;
-	src_ctx->capture_data = VIDCAP_INVALID_USER_DATA;
+int
+vidcap_format_native_get(vidcap_src * src,
+		struct vidcap_fmt_info * fmt_info, int * fps_granted)
+{
+	const struct sapi_src_context * src_ctx =
+		(const struct sapi_src_context *)src;
 
-	if ( src_ctx->double_buff )
-		double_buffer_destroy(src_ctx->double_buff);
+	if ( src_ctx->src_state == src_acquired )
+		return -1;
+
+	*fmt_info = src_ctx->fmt_native;
+
+	if ( fps_granted )
+		*fps_granted = src_ctx->fps_granted;
+
+	return 0;
+}
+
+int
+vidcap_src_scale_mode_set(vidcap_src * src,
+		enum vidcap_scale_mode mode)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	switch ( mode )
+	{
+	case VIDCAP_SCALE_BOX:
+	case VIDCAP_SCALE_BILINEAR:
+	case VIDCAP_SCALE_AREA:
+		break;
+	default:
+		log_error("invalid scale mode %d\n", mode);
+		return -1;
+	}
+
+	src_ctx->scale_mode = mode;
+
+	/* Conversions on request keep scalers of their own */
+	frame_convs_free(src_ctx);
+
+	/* Rebuild the scaler of an already bound format */
+	if ( src_ctx->scaler )
+		return scaler_bind(src_ctx);
+
+	return 0;
+}
+
+int
+vidcap_src_bit_shift_set(vidcap_src * src, int bit_shift)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( bit_shift < -1 || bit_shift > 15 )
+	{
+		log_error("invalid bit shift %d\n", bit_shift);
+		return -1;
+	}
+
+	src_ctx->bit_shift = bit_shift;
+
+	if ( src_ctx->src_state == src_bound )
+		src_ctx->conv_params.bit_shift = bit_shift >= 0 ? bit_shift :
+			conv_fmt_bit_shift_get(src_ctx->fmt_native.fourcc);
+
+	return 0;
+}
+
+int
+vidcap_src_chroma_average_set(vidcap_src * src, int enable)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	src_ctx->conv_params.chroma_average = enable ? 1 : 0;
+
+	return 0;
+}
+
+int
+vidcap_src_tensor_set(vidcap_src * src, const float scale[3],
+		const float bias[3])
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+	int i;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	for ( i = 0; i < 3; ++i )
+	{
+		src_ctx->conv_params.tensor_scale[i] = scale[i];
+		src_ctx->conv_params.tensor_bias[i] = bias[i];
+	}
+
+	return 0;
+}
+
+int
+vidcap_src_demosaic_set(vidcap_src * src, enum vidcap_demosaic mode,
+		int threads)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( mode != VIDCAP_DEMOSAIC_BILINEAR &&
+			mode != VIDCAP_DEMOSAIC_EDGE_AWARE )
+	{
+		log_error("invalid demosaic mode %d\n", mode);
+		return -1;
+	}
+
+	if ( threads < 1 || threads > 16 )
+	{
+		log_error("invalid demosaic thread count %d\n", threads);
+		return -1;
+	}
+
+	src_ctx->conv_params.demosaic = mode;
+	src_ctx->conv_params.threads = threads;
+
+	return 0;
+}
+
+int
+vidcap_src_colorimetry_set(vidcap_src * src,
+		enum vidcap_colorimetry matrix, enum vidcap_range range)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+	const struct colorimetry * color;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( !(color = colorimetry_get(matrix, range)) )
+	{
+		log_error("invalid colorimetry %d range %d\n", matrix, range);
+		return -1;
+	}
+
+	src_ctx->conv_params.color = color;
+
+	return 0;
+}
+
+int
+vidcap_src_transform_set(vidcap_src * src, int transform)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+	const int old_transform = src_ctx->transform;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( transform & ~(VIDCAP_TRANSFORM_ROTATE_MASK |
+				VIDCAP_TRANSFORM_FLIP_H |
+				VIDCAP_TRANSFORM_FLIP_V) )
+	{
+		log_error("invalid transform 0x%x\n", transform);
+		return -1;
+	}
+
+	if ( transform && src_ctx->roi_count )
+	{
+		log_error("transforms cannot be used with regions of "
+				"interest\n");
+		return -1;
+	}
+
+	src_ctx->transform = transform;
+
+	if ( src_ctx->src_state != src_bound )
+		return 0;
+
+	if ( transform_bind(src_ctx) || pyramid_bind(src_ctx) )
+	{
+		src_ctx->transform = old_transform;
+		transform_bind(src_ctx);
+		pyramid_bind(src_ctx);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+vidcap_src_pyramid_set(vidcap_src * src, int levels)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+	const int old_levels = src_ctx->pyramid_levels;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( levels < 0 )
+	{
+		log_error("invalid number of pyramid levels %d\n", levels);
+		return -1;
+	}
+
+	if ( levels && src_ctx->roi_count )
+	{
+		log_error("pyramids cannot be used with regions of "
+				"interest\n");
+		return -1;
+	}
+
+	src_ctx->pyramid_levels = levels;
+
+	if ( src_ctx->src_state != src_bound )
+		return 0;
+
+	if ( pyramid_bind(src_ctx) )
+	{
+		src_ctx->pyramid_levels = old_levels;
+		pyramid_bind(src_ctx);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+vidcap_src_frame_stats_set(vidcap_src * src, int enable)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	src_ctx->frame_stats_enabled = enable ? 1 : 0;
+
+	return 0;
+}
+
+int
+vidcap_src_motion_set(vidcap_src * src, int threshold, int min_blocks,
+		int idle_interval)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+	const int old_threshold = src_ctx->motion_threshold;
+	const int old_min_blocks = src_ctx->motion_min_blocks;
+	const int old_idle_interval = src_ctx->motion_idle_interval;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( threshold < 0 || min_blocks < 0 || idle_interval < 0 )
+	{
+		log_error("invalid motion threshold %d, blocks %d or "
+				"interval %d\n", threshold, min_blocks,
+				idle_interval);
+		return -1;
+	}
+
+	src_ctx->motion_threshold = threshold;
+	src_ctx->motion_min_blocks = min_blocks;
+	src_ctx->motion_idle_interval = idle_interval;
+
+	if ( src_ctx->src_state != src_bound )
+		return 0;
+
+	if ( motion_bind(src_ctx) )
+	{
+		src_ctx->motion_threshold = old_threshold;
+		src_ctx->motion_min_blocks = old_min_blocks;
+		src_ctx->motion_idle_interval = old_idle_interval;
+		motion_bind(src_ctx);
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+vidcap_src_duplicates_set(vidcap_src * src, int mode)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( mode != VIDCAP_DUPLICATES_DELIVER &&
+			mode != VIDCAP_DUPLICATES_MARK &&
+			mode != VIDCAP_DUPLICATES_DROP )
+	{
+		log_error("invalid duplicates mode %d\n", mode);
+		return -1;
+	}
+
+	src_ctx->duplicates_mode = mode;
+
+	return 0;
+}
+
+int
+vidcap_src_rate_mode_set(vidcap_src * src, enum vidcap_rate_mode mode)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( mode != VIDCAP_RATE_DECIMATE && mode != VIDCAP_RATE_CONSTANT )
+	{
+		log_error("invalid rate mode %d\n", mode);
+		return -1;
+	}
+
+	src_ctx->rate_mode = mode;
+
+	return 0;
+}
+
+int
+vidcap_src_jitter_buffer_set(vidcap_src * src, int delay_ms)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	if ( src_ctx->src_state == src_capturing )
+		return -1;
+
+	if ( delay_ms < 0 )
+	{
+		log_error("invalid jitter buffer delay %d\n", delay_ms);
+		return -1;
+	}
+
+	src_ctx->jitter_delay_usecs = 1000L * delay_ms;
+
+	return 0;
+}
+
+int
+vidcap_src_stats_get(vidcap_src * src, struct vidcap_src_stats * stats)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	vc_mutex_lock(&src_ctx->stats_lock);
+	*stats = src_ctx->stats;
+	vc_mutex_unlock(&src_ctx->stats_lock);
+
+	if ( src_ctx->jitter )
+		jitter_buffer_state_get(src_ctx->jitter, &stats->buffered,
+				&stats->delay_usecs);
+
+	return 0;
+}
+
+static int
+roi_validate(const struct sapi_src_context * src_ctx,
+		const struct vidcap_roi * roi)
+{
+	const struct vidcap_fmt_info * native = &src_ctx->fmt_native;
+	int native_x_align, native_y_align;
+	int x_align, y_align;
+
+	if ( conv_fmt_align_get(native->fourcc,
+				&native_x_align, &native_y_align) )
+	{
+		log_error("cannot crop native fourcc %s\n",
+				vidcap_fourcc_string_get(native->fourcc));
+		return -1;
+	}
+
+	if ( conv_fmt_align_get(roi->fourcc, &x_align, &y_align) )
+	{
+		log_error("invalid region fourcc %s\n",
+				vidcap_fourcc_string_get(roi->fourcc));
+		return -1;
+	}
+
+	if ( roi->x < 0 || roi->y < 0 ||
+			roi->width <= 0 || roi->height <= 0 ||
+			roi->x + roi->width > native->width ||
+			roi->y + roi->height > native->height )
+	{
+		log_error("region %dx%d+%d+%d outside of %dx%d frame\n",
+				roi->width, roi->height, roi->x, roi->y,
+				native->width, native->height);
+		return -1;
+	}
+
+	if ( roi->x % native_x_align || roi->y % native_y_align ||
+			roi->width % native_x_align ||
+			roi->height % native_y_align ||
+			roi->width % x_align || roi->height % y_align )
+	{
+		log_error("region %dx%d+%d+%d is not aligned for %s->%s\n",
+				roi->width, roi->height, roi->x, roi->y,
+				vidcap_fourcc_string_get(native->fourcc),
+				vidcap_fourcc_string_get(roi->fourcc));
+		return -1;
+	}
+
+	if ( roi->fourcc != native->fourcc &&
+			!conv_conversion_func_get(native->fourcc, roi->fourcc) )
+	{
+		log_error("no conversion for region %s->%s\n",
+				vidcap_fourcc_string_get(native->fourcc),
+				vidcap_fourcc_string_get(roi->fourcc));
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+vidcap_src_roi_set(vidcap_src * src, int count,
+		const struct vidcap_roi * rois)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+	int i;
+
+	if ( src_ctx->src_state != src_bound )
+		return -1;
+
+	if ( count < 0 || ( count && !rois ) )
+		return -1;
+
+	if ( count && ( src_ctx->scaler || src_ctx->transform ||
+				src_ctx->pyramid_levels ) )
+	{
+		log_error("regions of interest cannot be used with scaling, "
+				"transforms or pyramids\n");
+		return -1;
+	}
+
+	for ( i = 0; i < count; ++i )
+		if ( roi_validate(src_ctx, &rois[i]) )
+			return -1;
+
+	rois_free(src_ctx);
+
+	if ( !count )
+		return 0;
+
+	src_ctx->rois = calloc(count, sizeof(struct sapi_roi));
+	src_ctx->roi_images = calloc(count, sizeof(struct vidcap_image));
+
+	if ( !src_ctx->rois || !src_ctx->roi_images )
+		goto bail_oom;
+
+	/* Count as we go so that rois_free() sees what was allocated */
+	for ( i = 0; i < count; ++i )
+	{
+		struct sapi_roi * roi = &src_ctx->rois[i];
+		struct vidcap_image * image = &src_ctx->roi_images[i];
+
+		src_ctx->roi_count = i + 1;
+
+		roi->roi = rois[i];
+		roi->buf_size = conv_fmt_size_get(rois[i].width,
+				rois[i].height, rois[i].fourcc);
+
+		if ( !(roi->buf = malloc(roi->buf_size)) )
+			goto bail_oom;
+
+		if ( rois[i].fourcc != src_ctx->fmt_native.fourcc )
+		{
+			roi->conv_func = conv_conversion_func_get(
+					src_ctx->fmt_native.fourcc,
+					rois[i].fourcc);
+
+			roi->crop_buf = malloc(conv_fmt_size_get(
+						rois[i].width, rois[i].height,
+						src_ctx->fmt_native.fourcc));
+
+			if ( !roi->crop_buf )
+				goto bail_oom;
+		}
+
+		image->video_data = roi->buf;
+		image->video_data_size = roi->buf_size;
+		image->width = rois[i].width;
+		image->height = rois[i].height;
+		image->fourcc = rois[i].fourcc;
+	}
+
+	return 0;
+
+bail_oom:
+	log_oom(__FILE__, __LINE__);
+	rois_free(src_ctx);
+	return -1;
+}
+
+static struct sapi_frame_conv *
+frame_conv_get(struct sapi_src_context * src_ctx, int fourcc)
+{
+	struct sapi_frame_conv * fc;
+	int i;
+
+	for ( i = 0; i < src_ctx->frame_conv_count; ++i )
+		if ( src_ctx->frame_convs[i].fourcc == fourcc )
+			return &src_ctx->frame_convs[i];
+
+	if ( src_ctx->frame_conv_count == sapi_frame_conv_max )
+	{
+		log_error("too many frame conversions\n");
+		return 0;
+	}
+
+	fc = &src_ctx->frame_convs[src_ctx->frame_conv_count];
+	memset(fc, 0, sizeof(*fc));
+
+	if ( fourcc != src_ctx->fmt_native.fourcc &&
+			!(fc->conv_func = conv_conversion_func_get(
+					src_ctx->fmt_native.fourcc, fourcc)) )
+	{
+		log_error("cannot convert frames from %s to %s\n",
+				vidcap_fourcc_string_get(
+					src_ctx->fmt_native.fourcc),
+				vidcap_fourcc_string_get(fourcc));
+		return 0;
+	}
+
+	/* The frame is resized like the delivered one */
+	if ( src_ctx->scaler && !src_ctx->scale_before_conv &&
+			!(fc->scaler = scaler_create(src_ctx->scale_mode,
+					fourcc,
+					src_ctx->fmt_native.width,
+					src_ctx->fmt_native.height,
+					src_ctx->fmt_nominal.width,
+					src_ctx->fmt_nominal.height)) )
+	{
+		log_error("cannot scale frames in %s\n",
+				vidcap_fourcc_string_get(fourcc));
+		return 0;
+	}
+
+	fc->fourcc = fourcc;
+
+	++src_ctx->frame_conv_count;
+
+	return fc;
+}
+
+/* Buffer for a step of a frame conversion, the one its input is not in */
+static char *
+frame_conv_out_get(struct sapi_frame_conv * fc, const char * in, int size)
+{
+	char ** buf = in == fc->buf ? &fc->work_buf : &fc->buf;
+	int * buf_size = in == fc->buf ? &fc->work_buf_size : &fc->buf_size;
+
+	if ( size > *buf_size )
+	{
+		free(*buf);
+		*buf_size = 0;
+
+		if ( !(*buf = malloc(size)) )
+		{
+			log_oom(__FILE__, __LINE__);
+			return 0;
+		}
+
+		*buf_size = size;
+	}
+
+	return *buf;
+}
+
+/* Converts the frame, then takes it through the steps the delivered
+ * frame took after conversion
+ */
+static const char *
+frame_conv_apply(struct sapi_src_context * src_ctx,
+		struct sapi_frame_conv * fc)
+{
+	int width = src_ctx->frame_width;
+	int height = src_ctx->frame_height;
+	const char * data = src_ctx->frame_buf;
+	char * out;
+
+	if ( fc->conv_func )
+	{
+		if ( !(out = frame_conv_out_get(fc, data,
+				conv_fmt_size_get(width, height, fc->fourcc))) )
+			return 0;
+
+		if ( fc->conv_func(&src_ctx->conv_params, width, height,
+					data, out) )
+		{
+			log_error("failed frame conversion to %s\n",
+					vidcap_fourcc_string_get(fc->fourcc));
+			return 0;
+		}
+
+		data = out;
+	}
+
+	if ( fc->scaler )
+	{
+		width = src_ctx->fmt_nominal.width;
+		height = src_ctx->fmt_nominal.height;
+
+		if ( !(out = frame_conv_out_get(fc, data,
+				conv_fmt_size_get(width, height, fc->fourcc))) )
+			return 0;
+
+		scaler_scale(fc->scaler, data, out);
+		data = out;
+	}
+
+	if ( src_ctx->transform && !src_ctx->transform_before_conv )
+	{
+		if ( !(out = frame_conv_out_get(fc, data,
+				conv_fmt_size_get(width, height, fc->fourcc))) )
+			return 0;
+
+		transform_apply(src_ctx->transform, fc->fourcc,
+				width, height, data, out);
+		data = out;
+	}
+
+	return data;
+}
+
+int
+vidcap_src_frame_convert(vidcap_src * src, int fourcc,
+		struct vidcap_image * image)
+{
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+	const int scale_after = src_ctx->scaler &&
+		!src_ctx->scale_before_conv;
+	const int transform_after = src_ctx->transform &&
+		!src_ctx->transform_before_conv;
+	struct sapi_frame_conv * fc;
+
+	if ( !src_ctx->frame_buf )
+		return -1;
+
+	/* The delivered frame needs no further work */
+	if ( fourcc == src_ctx->frame_image.fourcc &&
+			src_ctx->frame_image.video_data )
+	{
+		*image = src_ctx->frame_image;
+		return 0;
+	}
+
+	image->width = scale_after ? src_ctx->fmt_nominal.width :
+		src_ctx->frame_width;
+	image->height = scale_after ? src_ctx->fmt_nominal.height :
+		src_ctx->frame_height;
+	image->fourcc = fourcc;
+
+	if ( transform_after && transform_swaps_dimensions(src_ctx->transform) )
+	{
+		const int width = image->width;
+		image->width = image->height;
+		image->height = width;
+	}
+
+	image->video_data_size = conv_fmt_size_get(image->width,
+			image->height, fourcc);
+
+	if ( fourcc == src_ctx->fmt_native.fourcc &&
+			!scale_after && !transform_after )
+	{
+		image->video_data = src_ctx->frame_buf;
+		return 0;
+	}
+
+	if ( transform_after && !transform_fourcc_supported(fourcc) )
+	{
+		log_error("cannot transform frames in %s\n",
+				vidcap_fourcc_string_get(fourcc));
+		return -1;
+	}
+
+	if ( !(fc = frame_conv_get(src_ctx, fourcc)) )
+		return -1;
+
+	if ( fc->frame != src_ctx->frame_count )
+	{
+		fc->frame = 0;
+
+		if ( !(fc->data = frame_conv_apply(src_ctx, fc)) )
+			return -1;
+
+		fc->frame = src_ctx->frame_count;
+	}
+
+	image->video_data = fc->data;
+
+	return 0;
+}
+
+static __inline void
+copy_frame_info(void * fr2, const void *fr1)
+{
+	const struct frame_info *frame_orig = (struct frame_info *)fr1;
+	struct frame_info *frame_dup = (struct frame_info *)fr2;
+
+	frame_dup->capture_time    = frame_orig->capture_time;
+	frame_dup->arrival_time    = frame_orig->arrival_time;
+	frame_dup->error_status    = frame_orig->error_status;
+	frame_dup->stride          = frame_orig->stride;
+	frame_dup->duplicate       = frame_orig->duplicate;
+	frame_dup->video_data_size = frame_orig->video_data_size;
+
+	frame_copy_rows(frame_dup->video_data, frame_orig->video_data_size,
+			frame_orig->video_data, frame_orig->video_data_size,
+			frame_orig->video_data_size, 1);
+}
+
+/* One frame per slot, and one being delivered */
+static int
+jitter_start(struct sapi_src_context * src_ctx, int frame_buf_size)
+{
+	void * objects[sapi_jitter_slots];
+	int i;
+
+	src_ctx->jitter_buf = malloc((sapi_jitter_slots + 1) * frame_buf_size);
+	if ( !src_ctx->jitter_buf )
+	{
+		log_oom(__FILE__, __LINE__);
+		return -1;
+	}
+
+	for ( i = 0; i < sapi_jitter_slots; ++i )
+	{
+		src_ctx->jitter_frames[i].video_data =
+			src_ctx->jitter_buf + i * frame_buf_size;
+		objects[i] = &src_ctx->jitter_frames[i];
+	}
+
+	src_ctx->jitter_frame.video_data =
+		src_ctx->jitter_buf + sapi_jitter_slots * frame_buf_size;
+
+	src_ctx->jitter = jitter_buffer_create(sapi_jitter_slots, objects,
+			&copy_frame_info,
+			src_ctx->fmt_nominal.fps_numerator,
+			src_ctx->fmt_nominal.fps_denominator,
+			src_ctx->jitter_delay_usecs);
+	if ( !src_ctx->jitter )
+		return -1;
+
+	src_ctx->jitter_running = 1;
+
+	if ( vc_create_thread(&src_ctx->jitter_thread,
+				sapi_src_jitter_thread_func, src_ctx,
+				&src_ctx->jitter_thread_id) )
+	{
+		log_error("failed to start jitter buffer thread\n");
+		return -1;
+	}
+
+	src_ctx->jitter_thread_started = 1;
+
+	return 0;
+}
+
+int
+vidcap_src_capture_start(vidcap_src * src,
+		vidcap_src_capture_callback callback,
+		void * user_data)
+{
+	int ret = 0;
+	struct sapi_src_context * src_ctx = (struct sapi_src_context *)src;
+
+	/* Assume worst-case video data with stride is 50%
+	 * bigger than without a stride.
+	 */
+	/** \bug Defer measurement of stride-full 
+	 *           buffer until first capture callback
+	 */
+	const int stride_full_buf_size = src_ctx->stride_free_buf_size * 3 / 2;
+
+	if ( user_data == VIDCAP_INVALID_USER_DATA )
+		return -3;
+
+	if ( src_ctx->src_state != src_bound )
+		return -4;
+
+	memset(src_ctx->buffered_frames, 0, sizeof(src_ctx->buffered_frames));
+	src_ctx->buffered_frame_size = stride_full_buf_size;
+	vc_mutex_lock(&src_ctx->stats_lock);
+	memset(&src_ctx->stats, 0, sizeof(src_ctx->stats));
+	vc_mutex_unlock(&src_ctx->stats_lock);
+	src_ctx->last_hash_valid = 0;
+	src_ctx->timer_thread_frame.video_data = 0;
+	src_ctx->double_buff = 0;
+
+	/* Left over when capture ended on an error */
+	jitter_free(src_ctx);
+
+	if ( src_ctx->use_timer_thread )
+	{
+		/* allocate space for double-buffering video buffers */
+		src_ctx->buffered_frames[0].video_data =
+				malloc(2 * stride_full_buf_size);
+		if ( !src_ctx->buffered_frames[0].video_data )
+		{
+			log_oom(__FILE__, __LINE__);
+			ret = -6;
+			goto capture_start_bail;
+		}
+
+		src_ctx->buffered_frames[1].video_data =
+				src_ctx->buffered_frames[0].video_data +
+						stride_full_buf_size;
+
+		src_ctx->timer_thread_frame.video_data =
+				malloc(stride_full_buf_size);
+		if ( !src_ctx->timer_thread_frame.video_data )
+		{
+			log_oom(__FILE__, __LINE__);
+			ret = -6;
+			goto capture_start_bail;
+		}
+
+		src_ctx->double_buff = double_buffer_create(&copy_frame_info,
+				&src_ctx->buffered_frames[0], &src_ctx->buffered_frames[1]);
+		if ( !src_ctx->double_buff )
+		{
+			ret = -5;
+			goto capture_start_bail;
+		}
+	}
+	else
+	{
+		frame_rate_init(&src_ctx->frame_rate,
+				src_ctx->fmt_nominal.fps_numerator,
+				src_ctx->fmt_nominal.fps_denominator);
+	}
+
+	if ( src_ctx->jitter_delay_usecs &&
+			jitter_start(src_ctx, stride_full_buf_size) )
+	{
+		ret = -6;
+		goto capture_start_bail;
+	}
+
+	src_ctx->capture_callback = callback;
+	src_ctx->capture_data = user_data;
+
+	if ( (ret = src_ctx->start_capture(src_ctx)) )
+		goto capture_start_bail;
+
+	src_ctx->src_state = src_capturing;
+	return 0;
+
+capture_start_bail:
+
+	src_ctx->capture_callback = 0;
+	src_ctx->capture_data = VIDCAP_INVALID_USER_DATA;
+
+	jitter_free(src_ctx);
+
+	if ( src_ctx->double_buff )
+		double_buffer_destroy(src_ctx->double_buff);
 
 	if ( src_ctx->buffered_frames[0].video_data )
 		free(src_ctx->buffered_frames[0].video_data);
@@ -670,11 +1884,7 @@ capture_start_bail:
 	if ( src_ctx->timer_thread_frame.video_data )
 		free(src_ctx->timer_thread_frame.video_data);
 
-	if ( src_ctx->frame_times )
-		sliding_window_destroy(src_ctx->frame_times);
-
 	src_ctx->double_buff = 0;
-	src_ctx->frame_times = 0;
 
 	return ret;
 }
@@ -699,6 +1909,8 @@ vidcap_src_capture_stop(vidcap_src * src)
 		sapi_src_timer_thread_idled(src_ctx);
 	}
 
+	jitter_free(src_ctx);
+
 	if ( src_ctx->double_buff )
 		double_buffer_destroy(src_ctx->double_buff);
 	src_ctx->double_buff = 0;
@@ -712,10 +1924,6 @@ vidcap_src_capture_stop(vidcap_src * src)
 	if ( src_ctx->timer_thread_frame.video_data )
 		free(src_ctx->timer_thread_frame.video_data);
 
-	if ( src_ctx->frame_times )
-		sliding_window_destroy(src_ctx->frame_times);
-	src_ctx->frame_times = 0;
-
 	src_ctx->capture_callback = 0;
 	src_ctx->capture_data = VIDCAP_INVALID_USER_DATA;
 
@@ -733,10 +1941,50 @@ vidcap_fourcc_string_get(int fourcc)
 			return "yuy2";
 		case VIDCAP_FOURCC_RGB32:
 			return "rgb32";
+		case VIDCAP_FOURCC_MJPG:
+			return "mjpg";
+		case VIDCAP_FOURCC_H264:
+			return "h264";
+		case VIDCAP_FOURCC_GREY:
+			return "grey";
+		case VIDCAP_FOURCC_Y10:
+			return "y10";
+		case VIDCAP_FOURCC_Y16:
+			return "y16";
+		case VIDCAP_FOURCC_P010:
+			return "p010";
+		case VIDCAP_FOURCC_BA81:
+			return "ba81";
+		case VIDCAP_FOURCC_GBRG:
+			return "gbrg";
+		case VIDCAP_FOURCC_GRBG:
+			return "grbg";
+		case VIDCAP_FOURCC_RGGB:
+			return "rggb";
+		case VIDCAP_FOURCC_BGRA:
+			return "bgra";
+		case VIDCAP_FOURCC_RGBA:
+			return "rgba";
+		case VIDCAP_FOURCC_ARGB:
+			return "argb";
+		case VIDCAP_FOURCC_BGR24:
+			return "bgr24";
+		case VIDCAP_FOURCC_RGB565:
+			return "rgb565";
+		case VIDCAP_FOURCC_NV12:
+			return "nv12";
+		case VIDCAP_FOURCC_RGB_F32:
+			return "rgb_f32";
+		case VIDCAP_FOURCC_RGB_F16:
+			return "rgb_f16";
 		case VIDCAP_FOURCC_RGB24:
 			return "rgb24";
 		case VIDCAP_FOURCC_BOTTOM_UP_RGB24:
 			return "bottom_up_rgb24";
+		case VIDCAP_FOURCC_RGB24_RED_FIRST:
+			return "rgb24_red_first";
+		case VIDCAP_FOURCC_BOTTOM_UP_RGB24_RED_FIRST:
+			return "bottom_up_rgb24_red_first";
 		case VIDCAP_FOURCC_RGB555:
 			return "rgb555";
 		case VIDCAP_FOURCC_YVU9: